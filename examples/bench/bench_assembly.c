@@ -0,0 +1,195 @@
+/**
+ * @file bench_assembly.c
+ * @brief Benchmark of the finite element assembly: atomic updates against colored elements without atomics
+ *
+ * Assembles the stiffness pattern of a 2D mesh of bilinear quads (4 rows per element) in parallel, once with
+ * assemblyElementSparse using atomics over all the elements, once coloring the elements with colorElementsSparse and
+ * assembling each color without atomics, and checks that both give the same matrix.
+ *
+ * gcc -std=c11 -O2 -fopenmp -I../.. bench_assembly.c ../../sparse.c -lm -o bench_assembly && ./bench_assembly [side] [repeat]
+ */
+
+#include "sparse.h"
+#include "math.h"
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Wall clock time in seconds
+ */
+static double now(void) {
+
+#ifdef _OPENMP
+	return omp_get_wtime();
+#else
+	return (double) clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * @brief Assembles all the elements with atomic updates
+ */
+static int assembleAtomic(assembly_t* assembly, const int* ptr, const int* rows, const int nelem, const double* ke) {
+
+	int ok = 1;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) reduction(&&:ok)
+#endif
+	for (int e = 0; e < nelem; e++) {
+		ok = assemblyElementSparse(assembly, rows+ptr[e], ptr[e+1]-ptr[e], ke, 1) && ok;
+	}
+	return ok;
+}
+
+/**
+ * @brief Assembles the elements color by color without atomics
+ */
+static int assembleColored(assembly_t* assembly, const int* ptr, const int* rows, const int* order, const int* colorPtr, const int ncolors, const double* ke) {
+
+	int ok = 1;
+	for (int c = 0; c < ncolors; c++) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) reduction(&&:ok)
+#endif
+		for (int p = colorPtr[c]; p < colorPtr[c+1]; p++) {
+			int e = order[p];
+			ok = assemblyElementSparse(assembly, rows+ptr[e], ptr[e+1]-ptr[e], ke, 0) && ok;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+
+	int side = (argc > 1 ? atoi(argv[1]) : 500);
+	int repeat = (argc > 2 ? atoi(argv[2]) : 5);
+	if (side < 1 || repeat < 1) {
+		printf("usage: %s [side] [repeat]\n", argv[0]);
+		return 1;
+	}
+
+	//mesh of side x side quads, (side+1)^2 nodes
+	int nodes = side+1;
+	int m = nodes*nodes;
+	int nelem = side*side;
+	int* ptr = malloc((nelem+1)*sizeof(int));
+	int* rows = malloc(4L*nelem*sizeof(int));
+	int* color = malloc(nelem*sizeof(int));
+	int* order = malloc(nelem*sizeof(int));
+	elem_t* pattern = malloc((9L*m+1)*sizeof(elem_t));
+	elem_t* out1 = malloc((9L*m+1)*sizeof(elem_t));
+	elem_t* out2 = malloc((9L*m+1)*sizeof(elem_t));
+	if (ptr == NULL || rows == NULL || color == NULL || order == NULL || pattern == NULL || out1 == NULL || out2 == NULL) {
+		printf("out of memory\n");
+		return 1;
+	}
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			int e = y*side + x;
+			ptr[e] = 4*e;
+			rows[4*e] = y*nodes + x;
+			rows[4*e+1] = y*nodes + x+1;
+			rows[4*e+2] = (y+1)*nodes + x+1;
+			rows[4*e+3] = (y+1)*nodes + x;
+		}
+	}
+	ptr[nelem] = 4*nelem;
+
+	//pattern: each node is coupled with its 3x3 neighbourhood
+	int len = 0;
+	for (int i = 0; i < m; i++) {
+		int x = i%nodes;
+		int y = i/nodes;
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				if (x+dx >= 0 && x+dx < nodes && y+dy >= 0 && y+dy < nodes) {
+					len++;
+					pattern[len] = (elem_t) {i, (y+dy)*nodes + x+dx, 0};
+				}
+			}
+		}
+	}
+	pattern->i = m;
+	pattern->j = m;
+	pattern->value = len;
+
+	//stiffness of the bilinear quad for the Laplacian
+	double ke[16] = {
+		4.0/6, -1.0/6, -2.0/6, -1.0/6,
+		-1.0/6, 4.0/6, -1.0/6, -2.0/6,
+		-2.0/6, -1.0/6, 4.0/6, -1.0/6,
+		-1.0/6, -2.0/6, -1.0/6, 4.0/6
+	};
+
+	//coloring, elements grouped by color
+	int ncolors;
+	double start = now();
+	int ok = colorElementsSparse(color, &ncolors, ptr, rows, nelem, m);
+	double colorTime = now() - start;
+	int* colorPtr = calloc(ncolors+1, sizeof(int));
+	ok = ok && colorPtr != NULL;
+	for (int e = 0; ok && e < nelem; e++) {
+		colorPtr[color[e]+1]++;
+	}
+	for (int c = 0; ok && c < ncolors; c++) {
+		colorPtr[c+1] += colorPtr[c];
+	}
+	for (int e = 0; ok && e < nelem; e++) {
+		order[colorPtr[color[e]]++] = e;
+	}
+	for (int c = ncolors; ok && c > 0; c--) {
+		colorPtr[c] = colorPtr[c-1];
+	}
+	if (ok) {
+		colorPtr[0] = 0;
+	}
+
+	assembly_t atomic;
+	assembly_t colored;
+	ok = ok && assemblyInitSparse(&atomic, pattern) && assemblyInitSparse(&colored, pattern);
+	if (!ok) {
+		printf("setup failed\n");
+		return 1;
+	}
+
+	double atomicTime = 0;
+	double coloredTime = 0;
+	for (int r = 0; ok && r < repeat; r++) {
+		start = now();
+		ok = assembleAtomic(&atomic, ptr, rows, nelem, ke);
+		atomicTime += now() - start;
+		start = now();
+		ok = ok && assembleColored(&colored, ptr, rows, order, colorPtr, ncolors, ke);
+		coloredTime += now() - start;
+	}
+
+	int equal = 0;
+	out1->value = 9L*m;
+	out2->value = 9L*m;
+	ok = ok && assemblyGetSparse(out1, &atomic) && assemblyGetSparse(out2, &colored) && equalSparse(&equal, out1, out2, 1e-9);
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	printf("mesh %dx%d: %d elements, %d rows, %d nonzeros, %d threads\n", side, side, nelem, m, len, threads);
+	printf("coloring: %d colors in %.4f s\n", ncolors, colorTime);
+	printf("atomic:   %.4f s per assembly\n", atomicTime/repeat);
+	printf("colored:  %.4f s per assembly\n", coloredTime/repeat);
+	printf("results %s\n", (ok && equal ? "equal" : "DIFFERENT"));
+
+	assemblyFreeSparse(&atomic);
+	assemblyFreeSparse(&colored);
+	free(ptr);
+	free(rows);
+	free(color);
+	free(order);
+	free(colorPtr);
+	free(pattern);
+	free(out1);
+	free(out2);
+
+	return (ok && equal ? 0 : 1);
+}
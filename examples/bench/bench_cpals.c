@@ -0,0 +1,130 @@
+/**
+ * @file bench_cpals.c
+ * @brief Benchmark of the CP decomposition of a random sparse tensor with cpalsSparse
+ *
+ * Generates a third order tensor with randomTensorSparse, stores it in compressed sparse fiber form and runs CP-ALS,
+ * reporting the elapsed time of each mode, then checks mttkrpSparse with the final factors against the sum over the
+ * coordinates of the elements.
+ *
+ * gcc -std=c11 -O2 -fopenmp -I../.. bench_cpals.c ../../sparse.c -lm -o bench_cpals && ./bench_cpals [dim] [nnz] [rank] [iterations] [repeat]
+ */
+
+#include "sparse.h"
+#include "math.h"
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Wall clock time in seconds
+ */
+static double now(void) {
+
+#ifdef _OPENMP
+	return omp_get_wtime();
+#else
+	return (double) clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+	int dim = (argc > 1 ? atoi(argv[1]) : 2000);
+	int nnz = (argc > 2 ? atoi(argv[2]) : 1000000);
+	int rank = (argc > 3 ? atoi(argv[3]) : 16);
+	int iterations = (argc > 4 ? atoi(argv[4]) : 10);
+	int repeat = (argc > 5 ? atoi(argv[5]) : 3);
+	if (dim < 1 || nnz < 1 || rank < 1 || iterations < 1 || repeat < 1) {
+		printf("usage: %s [dim] [nnz] [rank] [iterations] [repeat]\n", argv[0]);
+		return 1;
+	}
+
+	//the modes have different sizes, so the levels of the fibers differ
+	int dims[3] = {dim, dim/2 > 0 ? dim/2 : 1, 2*dim};
+	tensor_t tensor;
+	csf_t csf;
+	double start = now();
+	if (!randomTensorSparse(&tensor, 3, dims, nnz, 1) || !csfSparse(&csf, &tensor, NULL)) {
+		printf("tensor construction failed\n");
+		return 1;
+	}
+	double csfTime = now() - start;
+
+	double* factors[3];
+	double* out = malloc((long) dims[2]*rank*sizeof(double));
+	double* expected = malloc((long) dims[2]*rank*sizeof(double));
+	double* lambda = malloc(rank*sizeof(double));
+	int ok = out != NULL && expected != NULL && lambda != NULL;
+	for (int m = 0; m < 3; m++) {
+		factors[m] = malloc((long) dims[m]*rank*sizeof(double));
+		ok = ok && factors[m] != NULL;
+	}
+	if (!ok) {
+		printf("out of memory\n");
+		return 1;
+	}
+
+	//tol 0, so every run does all the iterations
+	double modeTime[3] = {0, 0, 0};
+	double total = 0;
+	double fit = 0;
+	for (int r = 0; ok && r < repeat; r++) {
+		double runTime[3];
+		start = now();
+		ok = cpalsSparse(factors, lambda, &fit, runTime, &csf, rank, iterations, 0, 1);
+		total += now() - start;
+		for (int m = 0; m < 3; m++) {
+			modeTime[m] += runTime[m];
+		}
+	}
+
+	//MTTKRP with the final factors against the coordinates of the elements
+	int equal = ok;
+	for (int mode = 0; equal && mode < 3; mode++) {
+		long size = (long) dims[mode]*rank;
+		for (long k = 0; k < size; k++) {
+			expected[k] = 0;
+		}
+		for (int e = 0; e < tensor.nnz; e++) {
+			const int* index = tensor.ind+3L*e;
+			for (int q = 0; q < rank; q++) {
+				double product = tensor.values[e];
+				for (int m = 0; m < 3; m++) {
+					if (m != mode) {
+						product *= factors[m][(long) index[m]*rank+q];
+					}
+				}
+				expected[(long) index[mode]*rank+q] += product;
+			}
+		}
+		equal = mttkrpSparse(out, &csf, factors, rank, mode);
+		for (long k = 0; equal && k < size; k++) {
+			equal = fabs(out[k]-expected[k]) <= 1e-9*(1 + fabs(expected[k]));
+		}
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	printf("tensor %d x %d x %d: %d elements, %d fibers at the root, rank %d, %d threads\n", dims[0], dims[1], dims[2],
+			csf.nnodes[2], csf.nnodes[0], rank, threads);
+	printf("csfSparse:     %.4f s\n", csfTime);
+	printf("cpalsSparse:   %.4f s per run of %d iterations, fit %.6f\n", total/repeat, iterations, fit);
+	for (int m = 0; m < 3; m++) {
+		printf("mode %d:        %.4f s per run\n", m, modeTime[m]/repeat);
+	}
+	printf("results %s\n", (ok && equal ? "equal" : "DIFFERENT"));
+
+	for (int m = 0; m < 3; m++) {
+		free(factors[m]);
+	}
+	free(out);
+	free(expected);
+	free(lambda);
+	tensorFreeSparse(&tensor);
+	csfFreeSparse(&csf);
+
+	return (ok && equal ? 0 : 1);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file bench_esc.c
+ * @brief Benchmark of the sparse products: expand-sort-compress against the row-wise accumulator and multiplySparse
+ *
+ * Squares the matrix of an R-MAT graph with multiplySparse_ESC, with multiplySparse_Prune without pruning (row-wise
+ * dense accumulator) and, for small graphs, with multiplySparse, and checks that the products are equal.
+ *
+ * gcc -std=c11 -O2 -fopenmp -I../.. bench_esc.c ../../sparse.c -lm -o bench_esc && ./bench_esc [scale] [edgefactor] [repeat]
+ */
+
+#include "sparse.h"
+#include "math.h"
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Largest number of elements of the graph multiplied with multiplySparse, which is quadratic */
+#define NAIVE_MAX 4000
+
+/**
+ * @brief Wall clock time in seconds
+ */
+static double now(void) {
+
+#ifdef _OPENMP
+	return omp_get_wtime();
+#else
+	return (double) clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+	int scale = (argc > 1 ? atoi(argv[1]) : 14);
+	int edgefactor = (argc > 2 ? atoi(argv[2]) : 8);
+	int repeat = (argc > 3 ? atoi(argv[3]) : 3);
+	if (scale < 1 || scale > 24 || edgefactor < 1 || repeat < 1) {
+		printf("usage: %s [scale] [edgefactor] [repeat]\n", argv[0]);
+		return 1;
+	}
+
+	int m = 1 << scale;
+	long edges = (long) edgefactor*m;
+	elem_t* a = malloc((edges+1)*sizeof(elem_t));
+	if (a == NULL) {
+		printf("out of memory\n");
+		return 1;
+	}
+	a->value = edges;
+	if (!rmatSparse(a, scale, edgefactor, 0.57, 0.19, 0.19, 1)) {
+		printf("rmatSparse failed\n");
+		return 1;
+	}
+	int nnz = (int) a->value;
+
+	//the number of partial products bounds the size of the product
+	long* rowlen = calloc(m, sizeof(long));
+	long products = 0;
+	for (int k = 0; k < nnz; k++) {
+		rowlen[a[k+1].i]++;
+	}
+	for (int k = 0; k < nnz; k++) {
+		products += rowlen[a[k+1].j];
+	}
+	free(rowlen);
+	elem_t* esc = malloc((products+1)*sizeof(elem_t));
+	elem_t* gustavson = malloc((products+1)*sizeof(elem_t));
+	elem_t* naive = nnz <= NAIVE_MAX ? malloc((products+1)*sizeof(elem_t)) : NULL;
+	if (esc == NULL || gustavson == NULL || (nnz <= NAIVE_MAX && naive == NULL)) {
+		printf("out of memory\n");
+		return 1;
+	}
+
+	double escTime = 0;
+	double gustavsonTime = 0;
+	double naiveTime = 0;
+	int ok = 1;
+	for (int r = 0; ok && r < repeat; r++) {
+		esc->value = products;
+		double start = now();
+		ok = multiplySparse_ESC(esc, a, a);
+		escTime += now() - start;
+
+		gustavson->value = products;
+		start = now();
+		ok = ok && multiplySparse_Prune(gustavson, a, a, 0, 0, 0);
+		gustavsonTime += now() - start;
+	}
+	if (ok && naive != NULL) {
+		naive->value = products;
+		double start = now();
+		ok = multiplySparse(naive, a, a);
+		naiveTime = now() - start;
+		naive->i = m;
+		naive->j = m;
+	}
+
+	int equal = 0;
+	ok = ok && equalSparse(&equal, esc, gustavson, 1e-9) && equal;
+	if (ok && naive != NULL) {
+		ok = equalSparse(&equal, esc, naive, 1e-9) && equal;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	printf("R-MAT scale %d: %d rows, %d nonzeros, %ld partial products, %d nonzeros in A*A, %d threads\n", scale, m, nnz,
+			products, (int) esc->value, threads);
+	printf("ESC:           %.4f s per product\n", escTime/repeat);
+	printf("accumulator:   %.4f s per product\n", gustavsonTime/repeat);
+	if (naive != NULL) {
+		printf("multiplySparse: %.4f s\n", naiveTime);
+	} else {
+		printf("multiplySparse: skipped (more than %d nonzeros)\n", NAIVE_MAX);
+	}
+	printf("results %s\n", (ok && equal ? "equal" : "DIFFERENT"));
+
+	free(a);
+	free(esc);
+	free(gustavson);
+	free(naive);
+
+	return (ok && equal ? 0 : 1);
+}
@@ -0,0 +1,94 @@
+/**
+ * @file bench_triangle.c
+ * @brief Benchmark of triangle counting and of the k-truss on R-MAT graphs
+ *
+ * Counts the triangles of an R-MAT graph with triangleSparse and computes its k-truss with trussSparse, checking
+ * that the triangles of the edges of the 3-truss (the edges in at least a triangle) add up to three times the count.
+ *
+ * gcc -std=c11 -O2 -fopenmp -I../.. bench_triangle.c ../../sparse.c -lm -o bench_triangle && ./bench_triangle [scale] [edgefactor] [k] [repeat]
+ */
+
+#include "sparse.h"
+#include "math.h"
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Wall clock time in seconds
+ */
+static double now(void) {
+
+#ifdef _OPENMP
+	return omp_get_wtime();
+#else
+	return (double) clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+	int scale = (argc > 1 ? atoi(argv[1]) : 16);
+	int edgefactor = (argc > 2 ? atoi(argv[2]) : 16);
+	int k = (argc > 3 ? atoi(argv[3]) : 5);
+	int repeat = (argc > 4 ? atoi(argv[4]) : 3);
+	if (scale < 1 || scale > 24 || edgefactor < 1 || k < 2 || repeat < 1) {
+		printf("usage: %s [scale] [edgefactor] [k] [repeat]\n", argv[0]);
+		return 1;
+	}
+
+	int m = 1 << scale;
+	long edges = (long) edgefactor*m;
+	elem_t* a = malloc((edges+1)*sizeof(elem_t));
+	elem_t* truss = malloc((2*edges+1)*sizeof(elem_t));
+	if (a == NULL || truss == NULL) {
+		printf("out of memory\n");
+		return 1;
+	}
+	a->value = edges;
+	if (!rmatSparse(a, scale, edgefactor, 0.57, 0.19, 0.19, 1)) {
+		printf("rmatSparse failed\n");
+		return 1;
+	}
+
+	long total = 0;
+	double triangleTime = 0;
+	double trussTime = 0;
+	int ok = 1;
+	for (int r = 0; ok && r < repeat; r++) {
+		double start = now();
+		ok = triangleSparse(&total, NULL, a);
+		triangleTime += now() - start;
+
+		truss->value = 2*edges;
+		start = now();
+		ok = ok && trussSparse(truss, a, k);
+		trussTime += now() - start;
+	}
+	int trussEdges = (int) truss->value/2;
+
+	//each triangle is counted by its three edges in both directions
+	double sum = 0;
+	truss->value = 2*edges;
+	ok = ok && trussSparse(truss, a, 3);
+	for (int e = 0; ok && e < (int) truss->value; e++) {
+		sum += truss[e+1].value;
+	}
+	int equal = ok && sum == 6.0*total;
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	printf("R-MAT scale %d: %d vertices, %d nonzeros, %ld triangles, %d edges in the %d-truss, %d threads\n", scale, m,
+			(int) a->value, total, trussEdges, k, threads);
+	printf("triangleSparse: %.4f s\n", triangleTime/repeat);
+	printf("trussSparse:    %.4f s\n", trussTime/repeat);
+	printf("results %s\n", (equal ? "equal" : "DIFFERENT"));
+
+	free(a);
+	free(truss);
+
+	return (equal ? 0 : 1);
+}
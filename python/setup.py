@@ -0,0 +1,15 @@
+from setuptools import setup, Extension
+
+setup(
+	name="sparse",
+	version="0.1",
+	description="Python bindings of the library for sparse matrixes",
+	ext_modules=[
+		Extension(
+			"sparse",
+			sources=["sparsemodule.c", "../sparse.c"],
+			include_dirs=[".."],
+			extra_compile_args=["-std=c11"],
+		)
+	],
+)
@@ -0,0 +1,569 @@
+/**
+ * @file sparsemodule.c
+ * @brief Python bindings of the library for sparse matrixes
+ *
+ * Matrixes are exposed with the buffer protocol as arrays of records (i, j, value) sharing the memory of the
+ * elem_t array, so numpy.asarray(matrix) doesn't copy. The global interpreter lock is released during every kernel,
+ * the operands are marked as busy meanwhile so that prune can't change them from another thread.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "sparse.h"
+
+/* Sparse matrix owning an elem_t array */
+typedef struct {
+	PyObject_HEAD
+	elem_t* data; //first element m,n,nnz followed by the elements
+	Py_ssize_t cap; //number of elements allocated (first element excluded)
+	Py_ssize_t shape[1]; //number of elements exported with the buffer protocol
+	Py_ssize_t strides[1];
+	Py_ssize_t exports; //number of buffers exported and not released, the elements can't change while positive
+	Py_ssize_t busy; //number of kernels reading the elements with the GIL released, -1 while prune changes them
+} MatrixObject;
+
+static PyTypeObject MatrixType;
+
+/**
+ * @brief Allocates a matrix object with room for cap elements
+ *
+ * @param type Type of the object (Matrix or a subclass)
+ * @param m Number of rows
+ * @param n Number of columns
+ * @param cap Number of elements to allocate
+ *
+ * @return the new reference, NULL if errors occurred
+ */
+static MatrixObject* newMatrix(PyTypeObject* type, const int m, const int n, const Py_ssize_t cap) {
+
+	MatrixObject* self = (MatrixObject*) type->tp_alloc(type, 0);
+	if (self == NULL) {
+		return NULL;
+	}
+
+	self->data = PyMem_RawMalloc((cap+1)*sizeof(elem_t));
+	if (self->data == NULL) {
+		Py_DECREF(self);
+		return (MatrixObject*) PyErr_NoMemory();
+	}
+	self->cap = cap;
+	self->data->i = m;
+	self->data->j = n;
+	self->data->value = 0;
+
+	return self;
+}
+
+static void Matrix_dealloc(MatrixObject* self) {
+	PyMem_RawFree(self->data);
+	Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static PyObject* Matrix_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+
+	static char* kwlist[] = {"m", "n", "capacity", NULL};
+	int m;
+	int n;
+	Py_ssize_t cap = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "ii|n", kwlist, &m, &n, &cap)) {
+		return NULL;
+	}
+	if (m < 1 || n < 1 || cap < 0) {
+		PyErr_SetString(PyExc_ValueError, "dimensions must be positive and capacity not negative");
+		return NULL;
+	}
+
+	return (PyObject*) newMatrix(type, m, n, cap);
+}
+
+/* Records (i, j, value) of the elements, without the first element, shape and strides are shared by the views */
+static int Matrix_getbuffer(MatrixObject* self, Py_buffer* view, int flags) {
+
+	if (self->busy < 0) {
+		PyErr_SetString(PyExc_BufferError, "the matrix is being pruned");
+		view->obj = NULL;
+		return -1;
+	}
+
+	//the elements don't change while views are exported, so the shape of the first view is the shape of all
+	if (self->exports == 0) {
+		self->shape[0] = (Py_ssize_t) self->data->value;
+		self->strides[0] = sizeof(elem_t);
+	}
+	self->exports++;
+
+	view->obj = (PyObject*) self;
+	Py_INCREF(self);
+	view->buf = self->data+1;
+	view->len = self->shape[0]*sizeof(elem_t);
+	view->readonly = 0;
+	view->itemsize = sizeof(elem_t);
+	view->format = (flags & PyBUF_FORMAT) ? "T{i:i:i:j:d:value:}" : NULL;
+	view->ndim = 1;
+	view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+	view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+
+	return 0;
+}
+
+static void Matrix_releasebuffer(MatrixObject* self, Py_buffer* view) {
+	(void) view;
+	self->exports--;
+}
+
+static PyBufferProcs Matrix_as_buffer = {
+	(getbufferproc) Matrix_getbuffer,
+	(releasebufferproc) Matrix_releasebuffer,
+};
+
+static PyObject* Matrix_get_shape(MatrixObject* self, void* closure) {
+	(void) closure;
+	return Py_BuildValue("(ii)", self->data->i, self->data->j);
+}
+
+static PyObject* Matrix_get_nnz(MatrixObject* self, void* closure) {
+	(void) closure;
+	return PyLong_FromLong((long) self->data->value);
+}
+
+static PyGetSetDef Matrix_getset[] = {
+	{"shape", (getter) Matrix_get_shape, NULL, "(rows, columns)", NULL},
+	{"nnz", (getter) Matrix_get_nnz, NULL, "number of stored elements", NULL},
+	{NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject MatrixType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "sparse.Matrix",
+	.tp_doc = "Matrix(m, n, capacity=0): sparse matrix of (i, j, value) records, exported without copy with the buffer protocol",
+	.tp_basicsize = sizeof(MatrixObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	.tp_new = Matrix_new,
+	.tp_dealloc = (destructor) Matrix_dealloc,
+	.tp_as_buffer = &Matrix_as_buffer,
+	.tp_getset = Matrix_getset,
+};
+
+/**
+ * @brief Marks the matrix as read by a kernel that releases the GIL, so prune refuses to change it meanwhile
+ *
+ * @param self Pointer to the matrix
+ *
+ * @return 0 with BufferError set if the matrix is being pruned
+ */
+static int beginRead(MatrixObject* self) {
+
+	if (self->busy < 0) {
+		PyErr_SetString(PyExc_BufferError, "the matrix is being pruned");
+		return 0;
+	}
+	self->busy++;
+
+	return 1;
+}
+
+/**
+ * @brief Ends a read started with beginRead (with the GIL held)
+ *
+ * @param self Pointer to the matrix
+ */
+static void endRead(MatrixObject* self) {
+	self->busy--;
+}
+
+/**
+ * @brief Kind of a one dimensional buffer from its format
+ *
+ * @param view Pointer to the buffer
+ *
+ * @return 'i' for 32 bit integers, 'q' for 64 bit integers, 'd' for doubles, 0 otherwise
+ */
+static char bufferKind(const Py_buffer* view) {
+
+	const char* format = view->format != NULL ? view->format : "B";
+	if (*format == '@' || *format == '=' || *format == '<') {
+		format++;
+	}
+	if (strlen(format) != 1 || view->ndim != 1) {
+		return 0;
+	}
+
+	if ((*format == 'i' || *format == 'l' || *format == 'q') && view->itemsize == 4) {
+		return 'i';
+	}
+	if ((*format == 'i' || *format == 'l' || *format == 'q') && view->itemsize == 8) {
+		return 'q';
+	}
+	if (*format == 'd' && view->itemsize == 8) {
+		return 'd';
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Element of an integer buffer of kind 'i' or 'q'
+ */
+static long long bufferIndex(const Py_buffer* view, const char kind, const Py_ssize_t k) {
+	return kind == 'i' ? ((const int*) view->buf)[k] : ((const long long*) view->buf)[k];
+}
+
+/* from_csr(m, n, indptr, indices, data) or from_csr(csr_matrix): the arrays are copied into a new Matrix */
+static PyObject* sparse_from_csr(PyObject* module, PyObject* args) {
+
+	(void) module;
+	PyObject* objects[3];
+	int m;
+	int n;
+
+	if (PyTuple_GET_SIZE(args) == 1) {
+		//scipy.sparse.csr_matrix, its arrays are read with the buffer protocol
+		PyObject* csr = PyTuple_GET_ITEM(args, 0);
+		PyObject* shape = PyObject_GetAttrString(csr, "shape");
+		if (shape == NULL || !PyArg_ParseTuple(shape, "ii", &m, &n)) {
+			Py_XDECREF(shape);
+			return NULL;
+		}
+		Py_DECREF(shape);
+		objects[0] = PyObject_GetAttrString(csr, "indptr");
+		objects[1] = PyObject_GetAttrString(csr, "indices");
+		objects[2] = PyObject_GetAttrString(csr, "data");
+	} else {
+		PyObject* indptr;
+		PyObject* indices;
+		PyObject* data;
+		if (!PyArg_ParseTuple(args, "iiOOO", &m, &n, &indptr, &indices, &data)) {
+			return NULL;
+		}
+		objects[0] = indptr;
+		objects[1] = indices;
+		objects[2] = data;
+		Py_INCREF(indptr);
+		Py_INCREF(indices);
+		Py_INCREF(data);
+	}
+
+	Py_buffer views[3];
+	int got = 0;
+	PyObject* result = NULL;
+	for (; got < 3; got++) {
+		if (objects[got] == NULL || PyObject_GetBuffer(objects[got], views+got, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+			goto done;
+		}
+	}
+
+	char ptrKind = bufferKind(views);
+	char idxKind = bufferKind(views+1);
+	if (ptrKind == 0 || ptrKind == 'd' || idxKind == 0 || idxKind == 'd' || bufferKind(views+2) != 'd') {
+		PyErr_SetString(PyExc_TypeError, "indptr and indices must be integer arrays and data a float64 array");
+		goto done;
+	}
+	Py_ssize_t nnz = views[2].len/8;
+	if (m < 1 || n < 1 || views[0].len/views[0].itemsize != m+1 || views[1].len/views[1].itemsize != nnz) {
+		PyErr_SetString(PyExc_ValueError, "arrays don't match the dimensions");
+		goto done;
+	}
+
+	MatrixObject* out = newMatrix(&MatrixType, m, n, nnz);
+	if (out == NULL) {
+		goto done;
+	}
+
+	int ok = 1;
+	Py_BEGIN_ALLOW_THREADS
+
+	//rows must cover the arrays exactly, in order, or some elements would be left uninitialised
+	if (bufferIndex(views, ptrKind, 0) != 0 || bufferIndex(views, ptrKind, m) != nnz) {
+		ok = 0;
+	}
+	for (int r = 0; ok && r < m; r++) {
+		if (bufferIndex(views, ptrKind, r+1) < bufferIndex(views, ptrKind, r)) {
+			ok = 0;
+		}
+	}
+
+	const double* values = views[2].buf;
+	for (int r = 0; ok && r < m; r++) {
+		long long start = bufferIndex(views, ptrKind, r);
+		long long end = bufferIndex(views, ptrKind, r+1);
+		for (long long p = start; p < end; p++) {
+			long long c = bufferIndex(views+1, idxKind, p);
+			if (c < 0 || c >= n) {
+				ok = 0;
+				break;
+			}
+			(out->data+p+1)->i = r;
+			(out->data+p+1)->j = (int) c;
+			(out->data+p+1)->value = values[p];
+		}
+	}
+	out->data->value = nnz;
+	Py_END_ALLOW_THREADS
+
+	if (!ok) {
+		Py_DECREF(out);
+		PyErr_SetString(PyExc_ValueError, "invalid indptr or indices");
+		goto done;
+	}
+	result = (PyObject*) out;
+
+done:
+	for (int k = 0; k < got; k++) {
+		PyBuffer_Release(views+k);
+	}
+	for (int k = 0; k < 3; k++) {
+		Py_XDECREF(objects[k]);
+	}
+
+	return result;
+}
+
+/* multiply(a, b): product with multiplySparse_ESC */
+static PyObject* sparse_multiply(PyObject* module, PyObject* args) {
+
+	(void) module;
+	MatrixObject* a;
+	MatrixObject* b;
+	if (!PyArg_ParseTuple(args, "O!O!", &MatrixType, &a, &MatrixType, &b)) {
+		return NULL;
+	}
+	if (a->data->j != b->data->i) {
+		PyErr_SetString(PyExc_ValueError, "dimensions don't match");
+		return NULL;
+	}
+	if (!beginRead(a)) {
+		return NULL;
+	}
+	if (!beginRead(b)) {
+		endRead(a);
+		return NULL;
+	}
+
+	//the number of partial products bounds the size of the product
+	Py_ssize_t products = 0;
+	Py_BEGIN_ALLOW_THREADS
+	long* rowlen = calloc(b->data->i, sizeof(long));
+	if (rowlen != NULL) {
+		for (int k = 0; k < (int) b->data->value; k++) {
+			rowlen[(b->data+k+1)->i]++;
+		}
+		for (int k = 0; k < (int) a->data->value; k++) {
+			products += rowlen[(a->data+k+1)->j];
+		}
+		free(rowlen);
+	} else {
+		products = -1;
+	}
+	Py_END_ALLOW_THREADS
+	if (products < 0) {
+		endRead(a);
+		endRead(b);
+		return PyErr_NoMemory();
+	}
+
+	MatrixObject* out = newMatrix(&MatrixType, a->data->i, b->data->j, products);
+	if (out == NULL) {
+		endRead(a);
+		endRead(b);
+		return NULL;
+	}
+
+	int ok;
+	Py_BEGIN_ALLOW_THREADS
+	out->data->value = products;
+	ok = multiplySparse_ESC(out->data, a->data, b->data);
+	Py_END_ALLOW_THREADS
+	endRead(a);
+	endRead(b);
+
+	if (!ok) {
+		Py_DECREF(out);
+		PyErr_SetString(PyExc_RuntimeError, "multiplySparse_ESC failed");
+		return NULL;
+	}
+
+	return (PyObject*) out;
+}
+
+/* transpose(a): new sorted transposed matrix */
+static PyObject* sparse_transpose(PyObject* module, PyObject* args) {
+
+	(void) module;
+	MatrixObject* a;
+	if (!PyArg_ParseTuple(args, "O!", &MatrixType, &a)) {
+		return NULL;
+	}
+
+	MatrixObject* out = newMatrix(&MatrixType, a->data->i, a->data->j, (Py_ssize_t) a->data->value);
+	if (out == NULL) {
+		return NULL;
+	}
+	if (!beginRead(a)) {
+		Py_DECREF(out);
+		return NULL;
+	}
+
+	int ok;
+	Py_BEGIN_ALLOW_THREADS
+	memcpy(out->data, a->data, ((size_t) a->data->value+1)*sizeof(elem_t));
+	ok = transposeSparse(out->data) && sortSparse(out->data);
+	Py_END_ALLOW_THREADS
+	endRead(a);
+
+	if (!ok) {
+		Py_DECREF(out);
+		PyErr_SetString(PyExc_RuntimeError, "transposeSparse failed");
+		return NULL;
+	}
+
+	return (PyObject*) out;
+}
+
+/* prune(a, k=0, absolute=0.0, relative=0.0): in place, with pruneSparse, refused while buffers of a are exported or
+ * another kernel reads a */
+static PyObject* sparse_prune(PyObject* module, PyObject* args, PyObject* kwds) {
+
+	(void) module;
+	static char* kwlist[] = {"a", "k", "absolute", "relative", NULL};
+	MatrixObject* a;
+	int k = 0;
+	double absolute = 0;
+	double relative = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|idd", kwlist, &MatrixType, &a, &k, &absolute, &relative)) {
+		return NULL;
+	}
+	if (a->exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "prune: the matrix has exported buffers");
+		return NULL;
+	}
+	if (a->busy != 0) {
+		PyErr_SetString(PyExc_BufferError, "prune: the matrix is used by another kernel");
+		return NULL;
+	}
+
+	int ok;
+	a->busy = -1;
+	Py_BEGIN_ALLOW_THREADS
+	ok = pruneSparse(a->data, k, absolute, relative);
+	Py_END_ALLOW_THREADS
+	a->busy = 0;
+
+	if (!ok) {
+		PyErr_SetString(PyExc_RuntimeError, "pruneSparse failed");
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+/**
+ * @brief Product (or transposed product) of a matrix by a vector, both vectors are any float64 buffers (no copy)
+ */
+static PyObject* spmvCommon(PyObject* args, const int transposed) {
+
+	MatrixObject* a;
+	PyObject* xobj;
+	PyObject* yobj;
+	if (!PyArg_ParseTuple(args, "O!OO", &MatrixType, &a, &xobj, &yobj)) {
+		return NULL;
+	}
+
+	Py_buffer x;
+	Py_buffer y;
+	if (PyObject_GetBuffer(xobj, &x, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+		return NULL;
+	}
+	if (PyObject_GetBuffer(yobj, &y, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE) < 0) {
+		PyBuffer_Release(&x);
+		return NULL;
+	}
+
+	int rows = transposed ? a->data->j : a->data->i;
+	int cols = transposed ? a->data->i : a->data->j;
+	int ok = 0;
+	if (bufferKind(&x) != 'd' || bufferKind(&y) != 'd' || x.len/8 != cols || y.len/8 != rows) {
+		PyErr_SetString(PyExc_ValueError, "x and y must be float64 arrays matching the dimensions");
+	} else if (beginRead(a)) {
+		Py_BEGIN_ALLOW_THREADS
+		if (transposed) {
+			ok = multiplySparse_VectorT(y.buf, a->data, x.buf);
+		} else {
+			ok = multiplySparse_Vector(y.buf, a->data, x.buf);
+		}
+		Py_END_ALLOW_THREADS
+		endRead(a);
+		if (!ok) {
+			PyErr_SetString(PyExc_RuntimeError, "product failed");
+		}
+	}
+
+	PyBuffer_Release(&x);
+	PyBuffer_Release(&y);
+
+	if (!ok) {
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+/* spmv(a, x, y): y = a*x */
+static PyObject* sparse_spmv(PyObject* module, PyObject* args) {
+	(void) module;
+	return spmvCommon(args, 0);
+}
+
+/* spmv_t(a, x, y): y = a'*x */
+static PyObject* sparse_spmv_t(PyObject* module, PyObject* args) {
+	(void) module;
+	return spmvCommon(args, 1);
+}
+
+static PyMethodDef sparse_methods[] = {
+	{"from_csr", sparse_from_csr, METH_VARARGS,
+		"from_csr(csr) or from_csr(m, n, indptr, indices, data): Matrix with a copy of the CSR arrays"},
+	{"multiply", sparse_multiply, METH_VARARGS, "multiply(a, b): product of two matrixes"},
+	{"transpose", sparse_transpose, METH_VARARGS, "transpose(a): sorted transpose of a matrix"},
+	{"prune", (PyCFunction)(void(*)(void)) sparse_prune, METH_VARARGS | METH_KEYWORDS,
+		"prune(a, k=0, absolute=0.0, relative=0.0): row-wise top-k and threshold pruning, in place"},
+	{"spmv", sparse_spmv, METH_VARARGS, "spmv(a, x, y): y = a*x on float64 buffers"},
+	{"spmv_t", sparse_spmv_t, METH_VARARGS, "spmv_t(a, x, y): y = a'*x on float64 buffers"},
+	{NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef sparse_module = {
+	PyModuleDef_HEAD_INIT,
+	"sparse",
+	"Bindings of the library for sparse matrixes",
+	-1,
+	sparse_methods,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+};
+
+PyMODINIT_FUNC PyInit_sparse(void) {
+
+	if (PyType_Ready(&MatrixType) < 0) {
+		return NULL;
+	}
+
+	PyObject* module = PyModule_Create(&sparse_module);
+	if (module == NULL) {
+		return NULL;
+	}
+
+	Py_INCREF(&MatrixType);
+	if (PyModule_AddObject(module, "Matrix", (PyObject*) &MatrixType) < 0) {
+		Py_DECREF(&MatrixType);
+		Py_DECREF(module);
+		return NULL;
+	}
+
+	return module;
+}
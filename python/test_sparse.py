@@ -0,0 +1,164 @@
+"""
+Tests of the Python bindings
+
+python setup.py build_ext --inplace && python -m pytest test_sparse.py
+"""
+
+import array
+
+import pytest
+
+import sparse
+
+
+def matrix(m, n, indptr, indices, data):
+	"""Matrix from CSR lists"""
+	return sparse.from_csr(m, n, array.array("i", indptr), array.array("i", indices), array.array("d", data))
+
+
+def records(a):
+	"""(i, j, value) records of a matrix, read through the buffer protocol"""
+	with memoryview(a) as view:
+		raw = view.cast("B")
+		ints = raw.cast("i")
+		doubles = raw.cast("d")
+		step = view.itemsize
+		return [(ints[k*step//4], ints[k*step//4 + 1], doubles[k*step//8 + 1]) for k in range(len(view))]
+
+
+def test_construction():
+	a = sparse.Matrix(3, 4, capacity=10)
+	assert a.shape == (3, 4)
+	assert a.nnz == 0
+	with pytest.raises(ValueError):
+		sparse.Matrix(0, 4)
+
+
+def test_subclass():
+	class Labelled(sparse.Matrix):
+		pass
+
+	a = Labelled(2, 2)
+	assert type(a) is Labelled
+	assert a.shape == (2, 2)
+
+
+def test_from_csr():
+	a = matrix(2, 3, [0, 2, 3], [0, 2, 1], [1.0, 2.0, 3.0])
+	assert a.shape == (2, 3)
+	assert a.nnz == 3
+	assert records(a) == [(0, 0, 1.0), (0, 2, 2.0), (1, 1, 3.0)]
+
+
+def test_from_csr_copies():
+	data = array.array("d", [1.0, 2.0])
+	a = sparse.from_csr(2, 2, array.array("i", [0, 1, 2]), array.array("q", [1, 0]), data)
+	data[0] = 5.0
+	assert records(a) == [(0, 1, 1.0), (1, 0, 2.0)]
+
+
+def test_from_csr_invalid():
+	with pytest.raises(ValueError):
+		matrix(2, 2, [0, 1, 2], [0, 2], [1.0, 1.0])
+	with pytest.raises(ValueError):
+		matrix(2, 2, [0, 1], [0], [1.0])
+	with pytest.raises(TypeError):
+		sparse.from_csr(2, 2, array.array("i", [0, 1, 2]), array.array("i", [0, 1]), array.array("f", [1.0, 1.0]))
+
+
+def test_from_csr_indptr():
+	# every element must belong to exactly one row, otherwise some records would be left uninitialised
+	with pytest.raises(ValueError):
+		matrix(2, 3, [2, 3, 4], [0, 1, 1, 2], [1.0, 2.0, 3.0, 4.0])
+	with pytest.raises(ValueError):
+		matrix(2, 3, [0, 1, 3], [0, 1, 1, 2], [1.0, 2.0, 3.0, 4.0])
+	with pytest.raises(ValueError):
+		matrix(2, 3, [0, 3, 2], [0, 1, 1], [1.0, 2.0, 3.0])
+	a = matrix(2, 3, [0, 0, 4], [0, 1, 1, 2], [1.0, 2.0, 3.0, 4.0])
+	assert records(a) == [(1, 0, 1.0), (1, 1, 2.0), (1, 1, 3.0), (1, 2, 4.0)]
+
+
+def test_spmv():
+	a = matrix(2, 3, [0, 2, 3], [0, 2, 1], [1.0, 2.0, 3.0])
+	x = array.array("d", [1.0, 2.0, 3.0])
+	y = array.array("d", [0.0, 0.0])
+	sparse.spmv(a, x, y)
+	assert list(y) == [7.0, 6.0]
+
+	z = array.array("d", [0.0, 0.0, 0.0])
+	sparse.spmv_t(a, array.array("d", [1.0, 1.0]), z)
+	assert list(z) == [1.0, 3.0, 2.0]
+
+	with pytest.raises(ValueError):
+		sparse.spmv(a, y, y)
+
+
+def test_prune():
+	a = matrix(2, 3, [0, 3, 4], [0, 1, 2, 0], [1.0, -5.0, 0.001, 2.0])
+	sparse.prune(a, k=1)
+	assert sorted(records(a)) == [(0, 1, -5.0), (1, 0, 2.0)]
+
+	b = matrix(2, 3, [0, 3, 4], [0, 1, 2, 0], [1.0, -5.0, 0.001, 2.0])
+	sparse.prune(b, absolute=0.01)
+	assert b.nnz == 3
+	sparse.prune(b, relative=0.5)
+	assert sorted(records(b)) == [(0, 1, -5.0), (1, 0, 2.0)]
+
+
+def test_buffer():
+	a = matrix(2, 2, [0, 1, 2], [1, 0], [1.0, 2.0])
+	with memoryview(a) as view:
+		assert len(view) == 2
+		assert view.itemsize == 16
+		assert view.format == "T{i:i:i:j:d:value:}"
+		assert not view.readonly
+		view.cast("B").cast("d")[1] = 9.0
+	assert records(a) == [(0, 1, 9.0), (1, 0, 2.0)]
+
+
+def test_prune_while_reading():
+	# prune is refused while another thread multiplies the operand, so each product sees a or the pruned a
+	import threading
+
+	n = 300
+	indptr = [0]
+	indices = []
+	for r in range(n):
+		indices += [(r*7 + c*13) % n for c in range(30)]
+		indptr.append(len(indices))
+	a = matrix(n, n, indptr, indices, [1.0]*len(indices))
+	expected = sparse.multiply(a, a).nnz
+
+	products = []
+	worker = threading.Thread(target=lambda: products.extend(sparse.multiply(a, a).nnz for _ in range(20)))
+	worker.start()
+	pruned = False
+	while worker.is_alive() and not pruned:
+		try:
+			sparse.prune(a, absolute=10.0)
+			pruned = True
+		except BufferError:
+			pass
+	worker.join()
+	assert all(p in (expected, 0) for p in products)
+	assert products == sorted(products, reverse=True)
+
+
+def test_buffer_mutation():
+	a = matrix(2, 2, [0, 2, 3], [0, 1, 0], [1.0, 0.001, 2.0])
+	view = memoryview(a)
+	other = memoryview(a)
+	with pytest.raises(BufferError):
+		sparse.prune(a, absolute=0.01)
+	assert a.nnz == 3
+	assert len(view) == 3
+
+	view.release()
+	with pytest.raises(BufferError):
+		sparse.prune(a, absolute=0.01)
+	other.release()
+
+	sparse.prune(a, absolute=0.01)
+	assert a.nnz == 2
+	with memoryview(a) as view:
+		assert len(view) == 2
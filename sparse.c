@@ -9,8 +9,17 @@
 
 #include "sparse.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
 #include "math.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /**
  * @brief Generate the sparse matrix of the matrix associated with pointer in passed
  *
@@ -429,3 +438,7760 @@ int printSparse(const elem_t* matrix) {
 
 	return 1;
 }
+
+/**
+ * @brief Builds an index of the elements of the sparse matrix grouped by row (or by column)
+ *
+ * @param in Pointer to the first element of the sparse matrix
+ * @param byColumn If not 0 elements are grouped by column instead of row
+ * @param ptr Where to store the allocated array of rows+1 offsets into perm
+ * @param perm Where to store the allocated array of positions (0-based, after the first element) of the elements
+ *
+ * @return 0 if errors occurred
+ */
+static int indexSparse(const elem_t* in, const int byColumn, int** ptr, int** perm) {
+
+	int rows = byColumn ? in->j : in->i;
+	int nnz = (int) in->value;
+
+	*ptr = calloc(rows+1, sizeof(int));
+	*perm = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+	if (*ptr == NULL || *perm == NULL) {
+		free(*ptr);
+		free(*perm);
+		return 0;
+	}
+
+	//counting elements of each row
+	for (int k = 0; k < nnz; k++) {
+		(*ptr)[(byColumn ? (in+k+1)->j : (in+k+1)->i) + 1]++;
+	}
+	for (int r = 0; r < rows; r++) {
+		(*ptr)[r+1] += (*ptr)[r];
+	}
+
+	//placing elements, then restoring the offsets
+	for (int k = 0; k < nnz; k++) {
+		int r = byColumn ? (in+k+1)->j : (in+k+1)->i;
+		(*perm)[(*ptr)[r]++] = k;
+	}
+	for (int r = rows; r > 0; r--) {
+		(*ptr)[r] = (*ptr)[r-1];
+	}
+	(*ptr)[0] = 0;
+
+	return 1;
+}
+
+/**
+ * @brief LSD radix sort (one byte per pass) of elements by the key (i-rowbase)*ncols+j
+ *
+ * Keys are unsigned 64 bit integers and the number of passes is the number of bytes of the largest key (at most 8).
+ *
+ * @param a Pointer to the elements to sort
+ * @param tmp Pointer to a buffer of at least len elements
+ * @param len Number of elements
+ * @param rowbase Smallest row index of the elements
+ * @param ncols Number of columns of the matrix
+ */
+static void radixSortElem(elem_t* a, elem_t* tmp, const int len, const int rowbase, const long ncols) {
+
+	//the number of passes depends on the largest key
+	uint64_t maxkey = 0;
+	for (int k = 0; k < len; k++) {
+		uint64_t key = (uint64_t) (a[k].i-rowbase)*(uint64_t) ncols + (uint64_t) a[k].j;
+		if (key > maxkey) {
+			maxkey = key;
+		}
+	}
+	int passes = 1;
+	while (passes < 8 && (maxkey >> (8*passes)) > 0) {
+		passes++;
+	}
+
+	int count[256];
+	elem_t* src = a;
+	elem_t* dst = tmp;
+	for (int pass = 0; pass < passes; pass++) {
+		int shift = 8*pass;
+
+		for (int b = 0; b < 256; b++) {
+			count[b] = 0;
+		}
+		for (int k = 0; k < len; k++) {
+			count[(((uint64_t) (src[k].i-rowbase)*(uint64_t) ncols + (uint64_t) src[k].j) >> shift) & 255]++;
+		}
+		for (int b = 0, sum = 0; b < 256; b++) {
+			int c = count[b];
+			count[b] = sum;
+			sum += c;
+		}
+		for (int k = 0; k < len; k++) {
+			dst[count[(((uint64_t) (src[k].i-rowbase)*(uint64_t) ncols + (uint64_t) src[k].j) >> shift) & 255]++] = src[k];
+		}
+
+		elem_t* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	//after an odd number of passes the result is in tmp
+	if (src != a) {
+		for (int k = 0; k < len; k++) {
+			a[k] = src[k];
+		}
+	}
+}
+
+/**
+ * @brief Sorts the elements by row and then by column with a radix sort on 8 bits at a time, in parallel over chunks
+ * of the elements: each chunk counts its keys, the counts give the position of each chunk in each bucket, and the
+ * chunks are scattered in parallel, so each pass stays stable
+ *
+ * @param a Pointer to the elements to sort
+ * @param tmp Pointer to a buffer of at least len elements
+ * @param len Number of elements
+ * @param ncols Number of columns of the matrix
+ * @param chunks Number of chunks
+ *
+ * @return 0 if errors occurred
+ */
+static int radixSortChunks(elem_t* a, elem_t* tmp, const int len, const long ncols, const int chunks) {
+
+	int* count = malloc((long) chunks*256*sizeof(int));
+	if (count == NULL) {
+		return 0;
+	}
+
+	uint64_t maxkey = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) reduction(max:maxkey)
+#endif
+	for (int k = 0; k < len; k++) {
+		uint64_t key = (uint64_t) a[k].i*(uint64_t) ncols + (uint64_t) a[k].j;
+		if (key > maxkey) {
+			maxkey = key;
+		}
+	}
+	int passes = 1;
+	while (passes < 8 && (maxkey >> (8*passes)) > 0) {
+		passes++;
+	}
+
+	elem_t* src = a;
+	elem_t* dst = tmp;
+	for (int pass = 0; pass < passes; pass++) {
+		int shift = 8*pass;
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static, 1)
+#endif
+		for (int c = 0; c < chunks; c++) {
+			int* ccount = count+(long) c*256;
+			int lo = (int) ((long) len*c/chunks);
+			int hi = (int) ((long) len*(c+1)/chunks);
+			for (int b = 0; b < 256; b++) {
+				ccount[b] = 0;
+			}
+			for (int k = lo; k < hi; k++) {
+				ccount[(((uint64_t) src[k].i*(uint64_t) ncols + (uint64_t) src[k].j) >> shift) & 255]++;
+			}
+		}
+
+		//bucket by bucket, the chunks in order
+		int sum = 0;
+		for (int b = 0; b < 256; b++) {
+			for (int c = 0; c < chunks; c++) {
+				int n = count[(long) c*256+b];
+				count[(long) c*256+b] = sum;
+				sum += n;
+			}
+		}
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static, 1)
+#endif
+		for (int c = 0; c < chunks; c++) {
+			int* ccount = count+(long) c*256;
+			int lo = (int) ((long) len*c/chunks);
+			int hi = (int) ((long) len*(c+1)/chunks);
+			for (int k = lo; k < hi; k++) {
+				dst[ccount[(((uint64_t) src[k].i*(uint64_t) ncols + (uint64_t) src[k].j) >> shift) & 255]++] = src[k];
+			}
+		}
+
+		elem_t* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	//after an odd number of passes the result is in tmp
+	if (src != a) {
+		memcpy(a, src, (size_t) len*sizeof(elem_t));
+	}
+
+	free(count);
+
+	return 1;
+}
+
+/**
+ * @brief Sorts the elements of the sparse matrix by row and then by column with a radix sort
+ *
+ * With OpenMP, matrixes of at least 2*SORT_CHUNK elements are sorted in parallel over chunks of the elements.
+ *
+ * @param matrix Pointer to the first element of the sparse matrix
+ *
+ * @return 0 if errors occurred
+ */
+int sortSparse(elem_t* matrix) {
+
+	//check
+	if (matrix == NULL) {
+		return 0;
+	}
+
+	int nnz = (int) matrix->value;
+	if (nnz < 2) {
+		return 1;
+	}
+
+	elem_t* tmp = malloc(nnz*sizeof(elem_t));
+	if (tmp == NULL) {
+		return 0;
+	}
+
+	int chunks = 1;
+#ifdef _OPENMP
+	chunks = omp_get_max_threads();
+#endif
+	if (chunks > nnz/SORT_CHUNK) {
+		chunks = nnz/SORT_CHUNK;
+	}
+
+	int ok = 1;
+	if (chunks > 1) {
+		ok = radixSortChunks(matrix+1, tmp, nnz, matrix->j, chunks);
+	} else {
+		radixSortElem(matrix+1, tmp, nnz, 0, matrix->j);
+	}
+
+	free(tmp);
+
+	return ok;
+}
+
+/**
+ * @brief Multiplies two sparse matrixes with the expand-sort-compress method and stores the sorted result in the sparse matrix pointed by out
+ *
+ * Partial products are expanded for batches of rows of in1 (about ESC_BATCH at a time), so the working memory doesn't
+ * depend on the size of the product (a row with more partial products gets a buffer of its own size, released after
+ * it). Each row is sorted and compressed in its own part of the buffer, in parallel when built with OpenMP.
+ *
+ * Unlike multiplySparse, only the elements that sum exactly to zero are dropped: elements below INFVALUE are kept.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ *
+ * @return 0 if errors occurred (also if a row has more than INT_MAX partial products)
+ */
+int multiplySparse_ESC(elem_t* out, const elem_t* in1, const elem_t* in2) {
+
+	//checking if matrixes are compatible
+	if (out == NULL || in1 == NULL || in2 == NULL || in1->j != in2->i) {
+		return 0;
+	}
+
+	int size = (int) out->value;
+	int m = in1->i;
+
+	//row indexes of both matrixes
+	int* ptr1;
+	int* perm1;
+	int* ptr2;
+	int* perm2;
+	if (!indexSparse(in1, 0, &ptr1, &perm1)) {
+		return 0;
+	}
+	if (!indexSparse(in2, 0, &ptr2, &perm2)) {
+		free(ptr1);
+		free(perm1);
+		return 0;
+	}
+
+	//offsets of the partial products of each row, and length of each compressed row
+	long* rowoff = malloc((m+1)*sizeof(long));
+	int* rowlen = malloc((m > 0 ? m : 1)*sizeof(int));
+	long cap = ESC_BATCH;
+	elem_t* buf = malloc(2*cap*sizeof(elem_t));
+	int nout_new = 0;
+	int ok = (rowoff != NULL && rowlen != NULL && buf != NULL);
+
+	if (ok) {
+		rowoff[0] = 0;
+		for (int r = 0; r < m; r++) {
+			long rowproducts = 0;
+			for (int p = ptr1[r]; p < ptr1[r+1]; p++) {
+				int k = (in1+perm1[p]+1)->j;
+				rowproducts += ptr2[k+1] - ptr2[k];
+			}
+			rowoff[r+1] = rowoff[r] + rowproducts;
+		}
+	}
+
+	int r0 = 0;
+	while (ok && r0 < m) {
+
+		//choosing the rows of the batch, a single row can be bigger than the batch
+		int r1 = r0+1;
+		while (r1 < m && rowoff[r1+1] - rowoff[r0] <= ESC_BATCH) {
+			r1++;
+		}
+		long products = rowoff[r1] - rowoff[r0];
+
+		//the buffer grows for a big row (whose length must fit an int) and shrinks back after it
+		if (products > INT_MAX) {
+			ok = 0;
+			break;
+		}
+		if (products > cap || (cap > ESC_BATCH && products <= ESC_BATCH)) {
+			long newcap = products > ESC_BATCH ? products : ESC_BATCH;
+			elem_t* resized = realloc(buf, 2*newcap*sizeof(elem_t));
+			if (resized == NULL) {
+				ok = 0;
+				break;
+			}
+			buf = resized;
+			cap = newcap;
+		}
+
+		//expand, sort and compress each row in its own part of the buffer
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for (int r = r0; r < r1; r++) {
+			elem_t* row = buf + (rowoff[r] - rowoff[r0]);
+			int len = 0;
+			for (int p = ptr1[r]; p < ptr1[r+1]; p++) {
+				elem_t curr1 = *(in1+perm1[p]+1);
+				for (int q = ptr2[curr1.j]; q < ptr2[curr1.j+1]; q++) {
+					elem_t curr2 = *(in2+perm2[q]+1);
+					row[len].i = r;
+					row[len].j = curr2.j;
+					row[len].value = curr1.value*curr2.value;
+					len++;
+				}
+			}
+
+			//short rows are sorted by insertion
+			if (len < 32) {
+				for (int k = 1; k < len; k++) {
+					elem_t curr = row[k];
+					int h = k;
+					for (; h > 0 && row[h-1].j > curr.j; h--) {
+						row[h] = row[h-1];
+					}
+					row[h] = curr;
+				}
+			} else {
+				radixSortElem(row, row+cap, len, r, in2->j);
+			}
+
+			int nrow = 0;
+			for (int k = 0; k < len;) {
+				elem_t curr = row[k];
+				for (k++; k < len && row[k].j == curr.j; k++) {
+					curr.value += row[k].value;
+				}
+				if (curr.value != 0) {
+					row[nrow++] = curr;
+				}
+			}
+			rowlen[r] = nrow;
+		}
+
+		//rows are copied in order
+		for (int r = r0; ok && r < r1; r++) {
+			if (nout_new + rowlen[r] > size) {
+				ok = 0;
+				break;
+			}
+			memcpy(out+nout_new+1, buf + (rowoff[r] - rowoff[r0]), rowlen[r]*sizeof(elem_t));
+			nout_new += rowlen[r];
+		}
+
+		r0 = r1;
+	}
+
+	free(buf);
+	free(rowoff);
+	free(rowlen);
+	free(ptr1);
+	free(perm1);
+	free(ptr2);
+	free(perm2);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = in1->i;
+	out->j = in2->j;
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Adds alpha times the sparse matrix pointed by in to the sparse matrix pointed by out, in place
+ *
+ * Elements already present in out are only updated, new elements are appended after the last element of out
+ * (which is never reallocated) and zeros aren't deleted, so the pattern of out stays stable between calls.
+ *
+ * @param out Pointer to the first element of the sparse matrix to update
+ * @param size Number of elements allocated for out (first element excluded)
+ * @param in Pointer to the first element of the sparse matrix to add
+ * @param alpha Coefficient of in
+ *
+ * @return 0 if errors occurred (out isn't modified)
+ */
+int accumulateSparse(elem_t* out, const int size, const elem_t* in, const double alpha) {
+
+	//checking if matrixes are compatible
+	if (out == NULL || in == NULL || out->i != in->i || out->j != in->j) {
+		return 0;
+	}
+
+	int nout = (int) out->value;
+	int nin = (int) in->value;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(out, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	//position in out of each element of in, missing ones are collected apart
+	int* slot = malloc((nin > 0 ? nin : 1)*sizeof(int));
+	elem_t* missing = malloc(2*(nin > 0 ? nin : 1)*sizeof(elem_t));
+	if (slot == NULL || missing == NULL) {
+		free(slot);
+		free(missing);
+		free(ptr);
+		free(perm);
+		return 0;
+	}
+
+	int nmissing = 0;
+	for (int k = 0; k < nin; k++) {
+		elem_t curr = *(in+k+1);
+
+		slot[k] = -1;
+		for (int p = ptr[curr.i]; p < ptr[curr.i+1]; p++) {
+			if ((out+perm[p]+1)->j == curr.j) {
+				slot[k] = perm[p];
+				break;
+			}
+		}
+
+		if (slot[k] < 0) {
+			missing[nmissing] = curr;
+			nmissing++;
+		}
+	}
+
+	//the same new position can appear more than once in in
+	radixSortElem(missing, missing+nin, nmissing, 0, in->j);
+	int nnew = 0;
+	for (int k = 0; k < nmissing;) {
+		elem_t curr = missing[k];
+		for (k++; k < nmissing && missing[k].i == curr.i && missing[k].j == curr.j; k++) {
+			curr.value += missing[k].value;
+		}
+		missing[nnew] = curr;
+		nnew++;
+	}
+
+	int ok = (nout + nnew <= size);
+	if (ok) {
+		//updating existing values
+		for (int k = 0; k < nin; k++) {
+			if (slot[k] >= 0) {
+				(out+slot[k]+1)->value += alpha*(in+k+1)->value;
+			}
+		}
+
+		//appending new elements in the free space
+		for (int k = 0; k < nnew; k++) {
+			(out+nout+k+1)->i = missing[k].i;
+			(out+nout+k+1)->j = missing[k].j;
+			(out+nout+k+1)->value = alpha*missing[k].value;
+		}
+		out->value = nout + nnew;
+	}
+
+	free(slot);
+	free(missing);
+	free(ptr);
+	free(perm);
+
+	return ok;
+}
+
+/**
+ * @brief Adds alpha times the product of the sparse matrixes pointed by in1 and in2 to the sparse matrix pointed by out, in place
+ *
+ * Partial products are added to out one row at a time, the product isn't built and no value is dropped.
+ * New elements are appended after the last element of out as in accumulateSparse.
+ *
+ * @param out Pointer to the first element of the sparse matrix to update
+ * @param size Number of elements allocated for out (first element excluded)
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ * @param alpha Coefficient of the product
+ *
+ * @return 0 if errors occurred (out isn't modified)
+ */
+int accumulateMultiplySparse(elem_t* out, const int size, const elem_t* in1, const elem_t* in2, const double alpha) {
+
+	//checking if matrixes are compatible
+	if (out == NULL || in1 == NULL || in2 == NULL || in1->j != in2->i || out->i != in1->i || out->j != in2->j) {
+		return 0;
+	}
+
+	int nout = (int) out->value;
+	int n = in2->j;
+
+	//row indexes of out, in1 and in2
+	int* ptr;
+	int* perm;
+	int* ptr1;
+	int* perm1;
+	int* ptr2;
+	int* perm2;
+	if (!indexSparse(out, 0, &ptr, &perm)) {
+		return 0;
+	}
+	if (!indexSparse(in1, 0, &ptr1, &perm1)) {
+		free(ptr);
+		free(perm);
+		return 0;
+	}
+	if (!indexSparse(in2, 0, &ptr2, &perm2)) {
+		free(ptr);
+		free(perm);
+		free(ptr1);
+		free(perm1);
+		return 0;
+	}
+
+	//position in out of each column of the current row, -1 if missing
+	int* pos = malloc((n > 0 ? n : 1)*sizeof(int));
+	if (pos == NULL) {
+		free(ptr);
+		free(perm);
+		free(ptr1);
+		free(perm1);
+		free(ptr2);
+		free(perm2);
+		return 0;
+	}
+	for (int j = 0; j < n; j++) {
+		pos[j] = -1;
+	}
+
+	//first pass: counting the new elements, so out isn't modified if they don't fit
+	int nnew = 0;
+	for (int r = 0; r < out->i; r++) {
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			pos[(out+perm[p]+1)->j] = perm[p];
+		}
+		int first = nnew;
+		for (int p = ptr1[r]; p < ptr1[r+1]; p++) {
+			int k = (in1+perm1[p]+1)->j;
+			for (int q = ptr2[k]; q < ptr2[k+1]; q++) {
+				int j = (in2+perm2[q]+1)->j;
+				if (pos[j] < 0) {
+					pos[j] = nout+nnew;
+					nnew++;
+				}
+			}
+		}
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			pos[(out+perm[p]+1)->j] = -1;
+		}
+		for (int p = ptr1[r]; p < ptr1[r+1] && nnew > first; p++) {
+			int k = (in1+perm1[p]+1)->j;
+			for (int q = ptr2[k]; q < ptr2[k+1]; q++) {
+				pos[(in2+perm2[q]+1)->j] = -1;
+			}
+		}
+	}
+
+	int ok = (nout + nnew <= size);
+
+	//second pass: each partial product goes straight into out
+	nnew = 0;
+	for (int r = 0; ok && r < out->i; r++) {
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			pos[(out+perm[p]+1)->j] = perm[p];
+		}
+		int first = nnew;
+		for (int p = ptr1[r]; p < ptr1[r+1]; p++) {
+			elem_t curr1 = *(in1+perm1[p]+1);
+			for (int q = ptr2[curr1.j]; q < ptr2[curr1.j+1]; q++) {
+				elem_t curr2 = *(in2+perm2[q]+1);
+				if (pos[curr2.j] < 0) {
+					pos[curr2.j] = nout+nnew;
+					(out+nout+nnew+1)->i = r;
+					(out+nout+nnew+1)->j = curr2.j;
+					(out+nout+nnew+1)->value = 0;
+					nnew++;
+				}
+				(out+pos[curr2.j]+1)->value += alpha*curr1.value*curr2.value;
+			}
+		}
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			pos[(out+perm[p]+1)->j] = -1;
+		}
+		for (int k = first; k < nnew; k++) {
+			pos[(out+nout+k+1)->j] = -1;
+		}
+	}
+	if (ok) {
+		out->value = nout + nnew;
+	}
+
+	free(pos);
+	free(ptr);
+	free(perm);
+	free(ptr1);
+	free(perm1);
+	free(ptr2);
+	free(perm2);
+
+	return ok;
+}
+
+/**
+ * @brief Finds the k-th largest value with quickselect (the array is reordered)
+ *
+ * @param a Pointer to the values
+ * @param len Number of values
+ * @param k Rank of the value to find, from 1 to len
+ *
+ * @return the k-th largest value
+ */
+static double selectLargest(double* a, const int len, const int k) {
+
+	int lo = 0;
+	int hi = len-1;
+	int target = k-1;
+
+	while (lo < hi) {
+		double pivot = a[(lo+hi)/2];
+		int l = lo;
+		int h = hi;
+
+		//partition in decreasing order
+		while (l <= h) {
+			while (a[l] > pivot) {
+				l++;
+			}
+			while (a[h] < pivot) {
+				h--;
+			}
+			if (l <= h) {
+				double tmp = a[l];
+				a[l] = a[h];
+				a[h] = tmp;
+				l++;
+				h--;
+			}
+		}
+
+		if (target <= h) {
+			hi = h;
+		} else if (target >= l) {
+			lo = l;
+		} else {
+			break;
+		}
+	}
+
+	return a[target];
+}
+
+/**
+ * @brief Prunes the elements of a single row, keeping their order
+ *
+ * @param row Pointer to the elements of the row
+ * @param len Number of elements of the row
+ * @param k Maximum number of elements kept (0 to keep all of them)
+ * @param absolute Elements with absolute value below this threshold are deleted
+ * @param relative Elements with absolute value below relative times the largest absolute value are deleted
+ * @param work Pointer to a buffer of at least len values
+ *
+ * @return the number of elements kept
+ */
+static int pruneRow(elem_t* row, const int len, const int k, const double absolute, const double relative, double* work) {
+
+	//threshold of the row
+	double largest = 0;
+	for (int p = 0; p < len; p++) {
+		if (fabs(row[p].value) > largest) {
+			largest = fabs(row[p].value);
+		}
+	}
+	double threshold = absolute > relative*largest ? absolute : relative*largest;
+
+	int nkept = 0;
+	for (int p = 0; p < len; p++) {
+		if (fabs(row[p].value) >= threshold) {
+			work[nkept] = fabs(row[p].value);
+			nkept++;
+		}
+	}
+
+	//the k-th largest value becomes the threshold, ties are kept in order until k
+	int ties = nkept;
+	if (k > 0 && nkept > k) {
+		double kth = selectLargest(work, nkept, k);
+		ties = k;
+		for (int p = 0; p < k; p++) {
+			if (work[p] > kth) {
+				ties--;
+			}
+		}
+		threshold = kth;
+	}
+
+	int nout = 0;
+	for (int p = 0; p < len; p++) {
+		double v = fabs(row[p].value);
+		if (v < threshold || (v == threshold && ties == 0)) {
+			continue;
+		}
+		if (v == threshold) {
+			ties--;
+		}
+		row[nout] = row[p];
+		nout++;
+	}
+
+	return nout;
+}
+
+/**
+ * @brief Prunes each row of the sparse matrix, keeping at most k elements with the largest absolute values
+ * and deleting elements below an absolute or relative (to the largest absolute value of the row) threshold
+ *
+ * The elements of the matrix are left sorted by row and column. Rows are pruned in parallel with OpenMP.
+ *
+ * @param matrix Pointer to the first element of the sparse matrix
+ * @param k Maximum number of elements kept in each row (0 to keep all of them)
+ * @param absolute Elements with absolute value below this threshold are deleted
+ * @param relative Elements with absolute value below relative times the largest absolute value of their row are deleted
+ *
+ * @return 0 if errors occurred
+ */
+int pruneSparse(elem_t* matrix, const int k, const double absolute, const double relative) {
+
+	//rows must be contiguous
+	if (k < 0 || !sortSparse(matrix)) {
+		return 0;
+	}
+
+	int nnz = (int) matrix->value;
+
+	//first element of each row
+	int* start = malloc((nnz+1)*sizeof(int));
+	if (start == NULL) {
+		return 0;
+	}
+	int nrows = 0;
+	for (int p = 0; p < nnz; p++) {
+		if (p == 0 || (matrix+p+1)->i != (matrix+p)->i) {
+			start[nrows] = p;
+			nrows++;
+		}
+	}
+	start[nrows] = nnz;
+	int maxlen = 1;
+	for (int r = 0; r < nrows; r++) {
+		maxlen = start[r+1]-start[r] > maxlen ? start[r+1]-start[r] : maxlen;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	double* work = malloc((long) threads*maxlen*sizeof(double));
+	int* kept = malloc((nrows > 0 ? nrows : 1)*sizeof(int));
+	if (work == NULL || kept == NULL) {
+		free(start);
+		free(work);
+		free(kept);
+		return 0;
+	}
+
+	//each row is pruned in its own place
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int r = 0; r < nrows; r++) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		kept[r] = pruneRow(matrix+start[r]+1, start[r+1]-start[r], k, absolute, relative, work + (long) t*maxlen);
+	}
+
+	//moving the kept elements next to the previous row
+	int nout_new = 0;
+	for (int r = 0; r < nrows; r++) {
+		for (int p = 0; p < kept[r]; p++) {
+			*(matrix+nout_new+p+1) = *(matrix+start[r]+p+1);
+		}
+		nout_new += kept[r];
+	}
+
+	matrix->value = nout_new;
+
+	free(start);
+	free(work);
+	free(kept);
+
+	return 1;
+}
+
+/**
+ * @brief Multiplies two sparse matrixes row by row, pruning each row of the result as pruneSparse does before storing it
+ * in the sparse matrix pointed by out, so the full product is never stored
+ *
+ * Batches of rows are computed in parallel with OpenMP (each thread with its own dense accumulator), each pruned row
+ * in its own part of a buffer, then copied in order.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ * @param k Maximum number of elements kept in each row (0 to keep all of them)
+ * @param absolute Elements with absolute value below this threshold are deleted
+ * @param relative Elements with absolute value below relative times the largest absolute value of their row are deleted
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_Prune(elem_t* out, const elem_t* in1, const elem_t* in2, const int k, const double absolute, const double relative) {
+
+	//checking if matrixes are compatible
+	if (out == NULL || in1 == NULL || in2 == NULL || in1->j != in2->i || k < 0) {
+		return 0;
+	}
+
+	int size = (int) out->value;
+	int m = in1->i;
+	int n = in2->j;
+
+	int* ptr1;
+	int* perm1;
+	int* ptr2;
+	int* perm2;
+	if (!indexSparse(in1, 0, &ptr1, &perm1)) {
+		return 0;
+	}
+	if (!indexSparse(in2, 0, &ptr2, &perm2)) {
+		free(ptr1);
+		free(perm1);
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	long width = n > 0 ? n : 1;
+
+	//dense accumulator of one row of the result for each thread
+	double* acc = malloc(threads*width*sizeof(double));
+	int* mark = malloc(threads*width*sizeof(int));
+	elem_t* row = malloc(threads*2*width*sizeof(elem_t));
+	double* work = malloc(threads*width*sizeof(double));
+
+	//offsets of the pruned rows, each one has at most as many elements as partial products, columns and k
+	long* rowoff = malloc((m+1)*sizeof(long));
+	int* rowlen = malloc((m > 0 ? m : 1)*sizeof(int));
+	long batch = (long) threads*ESC_BATCH;
+	long cap = batch;
+	elem_t* buf = malloc(cap*sizeof(elem_t));
+	int ok = (acc != NULL && mark != NULL && row != NULL && work != NULL && rowoff != NULL && rowlen != NULL && buf != NULL);
+
+	for (long c = 0; ok && c < threads*width; c++) {
+		mark[c] = -1;
+	}
+	if (ok) {
+		rowoff[0] = 0;
+		for (int i = 0; i < m; i++) {
+			long bound = 0;
+			for (int p = ptr1[i]; p < ptr1[i+1]; p++) {
+				int h = (in1+perm1[p]+1)->j;
+				bound += ptr2[h+1] - ptr2[h];
+			}
+			bound = bound < n ? bound : n;
+			bound = (k > 0 && bound > k) ? k : bound;
+			rowoff[i+1] = rowoff[i] + bound;
+		}
+	}
+
+	int nout_new = 0;
+	int i0 = 0;
+	while (ok && i0 < m) {
+
+		//rows of the batch, a single row is at most n long
+		int i1 = i0+1;
+		while (i1 < m && rowoff[i1+1] - rowoff[i0] <= batch) {
+			i1++;
+		}
+		if (rowoff[i1] - rowoff[i0] > cap) {
+			elem_t* bigger = realloc(buf, (rowoff[i1] - rowoff[i0])*sizeof(elem_t));
+			if (bigger == NULL) {
+				ok = 0;
+				break;
+			}
+			buf = bigger;
+			cap = rowoff[i1] - rowoff[i0];
+		}
+
+		//each row is accumulated, pruned and stored in its own part of the buffer
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for (int i = i0; i < i1; i++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			double* tacc = acc + t*width;
+			int* tmark = mark + t*width;
+			elem_t* trow = row + t*2*width;
+
+			int len = 0;
+			for (int p = ptr1[i]; p < ptr1[i+1]; p++) {
+				elem_t curr1 = *(in1+perm1[p]+1);
+				for (int q = ptr2[curr1.j]; q < ptr2[curr1.j+1]; q++) {
+					elem_t curr2 = *(in2+perm2[q]+1);
+					if (tmark[curr2.j] != i) {
+						tmark[curr2.j] = i;
+						tacc[curr2.j] = 0;
+						trow[len].i = i;
+						trow[len].j = curr2.j;
+						len++;
+					}
+					tacc[curr2.j] += curr1.value*curr2.value;
+				}
+			}
+
+			//gathering the nonzero elements of the row, only the thresholds of the caller prune them
+			int nrow = 0;
+			for (int p = 0; p < len; p++) {
+				if (tacc[trow[p].j] != 0) {
+					trow[nrow].i = i;
+					trow[nrow].j = trow[p].j;
+					trow[nrow].value = tacc[trow[p].j];
+					nrow++;
+				}
+			}
+
+			radixSortElem(trow, trow+width, nrow, i, n);
+			nrow = pruneRow(trow, nrow, k, absolute, relative, work + t*width);
+
+			memcpy(buf + (rowoff[i] - rowoff[i0]), trow, nrow*sizeof(elem_t));
+			rowlen[i] = nrow;
+		}
+
+		//rows are copied in order
+		for (int i = i0; ok && i < i1; i++) {
+			if (nout_new + rowlen[i] > size) {
+				ok = 0;
+				break;
+			}
+			memcpy(out+nout_new+1, buf + (rowoff[i] - rowoff[i0]), rowlen[i]*sizeof(elem_t));
+			nout_new += rowlen[i];
+		}
+
+		i0 = i1;
+	}
+
+	free(buf);
+	free(rowoff);
+	free(rowlen);
+	free(acc);
+	free(mark);
+	free(row);
+	free(work);
+	free(ptr1);
+	free(perm1);
+	free(ptr2);
+	free(perm2);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = m;
+	out->j = n;
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Raises each element of the sparse matrix to the passed power and normalizes the rows to sum 1, in place
+ *
+ * Elements can be in any order, rows are inflated and normalized in parallel with OpenMP.
+ *
+ * @param matrix Pointer to the first element of the sparse matrix
+ * @param power Exponent applied to the absolute value of each element
+ *
+ * @return 0 if errors occurred
+ */
+int inflateSparse(elem_t* matrix, const double power) {
+
+	//check
+	if (matrix == NULL) {
+		return 0;
+	}
+
+	int m = matrix->i;
+
+	//elements grouped by row, so each row is normalized on its own
+	int* ptr;
+	int* perm;
+	if (!indexSparse(matrix, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 256)
+#endif
+	for (int r = 0; r < m; r++) {
+		double sum = 0;
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			elem_t* curr = matrix+perm[p]+1;
+			curr->value = power == 1 ? fabs(curr->value) : pow(fabs(curr->value), power);
+			sum += curr->value;
+		}
+		if (sum > 0) {
+			for (int p = ptr[r]; p < ptr[r+1]; p++) {
+				(matrix+perm[p]+1)->value /= sum;
+			}
+		}
+	}
+
+	free(ptr);
+	free(perm);
+
+	return 1;
+}
+
+/**
+ * @brief Markov clustering of the graph whose adjacency matrix is the sparse matrix pointed by in
+ *
+ * The matrix is used as row stochastic (row v holds the transition probabilities from vertex v) and self loops
+ * should already be present. Each iteration squares the matrix with multiplySparse_Prune, so only one row of the
+ * product exists at a time for each thread, then inflates it with inflateSparse, until the chaos (largest difference,
+ * over the rows, between the largest value and the sum of the squares) is below tol. Expansion, inflation and chaos
+ * run in parallel over the rows with OpenMP.
+ *
+ * @param out Pointer to the first element of the limit sparse matrix, out->value must contain the number of elements allocated
+ * @param clusters Pointer to an array of in->i integers where the attractor of each vertex is stored (can be NULL)
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param inflation Inflation exponent (usually 2)
+ * @param k Maximum number of elements kept in each row after expansion (0 to keep all of them)
+ * @param threshold Elements below this value are pruned after expansion
+ * @param maxIter Maximum number of iterations
+ * @param tol Chaos under which the iterations stop
+ *
+ * @return 0 if errors occurred
+ */
+int mclSparse(elem_t* out, int* clusters, const elem_t* in, const double inflation, const int k, const double threshold, const int maxIter, const double tol) {
+
+	//check
+	if (out == NULL || in == NULL || in->i != in->j || in->value > out->value) {
+		return 0;
+	}
+
+	int size = (int) out->value;
+	int m = in->i;
+	int nnz = (int) in->value;
+
+	elem_t* next = malloc((size+1)*sizeof(elem_t));
+	double* maxrow = malloc((m > 0 ? m : 1)*sizeof(double));
+	double* sumsq = malloc((m > 0 ? m : 1)*sizeof(double));
+	if (next == NULL || maxrow == NULL || sumsq == NULL) {
+		free(next);
+		free(maxrow);
+		free(sumsq);
+		return 0;
+	}
+
+	//starting from the normalized matrix
+	for (int c = 0; c < nnz+1; c++) {
+		*(out+c) = *(in+c);
+	}
+	int ok = inflateSparse(out, 1);
+
+	for (int iter = 0; ok && iter < maxIter; iter++) {
+
+		//expansion with pruning, then inflation
+		next->value = size;
+		if (!multiplySparse_Prune(next, out, out, k, threshold, 0) || !inflateSparse(next, inflation)) {
+			ok = 0;
+			break;
+		}
+
+		memcpy(out, next, ((size_t) next->value+1)*sizeof(elem_t));
+
+		//chaos, rows of the product are contiguous
+		for (int r = 0; r < m; r++) {
+			maxrow[r] = 0;
+			sumsq[r] = 0;
+		}
+		int nnzout = (int) out->value;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for (int c = 0; c < nnzout; c++) {
+			elem_t curr = *(out+c+1);
+			if (c > 0 && (out+c)->i == curr.i) {
+				continue;
+			}
+			for (int h = c; h < nnzout && (out+h+1)->i == curr.i; h++) {
+				double v = (out+h+1)->value;
+				maxrow[curr.i] = v > maxrow[curr.i] ? v : maxrow[curr.i];
+				sumsq[curr.i] += v*v;
+			}
+		}
+		double chaos = 0;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) reduction(max:chaos)
+#endif
+		for (int r = 0; r < m; r++) {
+			if (maxrow[r] - sumsq[r] > chaos) {
+				chaos = maxrow[r] - sumsq[r];
+			}
+		}
+
+		if (chaos < tol) {
+			break;
+		}
+	}
+
+	//each vertex belongs to the cluster of the attractor it flows to
+	if (ok && clusters != NULL) {
+		for (int r = 0; r < m; r++) {
+			clusters[r] = r;
+			maxrow[r] = 0;
+		}
+		for (int c = 0; c < (int) out->value; c++) {
+			elem_t curr = *(out+c+1);
+			if (curr.value > maxrow[curr.i]) {
+				maxrow[curr.i] = curr.value;
+				clusters[curr.i] = curr.j;
+			}
+		}
+	}
+
+	free(next);
+	free(maxrow);
+	free(sumsq);
+
+	if (!ok) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Scratch of a thread of similaritySparse: accumulator of one row, with open addressing */
+struct simscratch {
+	int cap; //number of slots of the table (a power of 2)
+	int* keys; //row of each slot, -1 if free
+	double* vals; //accumulated value of each slot
+	int* used; //slots in use
+	elem_t* row; //similarities of the row, 2*cap elements (the second half for sorting)
+	double* work; //buffer of pruneRow
+};
+
+/**
+ * @brief Grows the scratch of similaritySparse to at least the passed number of slots, all free
+ *
+ * @param scratch Pointer to the scratch
+ * @param cap Number of slots (a power of 2)
+ *
+ * @return 0 if errors occurred
+ */
+static int simGrow(struct simscratch* scratch, const int cap) {
+
+	if (scratch->cap >= cap) {
+		return 1;
+	}
+
+	free(scratch->keys);
+	free(scratch->vals);
+	free(scratch->used);
+	free(scratch->row);
+	free(scratch->work);
+	scratch->keys = malloc(cap*sizeof(int));
+	scratch->vals = malloc(cap*sizeof(double));
+	scratch->used = malloc(cap*sizeof(int));
+	scratch->row = malloc(2L*cap*sizeof(elem_t));
+	scratch->work = malloc(cap*sizeof(double));
+	if (scratch->keys == NULL || scratch->vals == NULL || scratch->used == NULL || scratch->row == NULL || scratch->work == NULL) {
+		scratch->cap = 0;
+		return 0;
+	}
+
+	scratch->cap = cap;
+	for (int h = 0; h < cap; h++) {
+		scratch->keys[h] = -1;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the similarities between the rows of the sparse matrix pointed by in
+ * that are at least threshold, without storing the product of in by its transpose
+ *
+ * Rows are computed one at a time, in parallel with OpenMP, each one in a hash accumulator sized by the rows sharing
+ * a column with it (no array of in->i elements per thread). Its similarities above the threshold are pruned to the
+ * top k as soon as the row is complete, so out only needs room for the result. The result is sorted by row and
+ * column, the diagonal isn't stored and rows with zero norm have no similarities.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the sparse matrix whose rows are compared
+ * @param metric SIMILARITY_COSINE or SIMILARITY_JACCARD (of the patterns of the rows)
+ * @param threshold Pairs with similarity below this value aren't stored
+ * @param k Maximum number of elements kept in each row (0 to keep all of them)
+ *
+ * @return 0 if errors occurred
+ */
+int similaritySparse(elem_t* out, const elem_t* in, const int metric, const double threshold, const int k) {
+
+	//check
+	if (out == NULL || in == NULL || k < 0 || (metric != SIMILARITY_COSINE && metric != SIMILARITY_JACCARD)) {
+		return 0;
+	}
+
+	int size = (int) out->value;
+	int m = in->i;
+
+	int* ptr;
+	int* perm;
+	int* colptr;
+	int* colperm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+	if (!indexSparse(in, 1, &colptr, &colperm)) {
+		free(ptr);
+		free(perm);
+		return 0;
+	}
+
+	//norm of each row (number of elements for jaccard), and number of candidate products of each row
+	double* norm = malloc((m > 0 ? m : 1)*sizeof(double));
+	long* candidates = malloc((m > 0 ? m : 1)*sizeof(long));
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int block = 256;
+	struct simscratch* scratch = calloc(threads, sizeof(struct simscratch));
+	elem_t** rowout = calloc(block, sizeof(elem_t*));
+	int* rowlen = malloc(block*sizeof(int));
+	int ok = (norm != NULL && candidates != NULL && scratch != NULL && rowout != NULL && rowlen != NULL);
+
+	for (int r = 0; ok && r < m; r++) {
+		norm[r] = 0;
+		candidates[r] = 0;
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			elem_t curr = *(in+perm[p]+1);
+			norm[r] += metric == SIMILARITY_COSINE ? curr.value*curr.value : 1;
+			candidates[r] += colptr[curr.j+1] - colptr[curr.j];
+		}
+		if (metric == SIMILARITY_COSINE) {
+			norm[r] = sqrt(norm[r]);
+		}
+	}
+
+	//blocks of rows are compared in parallel, then stored in order
+	int nout_new = 0;
+	for (int i0 = 0; ok && i0 < m; i0 += block) {
+		int i1 = i0+block < m ? i0+block : m;
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 8)
+#endif
+		for (int i = i0; i < i1; i++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			struct simscratch* ts = scratch+t;
+
+			rowout[i-i0] = NULL;
+			rowlen[i-i0] = 0;
+
+			//rows with zero norm have no similarity
+			if (norm[i] == 0 || candidates[i] == 0) {
+				continue;
+			}
+
+			//the table has at least twice as many slots as the rows that can share a column with row i
+			long distinct = candidates[i] < m ? candidates[i] : m;
+			int cap = 16;
+			int shift = 28;
+			while (cap < 2*distinct) {
+				cap *= 2;
+				shift--;
+			}
+			if (!simGrow(ts, cap)) {
+				rowlen[i-i0] = -1;
+				continue;
+			}
+			int mask = cap-1;
+
+			//products with the other rows sharing a column
+			int len = 0;
+			for (int p = ptr[i]; p < ptr[i+1]; p++) {
+				elem_t curr1 = *(in+perm[p]+1);
+				for (int q = colptr[curr1.j]; q < colptr[curr1.j+1]; q++) {
+					elem_t curr2 = *(in+colperm[q]+1);
+					if (curr2.i == i) {
+						continue;
+					}
+					int h = (int) (((uint32_t) curr2.i*2654435761u) >> shift);
+					while (ts->keys[h] != curr2.i && ts->keys[h] >= 0) {
+						h = (h+1) & mask;
+					}
+					if (ts->keys[h] < 0) {
+						ts->keys[h] = curr2.i;
+						ts->vals[h] = 0;
+						ts->used[len] = h;
+						len++;
+					}
+					ts->vals[h] += metric == SIMILARITY_COSINE ? curr1.value*curr2.value : 1;
+				}
+			}
+
+			//similarities above the threshold, sorted by column, then the top k
+			int nrow = 0;
+			for (int p = 0; p < len; p++) {
+				int h = ts->used[p];
+				int r = ts->keys[h];
+				double acc = ts->vals[h];
+				ts->keys[h] = -1;
+				if (norm[r] == 0) {
+					continue;
+				}
+				double similarity;
+				if (metric == SIMILARITY_COSINE) {
+					similarity = acc/(norm[i]*norm[r]);
+				} else {
+					similarity = acc/(norm[i] + norm[r] - acc);
+				}
+				if (similarity < threshold) {
+					continue;
+				}
+				ts->row[nrow].i = i;
+				ts->row[nrow].j = r;
+				ts->row[nrow].value = similarity;
+				nrow++;
+			}
+			radixSortElem(ts->row, ts->row+cap, nrow, i, m);
+			nrow = pruneRow(ts->row, nrow, k, 0, 0, ts->work);
+
+			rowout[i-i0] = malloc((nrow > 0 ? nrow : 1)*sizeof(elem_t));
+			if (rowout[i-i0] == NULL) {
+				rowlen[i-i0] = -1;
+				continue;
+			}
+			memcpy(rowout[i-i0], ts->row, nrow*sizeof(elem_t));
+			rowlen[i-i0] = nrow;
+		}
+
+		for (int i = i0; i < i1; i++) {
+			if (rowlen[i-i0] < 0 || nout_new + rowlen[i-i0] > size) {
+				ok = 0;
+			}
+			if (ok && rowlen[i-i0] > 0) {
+				memcpy(out+nout_new+1, rowout[i-i0], rowlen[i-i0]*sizeof(elem_t));
+				nout_new += rowlen[i-i0];
+			}
+			free(rowout[i-i0]);
+			rowout[i-i0] = NULL;
+		}
+	}
+
+	for (int t = 0; scratch != NULL && t < threads; t++) {
+		free(scratch[t].keys);
+		free(scratch[t].vals);
+		free(scratch[t].used);
+		free(scratch[t].row);
+		free(scratch[t].work);
+	}
+	free(scratch);
+	free(norm);
+	free(candidates);
+	free(rowout);
+	free(rowlen);
+	free(ptr);
+	free(perm);
+	free(colptr);
+	free(colperm);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = m;
+	out->j = m;
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Next number of a splitmix64 random generator
+ *
+ * @param state Pointer to the state of the generator
+ *
+ * @return a random number uniformly distributed in [0,1)
+ */
+static double randomUniform(uint64_t* state) {
+
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z = z ^ (z >> 31);
+
+	return (z >> 11) * (1.0/9007199254740992.0);
+}
+
+/**
+ * @brief Generates the sparse matrix of a random R-MAT graph with 2^scale vertices, without duplicated edges
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * (at least edgefactor*2^scale, at most INT_MAX)
+ * @param scale Logarithm in base 2 of the number of vertices
+ * @param edgefactor Number of edges generated per vertex (before removing duplicates)
+ * @param a Probability of the top left quadrant
+ * @param b Probability of the top right quadrant
+ * @param c Probability of the bottom left quadrant (the bottom right one has 1-a-b-c)
+ * @param seed Seed of the random generator
+ *
+ * @return 0 if errors occurred
+ */
+int rmatSparse(elem_t* out, const int scale, const int edgefactor, const double a, const double b, const double c, const unsigned long seed) {
+
+	//check
+	if (out == NULL || scale < 0 || scale > 30 || edgefactor < 0) {
+		return 0;
+	}
+
+	//the number of elements of a sparse matrix is an int
+	int n = 1 << scale;
+	long edges = (long) edgefactor*n;
+	if (edges > INT_MAX || edges > (long) out->value) {
+		return 0;
+	}
+
+	uint64_t state = seed;
+	for (long e = 0; e < edges; e++) {
+		int i = 0;
+		int j = 0;
+
+		//choosing a quadrant at each level
+		for (int level = scale-1; level >= 0; level--) {
+			double r = randomUniform(&state);
+			if (r >= a + b + c) {
+				i |= 1 << level;
+				j |= 1 << level;
+			} else if (r >= a + b) {
+				i |= 1 << level;
+			} else if (r >= a) {
+				j |= 1 << level;
+			}
+		}
+
+		(out+e+1)->i = i;
+		(out+e+1)->j = j;
+		(out+e+1)->value = 1;
+	}
+
+	out->i = n;
+	out->j = n;
+	out->value = edges;
+
+	//removing duplicated edges
+	if (!sortSparse(out)) {
+		return 0;
+	}
+	int nout_new = 0;
+	for (long e = 0; e < edges; e++) {
+		if (nout_new > 0 && (out+nout_new)->i == (out+e+1)->i && (out+nout_new)->j == (out+e+1)->j) {
+			continue;
+		}
+		*(out+nout_new+1) = *(out+e+1);
+		nout_new++;
+	}
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Builds the adjacency lists of the undirected graph of the sparse matrix, each edge oriented from the vertex
+ * of lower degree to the one of higher degree (ties broken by index)
+ *
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param ptr Where to store the allocated array of in->i+1 offsets into adj
+ * @param adj Where to store the allocated array of the heads of the oriented edges
+ *
+ * @return 0 if errors occurred
+ */
+static int orientSparse(const elem_t* in, int** ptr, int** adj) {
+
+	int m = in->i;
+	int nnz = (int) in->value;
+
+	if (in->i != in->j) {
+		return 0;
+	}
+
+	//both directions of each edge, without loops and duplicates
+	elem_t* sym = malloc((2*nnz+1)*sizeof(elem_t));
+	elem_t* tmp = malloc((2*nnz > 0 ? 2*nnz : 1)*sizeof(elem_t));
+	int* degree = calloc(m > 0 ? m : 1, sizeof(int));
+	*ptr = calloc(m+1, sizeof(int));
+	*adj = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+	if (sym == NULL || tmp == NULL || degree == NULL || *ptr == NULL || *adj == NULL) {
+		free(sym);
+		free(tmp);
+		free(degree);
+		free(*ptr);
+		free(*adj);
+		return 0;
+	}
+
+	int len = 0;
+	for (int k = 0; k < nnz; k++) {
+		elem_t curr = *(in+k+1);
+		if (curr.i == curr.j) {
+			continue;
+		}
+		sym[len+1] = curr;
+		sym[len+2].i = curr.j;
+		sym[len+2].j = curr.i;
+		len += 2;
+	}
+	radixSortElem(sym+1, tmp, len, 0, m);
+
+	int nsym = 0;
+	for (int k = 0; k < len; k++) {
+		if (nsym > 0 && sym[nsym].i == sym[k+1].i && sym[nsym].j == sym[k+1].j) {
+			continue;
+		}
+		sym[nsym+1] = sym[k+1];
+		nsym++;
+		degree[sym[nsym].i]++;
+	}
+
+	//keeping the direction towards the higher degree
+	for (int k = 0; k < nsym; k++) {
+		int u = sym[k+1].i;
+		int v = sym[k+1].j;
+		if (degree[u] < degree[v] || (degree[u] == degree[v] && u < v)) {
+			(*ptr)[u+1]++;
+		}
+	}
+
+	//sym is sorted, so the lists of each vertex are contiguous
+	int pos = 0;
+	for (int k = 0; k < nsym; k++) {
+		int u = sym[k+1].i;
+		int v = sym[k+1].j;
+		if (degree[u] < degree[v] || (degree[u] == degree[v] && u < v)) {
+			(*adj)[pos] = v;
+			pos++;
+		}
+	}
+	for (int r = 0; r < m; r++) {
+		(*ptr)[r+1] += (*ptr)[r];
+	}
+
+	free(sym);
+	free(tmp);
+	free(degree);
+
+	return 1;
+}
+
+/**
+ * @brief Counts the triangles of the undirected graph whose adjacency pattern is the sparse matrix pointed by in
+ *
+ * Edges are oriented from the vertex of lower degree to the one of higher degree and the triangles are found as
+ * the nonzeros of (L*L) masked by L, in parallel over the vertices, intersecting adjacency lists with a marker
+ * array per thread.
+ *
+ * @param total Where to store the number of triangles
+ * @param perVertex Pointer to an array of in->i elements where the number of triangles of each vertex is stored (can be NULL)
+ * @param in Pointer to the first element of the sparse matrix of the graph (direction, values and diagonal are ignored)
+ *
+ * @return 0 if errors occurred
+ */
+int triangleSparse(long* total, long* perVertex, const elem_t* in) {
+
+	//check
+	if (total == NULL || in == NULL) {
+		return 0;
+	}
+
+	int m = in->i;
+
+	int* ptr;
+	int* adj;
+	if (!orientSparse(in, &ptr, &adj)) {
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	int* mark = malloc((long) threads*(m > 0 ? m : 1)*sizeof(int));
+	if (mark == NULL) {
+		free(ptr);
+		free(adj);
+		return 0;
+	}
+
+	for (long r = 0; r < (long) threads*m; r++) {
+		mark[r] = -1;
+	}
+	for (int r = 0; perVertex != NULL && r < m; r++) {
+		perVertex[r] = 0;
+	}
+
+	long count = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 64) reduction(+:count)
+#endif
+	for (int u = 0; u < m; u++) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		int* tmark = mark + (long) t*m;
+
+		//marking the out-neighbours of u
+		for (int p = ptr[u]; p < ptr[u+1]; p++) {
+			tmark[adj[p]] = u;
+		}
+
+		//each w reached through v and also adjacent to u closes a triangle
+		long local = 0;
+		for (int p = ptr[u]; p < ptr[u+1]; p++) {
+			int v = adj[p];
+			long closed = 0;
+			for (int q = ptr[v]; q < ptr[v+1]; q++) {
+				int w = adj[q];
+				if (tmark[w] == u) {
+					closed++;
+					if (perVertex != NULL) {
+#ifdef _OPENMP
+						#pragma omp atomic
+#endif
+						perVertex[w]++;
+					}
+				}
+			}
+			if (perVertex != NULL && closed > 0) {
+#ifdef _OPENMP
+				#pragma omp atomic
+#endif
+				perVertex[v] += closed;
+			}
+			local += closed;
+		}
+		if (perVertex != NULL) {
+#ifdef _OPENMP
+			#pragma omp atomic
+#endif
+			perVertex[u] += local;
+		}
+		count += local;
+	}
+	*total = count;
+
+	free(mark);
+	free(ptr);
+	free(adj);
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the k-truss of the undirected graph whose adjacency pattern is
+ * the sparse matrix pointed by in, that is the largest subgraph where each edge is in at least k-2 triangles
+ *
+ * The triangles of each edge are counted once, in parallel over the vertices as in triangleSparse. Edges are then
+ * peeled from a queue: removing an edge decrements the support of the two other edges of each of its remaining
+ * triangles, and an edge is queued when its support falls below k-2.
+ *
+ * @param out Pointer to the first element of the result sparse matrix (both directions of each edge, valued with
+ * the number of triangles of the edge), out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the sparse matrix of the graph (direction, values and diagonal are ignored)
+ * @param k Order of the truss
+ *
+ * @return 0 if errors occurred
+ */
+int trussSparse(elem_t* out, const elem_t* in, const int k) {
+
+	//check
+	if (out == NULL || in == NULL) {
+		return 0;
+	}
+
+	int size = (int) out->value;
+	int m = in->i;
+
+	int* ptr;
+	int* adj;
+	if (!orientSparse(in, &ptr, &adj)) {
+		return 0;
+	}
+	int nedges = ptr[m];
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	//edges are identified by their position in adj and go from from[e] to adj[e], nbr lists both directions of
+	//each edge with its identifier
+	int* support = calloc(nedges > 0 ? nedges : 1, sizeof(int));
+	char* alive = malloc(nedges > 0 ? nedges : 1);
+	char* queued = calloc(nedges > 0 ? nedges : 1, 1);
+	int* queue = malloc((nedges > 0 ? nedges : 1)*sizeof(int));
+	int* from = malloc((nedges > 0 ? nedges : 1)*sizeof(int));
+	int* nbrPtr = calloc(m+1, sizeof(int));
+	int* nbr = malloc((nedges > 0 ? 2*nedges : 1)*sizeof(int));
+	int* nbrEdge = malloc((nedges > 0 ? 2*nedges : 1)*sizeof(int));
+	int* mark = malloc((long) threads*(m > 0 ? m : 1)*sizeof(int));
+	int* markEdge = malloc((long) threads*(m > 0 ? m : 1)*sizeof(int));
+	int ok = (support != NULL && alive != NULL && queued != NULL && queue != NULL && from != NULL && nbrPtr != NULL && nbr != NULL
+			&& nbrEdge != NULL && mark != NULL && markEdge != NULL);
+
+	for (int e = 0; ok && e < nedges; e++) {
+		alive[e] = 1;
+	}
+	for (long r = 0; ok && r < (long) threads*m; r++) {
+		mark[r] = -1;
+	}
+
+	//triangles of each edge, the edges of a triangle can belong to different vertices
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int u = 0; u < m; u++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			int* tmark = mark + (long) t*m;
+			int* tmarkEdge = markEdge + (long) t*m;
+
+			for (int p = ptr[u]; p < ptr[u+1]; p++) {
+				tmark[adj[p]] = u;
+				tmarkEdge[adj[p]] = p;
+			}
+			for (int p = ptr[u]; p < ptr[u+1]; p++) {
+				int v = adj[p];
+				for (int q = ptr[v]; q < ptr[v+1]; q++) {
+					if (tmark[adj[q]] == u) {
+#ifdef _OPENMP
+						#pragma omp atomic
+#endif
+						support[p]++;
+#ifdef _OPENMP
+						#pragma omp atomic
+#endif
+						support[q]++;
+#ifdef _OPENMP
+						#pragma omp atomic
+#endif
+						support[tmarkEdge[adj[q]]]++;
+					}
+				}
+			}
+		}
+	}
+
+	//undirected adjacency lists with the identifiers of the edges
+	for (int u = 0; ok && u < m; u++) {
+		for (int p = ptr[u]; p < ptr[u+1]; p++) {
+			nbrPtr[u+1]++;
+			nbrPtr[adj[p]+1]++;
+		}
+	}
+	for (int r = 0; ok && r < m; r++) {
+		nbrPtr[r+1] += nbrPtr[r];
+	}
+	for (int u = 0; ok && u < m; u++) {
+		for (int p = ptr[u]; p < ptr[u+1]; p++) {
+			int v = adj[p];
+			from[p] = u;
+			nbr[nbrPtr[u]] = v;
+			nbrEdge[nbrPtr[u]] = p;
+			nbrPtr[u]++;
+			nbr[nbrPtr[v]] = u;
+			nbrEdge[nbrPtr[v]] = p;
+			nbrPtr[v]++;
+		}
+	}
+	for (int r = m; ok && r > 0; r--) {
+		nbrPtr[r] = nbrPtr[r-1];
+	}
+	if (ok) {
+		nbrPtr[0] = 0;
+	}
+
+	//peeling edges with too few triangles, updating the support of the edges of their triangles
+	for (int r = 0; ok && r < m; r++) {
+		mark[r] = -1;
+	}
+	int head = 0;
+	int tail = 0;
+	for (int e = 0; ok && e < nedges; e++) {
+		if (support[e] < k-2) {
+			queue[tail] = e;
+			queued[e] = 1;
+			tail++;
+		}
+	}
+	while (ok && head < tail) {
+		int e = queue[head];
+		head++;
+		alive[e] = 0;
+
+		//the third vertices of the remaining triangles of e are the common neighbours of its endpoints
+		int u = from[e];
+		int v = adj[e];
+		for (int p = nbrPtr[u]; p < nbrPtr[u+1]; p++) {
+			if (alive[nbrEdge[p]]) {
+				mark[nbr[p]] = e;
+				markEdge[nbr[p]] = nbrEdge[p];
+			}
+		}
+		for (int p = nbrPtr[v]; p < nbrPtr[v+1]; p++) {
+			int w = nbr[p];
+			if (!alive[nbrEdge[p]] || mark[w] != e) {
+				continue;
+			}
+			int sides[2] = {markEdge[w], nbrEdge[p]};
+			for (int s = 0; s < 2; s++) {
+				support[sides[s]]--;
+				if (!queued[sides[s]] && support[sides[s]] < k-2) {
+					queue[tail] = sides[s];
+					queued[sides[s]] = 1;
+					tail++;
+				}
+			}
+		}
+	}
+
+	int nout_new = 0;
+	for (int u = 0; ok && u < m; u++) {
+		for (int p = ptr[u]; p < ptr[u+1]; p++) {
+			if (!alive[p]) {
+				continue;
+			}
+			if (nout_new + 2 > size) {
+				ok = 0;
+				break;
+			}
+			(out+nout_new+1)->i = u;
+			(out+nout_new+1)->j = adj[p];
+			(out+nout_new+1)->value = support[p];
+			(out+nout_new+2)->i = adj[p];
+			(out+nout_new+2)->j = u;
+			(out+nout_new+2)->value = support[p];
+			nout_new += 2;
+		}
+	}
+
+	free(support);
+	free(alive);
+	free(queued);
+	free(queue);
+	free(from);
+	free(nbrPtr);
+	free(nbr);
+	free(nbrEdge);
+	free(mark);
+	free(markEdge);
+	free(ptr);
+	free(adj);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = m;
+	out->j = m;
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Single source shortest paths with Bellman-Ford, as repeated (min,+) products of the frontier of updated
+ * vertices by the sparse matrix pointed by in, where element (i,j) is the weight of the edge from i to j
+ *
+ * @param dist Pointer to an array of in->i elements where the distances are stored (INFINITY if not reachable)
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param source Index of the source vertex
+ *
+ * @return 0 if errors occurred (also if a negative cycle is reachable)
+ */
+int bellmanFordSparse(double* dist, const elem_t* in, const int source) {
+
+	//check
+	if (dist == NULL || in == NULL || in->i != in->j || source < 0 || source >= in->i) {
+		return 0;
+	}
+
+	int m = in->i;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	//sparse frontier, with a flag to avoid duplicates in the next one
+	int* frontier = malloc(m*sizeof(int));
+	int* next = malloc(m*sizeof(int));
+	char* queued = calloc(m, 1);
+	if (frontier == NULL || next == NULL || queued == NULL) {
+		free(frontier);
+		free(next);
+		free(queued);
+		free(ptr);
+		free(perm);
+		return 0;
+	}
+
+	for (int r = 0; r < m; r++) {
+		dist[r] = INFINITY;
+	}
+	dist[source] = 0;
+	frontier[0] = source;
+	int nfrontier = 1;
+
+	int rounds = 0;
+	while (nfrontier > 0 && rounds < m) {
+
+		int nnext = 0;
+		for (int f = 0; f < nfrontier; f++) {
+			int u = frontier[f];
+			for (int p = ptr[u]; p < ptr[u+1]; p++) {
+				elem_t curr = *(in+perm[p]+1);
+				if (dist[u] + curr.value < dist[curr.j]) {
+					dist[curr.j] = dist[u] + curr.value;
+					if (!queued[curr.j]) {
+						queued[curr.j] = 1;
+						next[nnext] = curr.j;
+						nnext++;
+					}
+				}
+			}
+		}
+
+		for (int f = 0; f < nnext; f++) {
+			queued[next[f]] = 0;
+		}
+
+		int* swap = frontier;
+		frontier = next;
+		next = swap;
+		nfrontier = nnext;
+		rounds++;
+	}
+
+	free(frontier);
+	free(next);
+	free(queued);
+	free(ptr);
+	free(perm);
+
+	//after m rounds distances can still decrease only with a negative cycle
+	if (nfrontier > 0) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/* List of vertices of a bucket of deltaSteppingSparse */
+struct bucket {
+	int* items;
+	int len;
+	int cap;
+};
+
+/**
+ * @brief Appends a vertex to a bucket
+ *
+ * @param bucket Pointer to the bucket
+ * @param v Vertex to append
+ *
+ * @return 0 if errors occurred
+ */
+static int pushBucket(struct bucket* bucket, const int v) {
+
+	if (bucket->len == bucket->cap) {
+		int* items = realloc(bucket->items, (2*bucket->cap+4)*sizeof(int));
+		if (items == NULL) {
+			return 0;
+		}
+		bucket->items = items;
+		bucket->cap = 2*bucket->cap+4;
+	}
+	bucket->items[bucket->len] = v;
+	bucket->len++;
+
+	return 1;
+}
+
+/* Tentative distances collected by a thread of deltaSteppingSparse */
+struct requests {
+	int* vertex;
+	double* dist;
+	int len;
+	int cap;
+	int failed;
+};
+
+/**
+ * @brief Relaxes in parallel the light or heavy edges of a list of vertices, then applies the smallest tentative
+ * distance of each reached vertex and moves it to its bucket
+ *
+ * @param dist Pointer to the array of the distances
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param ptr Row offsets of in from indexSparse
+ * @param perm Row permutation of in from indexSparse
+ * @param vertices Pointer to the array of the vertices whose edges are relaxed
+ * @param count Number of vertices
+ * @param delta Width of the buckets
+ * @param heavy 1 to relax the edges heavier than delta, 0 for the others
+ * @param reqs Pointer to an array of one request buffer per thread
+ * @param buckets Pointer to the circular array of the buckets
+ * @param nbuckets Number of buckets
+ * @param pending Pointer to the number of vertices in the buckets
+ *
+ * @return 0 if errors occurred
+ */
+static int relaxBucket(double* dist, const elem_t* in, const int* ptr, const int* perm, const int* vertices,
+		const int count, const double delta, const int heavy, struct requests* reqs, struct bucket* buckets,
+		const int nbuckets, long* pending) {
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	for (int t = 0; t < threads; t++) {
+		reqs[t].len = 0;
+	}
+
+	//distances are only read here, so the threads don't interfere
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int s = 0; s < count; s++) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		struct requests* treqs = reqs+t;
+		int u = vertices[s];
+		for (int p = ptr[u]; !treqs->failed && p < ptr[u+1]; p++) {
+			elem_t edge = *(in+perm[p]+1);
+			if ((edge.value > delta) != heavy || !(dist[u] + edge.value < dist[edge.j])) {
+				continue;
+			}
+			if (treqs->len == treqs->cap) {
+				int* vertex = realloc(treqs->vertex, (2L*treqs->cap+64)*sizeof(int));
+				if (vertex != NULL) {
+					treqs->vertex = vertex;
+				}
+				double* tdist = realloc(treqs->dist, (2L*treqs->cap+64)*sizeof(double));
+				if (tdist != NULL) {
+					treqs->dist = tdist;
+				}
+				if (vertex == NULL || tdist == NULL || treqs->cap > (INT_MAX-64)/2) {
+					treqs->failed = 1;
+					break;
+				}
+				treqs->cap = 2*treqs->cap+64;
+			}
+			treqs->vertex[treqs->len] = edge.j;
+			treqs->dist[treqs->len] = dist[u] + edge.value;
+			treqs->len++;
+		}
+	}
+
+	for (int t = 0; t < threads; t++) {
+		if (reqs[t].failed) {
+			return 0;
+		}
+	}
+
+	//min-reduction of the tentative distances
+	for (int t = 0; t < threads; t++) {
+		for (int r = 0; r < reqs[t].len; r++) {
+			int v = reqs[t].vertex[r];
+			if (reqs[t].dist[r] < dist[v]) {
+				dist[v] = reqs[t].dist[r];
+				if (!pushBucket(buckets + (long) (dist[v]/delta)%nbuckets, v)) {
+					return 0;
+				}
+				(*pending)++;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Single source shortest paths with delta-stepping on the sparse matrix pointed by in, where element (i,j)
+ * is the non-negative weight of the edge from i to j
+ *
+ * Buckets are kept in a circular array of ceil(maxWeight/delta)+1 buckets, the tentative distances never span more.
+ * The edges of the vertices of a bucket are relaxed in parallel, each thread collecting the tentative distances in
+ * its own buffer, and the smallest distance of each vertex is then applied moving it to its bucket.
+ *
+ * @param dist Pointer to an array of in->i elements where the distances are stored (INFINITY if not reachable)
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param source Index of the source vertex
+ * @param delta Width of the buckets, edges not heavier than delta are relaxed inside the bucket
+ *
+ * @return 0 if errors occurred (also if a weight is negative or maxWeight/delta needs more than DELTA_MAX_BUCKETS buckets)
+ */
+int deltaSteppingSparse(double* dist, const elem_t* in, const int source, const double delta) {
+
+	//check
+	if (dist == NULL || in == NULL || in->i != in->j || source < 0 || source >= in->i || !(delta > 0)) {
+		return 0;
+	}
+
+	int m = in->i;
+	int nnz = (int) in->value;
+
+	double maxWeight = 0;
+	for (int k = 0; k < nnz; k++) {
+		if ((in+k+1)->value < 0) {
+			return 0;
+		}
+		if ((in+k+1)->value > maxWeight) {
+			maxWeight = (in+k+1)->value;
+		}
+	}
+	if (ceil(maxWeight/delta)+1 > DELTA_MAX_BUCKETS) {
+		return 0;
+	}
+	int nbuckets = (int) ceil(maxWeight/delta)+1;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	//a vertex whose distance moved to another bucket is skipped when found in the old one
+	struct bucket* buckets = calloc(nbuckets, sizeof(struct bucket));
+	struct requests* reqs = calloc(threads, sizeof(struct requests));
+	int* frontier = malloc((m > 0 ? m : 1)*sizeof(int));
+	char* inFrontier = calloc(m > 0 ? m : 1, 1);
+	int* settled = malloc((m > 0 ? m : 1)*sizeof(int));
+	char* isSettled = calloc(m > 0 ? m : 1, 1);
+	int ok = (buckets != NULL && reqs != NULL && frontier != NULL && inFrontier != NULL && settled != NULL
+			&& isSettled != NULL);
+
+	for (int r = 0; r < m; r++) {
+		dist[r] = INFINITY;
+	}
+	dist[source] = 0;
+	ok = ok && pushBucket(buckets, source);
+	long pending = 1;
+
+	for (long b = 0; ok && pending > 0; b++) {
+		struct bucket* curr = buckets + b%nbuckets;
+
+		//light edges can put vertices back in the current bucket
+		int nsettled = 0;
+		while (ok && curr->len > 0) {
+			int nfrontier = 0;
+			for (int q = 0; q < curr->len; q++) {
+				int u = curr->items[q];
+				if ((long) (dist[u]/delta) != b || inFrontier[u]) {
+					continue;
+				}
+				inFrontier[u] = 1;
+				frontier[nfrontier] = u;
+				nfrontier++;
+				if (!isSettled[u]) {
+					isSettled[u] = 1;
+					settled[nsettled] = u;
+					nsettled++;
+				}
+			}
+			pending -= curr->len;
+			curr->len = 0;
+			for (int f = 0; f < nfrontier; f++) {
+				inFrontier[frontier[f]] = 0;
+			}
+
+			ok = relaxBucket(dist, in, ptr, perm, frontier, nfrontier, delta, 0, reqs, buckets, nbuckets, &pending);
+		}
+
+		//heavy edges only reach following buckets
+		ok = ok && relaxBucket(dist, in, ptr, perm, settled, nsettled, delta, 1, reqs, buckets, nbuckets, &pending);
+	}
+
+	for (int b = 0; buckets != NULL && b < nbuckets; b++) {
+		free(buckets[b].items);
+	}
+	for (int t = 0; reqs != NULL && t < threads; t++) {
+		free(reqs[t].vertex);
+		free(reqs[t].dist);
+	}
+	free(buckets);
+	free(reqs);
+	free(frontier);
+	free(inFrontier);
+	free(settled);
+	free(isSettled);
+	free(ptr);
+	free(perm);
+
+	return ok;
+}
+
+/**
+ * @brief Multiplies the sparse matrix pointed by in by a vector and stores the result in the vector pointed by out
+ *
+ * @param out Pointer to an array of in->i elements where the result is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param v Pointer to an array of in->j elements
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_Vector(double* out, const elem_t* in, const double* v) {
+
+	//check
+	if (out == NULL || in == NULL || v == NULL) {
+		return 0;
+	}
+
+	for (int r = 0; r < in->i; r++) {
+		out[r] = 0;
+	}
+
+	for (int k = 0; k < (int) in->value; k++) {
+		elem_t curr = *(in+k+1);
+		out[curr.i] += curr.value*v[curr.j];
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Computes the action of the exponential of t times the sparse matrix pointed by in on a vector, exp(t*A)*v,
+ * with a truncated Taylor series and scaling, using only products of the matrix by vectors
+ *
+ * @param out Pointer to an array of in->i elements where the result is stored
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param t Time (multiplier of the matrix)
+ * @param v Pointer to an array of in->j elements
+ *
+ * @return 0 if errors occurred (also if the 1-norm of t*A is above INT_MAX, the number of steps)
+ */
+int expmvSparse(double* out, const elem_t* in, const double t, const double* v) {
+
+	//check
+	if (out == NULL || in == NULL || v == NULL || in->i != in->j) {
+		return 0;
+	}
+
+	int n = in->i;
+
+	double* term = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* next = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* colsum = calloc(n > 0 ? n : 1, sizeof(double));
+	if (term == NULL || next == NULL || colsum == NULL) {
+		free(term);
+		free(next);
+		free(colsum);
+		return 0;
+	}
+
+	//1-norm of t*A, the steps are chosen so that each one has norm at most 1
+	for (int k = 0; k < (int) in->value; k++) {
+		colsum[(in+k+1)->j] += fabs((in+k+1)->value);
+	}
+	double norm = 0;
+	for (int c = 0; c < n; c++) {
+		if (colsum[c] > norm) {
+			norm = colsum[c];
+		}
+	}
+	norm *= fabs(t);
+
+	//the number of steps must fit an int (this also rejects infinite or NaN norms)
+	if (!(ceil(norm) <= INT_MAX)) {
+		free(term);
+		free(next);
+		free(colsum);
+		return 0;
+	}
+	int steps = norm > 1 ? (int) ceil(norm) : 1;
+	double h = t/steps;
+
+	for (int r = 0; r < n; r++) {
+		out[r] = v[r];
+	}
+
+	for (int s = 0; s < steps; s++) {
+
+		//out = sum of (h*A)^k/k! out, until two consecutive terms are negligible
+		for (int r = 0; r < n; r++) {
+			term[r] = out[r];
+		}
+		double previous = INFINITY;
+		for (int k = 1; k <= 60; k++) {
+			multiplySparse_Vector(next, in, term);
+
+			double termnorm = 0;
+			double outnorm = 0;
+			for (int r = 0; r < n; r++) {
+				term[r] = next[r]*h/k;
+				out[r] += term[r];
+				termnorm = fmax(termnorm, fabs(term[r]));
+				outnorm = fmax(outnorm, fabs(out[r]));
+			}
+
+			if (previous + termnorm <= 1e-16*outnorm) {
+				break;
+			}
+			previous = termnorm;
+		}
+	}
+
+	free(term);
+	free(next);
+	free(colsum);
+
+	return 1;
+}
+
+/**
+ * @brief LU factorization with partial pivoting of a dense matrix, in place
+ *
+ * @param a Pointer to the n*n elements of the matrix, by rows
+ * @param piv Pointer to an array of n elements where the pivot rows are stored
+ * @param n Order of the matrix
+ *
+ * @return 0 if the matrix is singular
+ */
+static int luDense(double* a, int* piv, const int n) {
+
+	for (int c = 0; c < n; c++) {
+
+		//choosing the pivot
+		int p = c;
+		for (int r = c+1; r < n; r++) {
+			if (fabs(a[r*n+c]) > fabs(a[p*n+c])) {
+				p = r;
+			}
+		}
+		piv[c] = p;
+		if (a[p*n+c] == 0) {
+			return 0;
+		}
+		if (p != c) {
+			for (int k = 0; k < n; k++) {
+				double tmp = a[c*n+k];
+				a[c*n+k] = a[p*n+k];
+				a[p*n+k] = tmp;
+			}
+		}
+
+		//elimination
+		for (int r = c+1; r < n; r++) {
+			double f = a[r*n+c] /= a[c*n+c];
+			for (int k = c+1; k < n; k++) {
+				a[r*n+k] -= f*a[c*n+k];
+			}
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Solves a dense linear system factorized by luDense, in place
+ *
+ * @param a Pointer to the factorized matrix
+ * @param piv Pointer to the pivot rows
+ * @param n Order of the matrix
+ * @param b Pointer to the n elements of the right hand side, replaced by the solution
+ */
+static void luSolveDense(const double* a, const int* piv, const int n, double* b) {
+
+	//luDense swaps whole rows, so all the swaps come before the forward substitution
+	for (int c = 0; c < n; c++) {
+		double tmp = b[c];
+		b[c] = b[piv[c]];
+		b[piv[c]] = tmp;
+	}
+	for (int c = 0; c < n; c++) {
+		for (int r = c+1; r < n; r++) {
+			b[r] -= a[r*n+c]*b[c];
+		}
+	}
+
+	for (int r = n-1; r >= 0; r--) {
+		for (int k = r+1; k < n; k++) {
+			b[r] -= a[r*n+k]*b[k];
+		}
+		b[r] /= a[r*n+r];
+	}
+}
+
+/**
+ * @brief Solves a dense least squares problem min ||a*x-b|| with Householder QR, in place
+ *
+ * @param a Pointer to the rows*cols elements of the matrix, by rows (rows >= cols), overwritten
+ * @param rows Number of rows of the matrix
+ * @param cols Number of columns of the matrix
+ * @param b Pointer to the rows elements of the right hand side, the first cols are replaced by the solution
+ *
+ * @return 0 if the matrix is rank deficient
+ */
+static int lsqDense(double* a, const int rows, const int cols, double* b) {
+
+	for (int c = 0; c < cols; c++) {
+
+		//householder vector of column c, stored in place
+		double norm = 0;
+		for (int r = c; r < rows; r++) {
+			norm += a[r*cols+c]*a[r*cols+c];
+		}
+		norm = sqrt(norm);
+		if (norm == 0) {
+			return 0;
+		}
+		double alpha = a[c*cols+c] > 0 ? -norm : norm;
+		a[c*cols+c] -= alpha;
+		double vnorm = 0;
+		for (int r = c; r < rows; r++) {
+			vnorm += a[r*cols+c]*a[r*cols+c];
+		}
+
+		//applying the reflection to the following columns and to b
+		for (int k = c+1; k <= cols; k++) {
+			double dot = 0;
+			for (int r = c; r < rows; r++) {
+				dot += a[r*cols+c]*(k < cols ? a[r*cols+k] : b[r]);
+			}
+			double f = 2*dot/vnorm;
+			for (int r = c; r < rows; r++) {
+				if (k < cols) {
+					a[r*cols+k] -= f*a[r*cols+c];
+				} else {
+					b[r] -= f*a[r*cols+c];
+				}
+			}
+		}
+		a[c*cols+c] = alpha;
+	}
+
+	//back substitution with R
+	for (int r = cols-1; r >= 0; r--) {
+		for (int k = r+1; k < cols; k++) {
+			b[r] -= a[r*cols+k]*b[k];
+		}
+		b[r] /= a[r*cols+r];
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Pattern of a row of A^level, always including the diagonal
+ *
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param ptr Row offsets built by indexSparse
+ * @param perm Row positions built by indexSparse
+ * @param row Index of the row
+ * @param level Power of the matrix
+ * @param mark Pointer to an array of in->i elements, set to row for the columns of the pattern
+ * @param pattern Pointer to an array of in->i elements where the columns of the pattern are stored
+ *
+ * @return the number of columns of the pattern
+ */
+static int patternPower(const elem_t* in, const int* ptr, const int* perm, const int row, const int level, int* mark, int* pattern) {
+
+	mark[row] = row;
+	pattern[0] = row;
+	int len = 1;
+
+	//each level adds the columns of the rows reached so far
+	int from = 0;
+	for (int l = 0; l < level; l++) {
+		int to = len;
+		for (int p = from; p < to; p++) {
+			int r = pattern[p];
+			for (int q = ptr[r]; q < ptr[r+1]; q++) {
+				int c = (in+perm[q]+1)->j;
+				if (mark[c] != row) {
+					mark[c] = row;
+					pattern[len] = c;
+					len++;
+				}
+			}
+		}
+		from = to;
+	}
+
+	return len;
+}
+
+/**
+ * @brief Sparse approximate inverse with static pattern: stores in the sparse matrix pointed by out the matrix M
+ * minimizing the Frobenius norm of M*A-I, where each row of M can have nonzeros only in the pattern of the same row of A^level
+ *
+ * Each row is a small dense least squares problem, the rows are solved in parallel when built with OpenMP. Elements
+ * below threshold in absolute value are then dropped (except the diagonal). Applying M is a product of the matrix
+ * by a vector.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param level Power of the matrix giving the pattern (at least 1)
+ * @param threshold Elements below this value are dropped
+ *
+ * @return 0 if errors occurred
+ */
+int spaiSparse(elem_t* out, const elem_t* in, const int level, const double threshold) {
+
+	//check
+	if (out == NULL || in == NULL || in->i != in->j || level < 1) {
+		return 0;
+	}
+
+	long size = (long) out->value;
+	int n = in->i;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	//J are the columns of the row of M, I the columns of A reached by the rows J, one set per thread
+	int* markJ = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* markI = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* J = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* I = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* posI = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	double** dense = calloc(threads, sizeof(double*));
+	double** rhs = calloc(threads, sizeof(double*));
+	int* failed = calloc(threads, sizeof(int));
+	int ok = (markJ != NULL && markI != NULL && J != NULL && I != NULL && posI != NULL && dense != NULL && rhs != NULL
+			&& failed != NULL);
+
+	for (long r = 0; ok && r < (long) threads*n; r++) {
+		markJ[r] = -1;
+		markI[r] = -1;
+	}
+
+	//rows are solved in parallel and appended in any order, out is sorted at the end
+	long nout_new = 0;
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for (int i = 0; i < n; i++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			if (failed[t]) {
+				continue;
+			}
+			int* tmarkJ = markJ + (long) t*n;
+			int* tmarkI = markI + (long) t*n;
+			int* tJ = J + (long) t*n;
+			int* tI = I + (long) t*n;
+			int* tposI = posI + (long) t*n;
+
+			int nJ = patternPower(in, ptr, perm, i, level, tmarkJ, tJ);
+			int nI = 0;
+			for (int p = 0; p < nJ; p++) {
+				for (int q = ptr[tJ[p]]; q < ptr[tJ[p]+1]; q++) {
+					int c = (in+perm[q]+1)->j;
+					if (tmarkI[c] != i) {
+						tmarkI[c] = i;
+						tposI[c] = nI;
+						tI[nI] = c;
+						nI++;
+					}
+				}
+			}
+			if (tmarkI[i] != i) {
+				tmarkI[i] = i;
+				tposI[i] = nI;
+				tI[nI] = i;
+				nI++;
+			}
+			if (nI < nJ) {
+				failed[t] = 1;
+				continue;
+			}
+
+			//dense problem min ||A(J,I)' m - e_i||
+			double* grown = realloc(dense[t], (size_t) nI*nJ*sizeof(double));
+			double* grownRhs = realloc(rhs[t], nI*sizeof(double));
+			if (grown != NULL) {
+				dense[t] = grown;
+			}
+			if (grownRhs != NULL) {
+				rhs[t] = grownRhs;
+			}
+			if (grown == NULL || grownRhs == NULL) {
+				failed[t] = 1;
+				continue;
+			}
+			double* tdense = dense[t];
+			double* trhs = rhs[t];
+			for (long c = 0; c < (long) nI*nJ; c++) {
+				tdense[c] = 0;
+			}
+			for (int c = 0; c < nI; c++) {
+				trhs[c] = 0;
+			}
+			trhs[tposI[i]] = 1;
+			for (int p = 0; p < nJ; p++) {
+				for (int q = ptr[tJ[p]]; q < ptr[tJ[p]+1]; q++) {
+					elem_t curr = *(in+perm[q]+1);
+					tdense[(long) tposI[curr.j]*nJ+p] += curr.value;
+				}
+			}
+
+			if (!lsqDense(tdense, nI, nJ, trhs)) {
+				failed[t] = 1;
+				continue;
+			}
+
+			//reserving the positions of the row in out
+			int nrow = 0;
+			for (int p = 0; p < nJ; p++) {
+				nrow += (tJ[p] == i || fabs(trhs[p]) >= threshold);
+			}
+			long first;
+#ifdef _OPENMP
+			#pragma omp atomic capture
+#endif
+			{first = nout_new; nout_new += nrow;}
+			if (first + nrow > size) {
+				failed[t] = 1;
+				continue;
+			}
+			for (int p = 0; p < nJ; p++) {
+				if (tJ[p] != i && fabs(trhs[p]) < threshold) {
+					continue;
+				}
+				(out+first+1)->i = i;
+				(out+first+1)->j = tJ[p];
+				(out+first+1)->value = trhs[p];
+				first++;
+			}
+		}
+	}
+
+	for (int t = 0; ok && t < threads; t++) {
+		if (failed[t]) {
+			ok = 0;
+		}
+	}
+
+	for (int t = 0; dense != NULL && t < threads; t++) {
+		free(dense[t]);
+	}
+	for (int t = 0; rhs != NULL && t < threads; t++) {
+		free(rhs[t]);
+	}
+	free(markJ);
+	free(markI);
+	free(J);
+	free(I);
+	free(posI);
+	free(dense);
+	free(rhs);
+	free(failed);
+	free(ptr);
+	free(perm);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = n;
+	out->j = n;
+	out->value = nout_new;
+
+	return sortSparse(out);
+}
+
+/**
+ * @brief Factorized sparse approximate inverse of a symmetric positive definite matrix: stores in the sparse matrix
+ * pointed by out the lower triangular matrix G such that G*A*G' is close to the identity, so that G'*G approximates
+ * the inverse of A, where the row i of G has nonzeros only in the lower pattern of the same row of A^level
+ *
+ * Each row is a small dense linear system, the rows are solved in parallel when built with OpenMP.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param level Power of the matrix giving the pattern (at least 1)
+ * @param threshold Elements below this value are dropped (except the diagonal)
+ *
+ * @return 0 if errors occurred
+ */
+int fsaiSparse(elem_t* out, const elem_t* in, const int level, const double threshold) {
+
+	//check
+	if (out == NULL || in == NULL || in->i != in->j || level < 1) {
+		return 0;
+	}
+
+	long size = (long) out->value;
+	int n = in->i;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	int* mark = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* pattern = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* pos = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* piv = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	double** dense = calloc(threads, sizeof(double*));
+	double** rhs = calloc(threads, sizeof(double*));
+	int* failed = calloc(threads, sizeof(int));
+	int ok = (mark != NULL && pattern != NULL && pos != NULL && piv != NULL && dense != NULL && rhs != NULL
+			&& failed != NULL);
+
+	for (long r = 0; ok && r < (long) threads*n; r++) {
+		mark[r] = -1;
+		pos[r] = -1;
+	}
+
+	//rows are solved in parallel and appended in any order, out is sorted at the end
+	long nout_new = 0;
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 16)
+#endif
+		for (int i = 0; i < n; i++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			if (failed[t]) {
+				continue;
+			}
+			int* tmark = mark + (long) t*n;
+			int* tpattern = pattern + (long) t*n;
+			int* tpos = pos + (long) t*n;
+			int* tpiv = piv + (long) t*n;
+
+			//lower part of the pattern, the diagonal is the first column
+			int len = patternPower(in, ptr, perm, i, level, tmark, tpattern);
+			int nS = 0;
+			for (int p = 0; p < len; p++) {
+				if (tpattern[p] <= i) {
+					tpattern[nS] = tpattern[p];
+					tpos[tpattern[nS]] = nS;
+					nS++;
+				}
+			}
+
+			//dense problem A(S,S) y = e_i
+			double* grown = realloc(dense[t], (size_t) nS*nS*sizeof(double));
+			double* grownRhs = realloc(rhs[t], nS*sizeof(double));
+			if (grown != NULL) {
+				dense[t] = grown;
+			}
+			if (grownRhs != NULL) {
+				rhs[t] = grownRhs;
+			}
+			int solved = (grown != NULL && grownRhs != NULL);
+			double* tdense = dense[t];
+			double* trhs = rhs[t];
+			for (long c = 0; solved && c < (long) nS*nS; c++) {
+				tdense[c] = 0;
+			}
+			for (int c = 0; solved && c < nS; c++) {
+				trhs[c] = 0;
+			}
+			for (int p = 0; solved && p < nS; p++) {
+				for (int q = ptr[tpattern[p]]; q < ptr[tpattern[p]+1]; q++) {
+					elem_t curr = *(in+perm[q]+1);
+					if (tpos[curr.j] >= 0) {
+						tdense[(long) p*nS+tpos[curr.j]] += curr.value;
+					}
+				}
+			}
+			if (solved) {
+				trhs[0] = 1;
+				solved = luDense(tdense, tpiv, nS);
+			}
+			if (solved) {
+				luSolveDense(tdense, tpiv, nS, trhs);
+				solved = trhs[0] > 0;
+			}
+			if (!solved) {
+				for (int p = 0; p < nS; p++) {
+					tpos[tpattern[p]] = -1;
+				}
+				failed[t] = 1;
+				continue;
+			}
+
+			//scaling so that the diagonal of G*A*G' is 1, then reserving the positions of the row in out
+			double scale = 1/sqrt(trhs[0]);
+			int nrow = 0;
+			for (int p = 0; p < nS; p++) {
+				nrow += (p == 0 || fabs(trhs[p]*scale) >= threshold);
+			}
+			long first;
+#ifdef _OPENMP
+			#pragma omp atomic capture
+#endif
+			{first = nout_new; nout_new += nrow;}
+			for (int p = 0; p < nS; p++) {
+				tpos[tpattern[p]] = -1;
+			}
+			if (first + nrow > size) {
+				failed[t] = 1;
+				continue;
+			}
+			for (int p = 0; p < nS; p++) {
+				if (p > 0 && fabs(trhs[p]*scale) < threshold) {
+					continue;
+				}
+				(out+first+1)->i = i;
+				(out+first+1)->j = tpattern[p];
+				(out+first+1)->value = trhs[p]*scale;
+				first++;
+			}
+		}
+	}
+
+	for (int t = 0; ok && t < threads; t++) {
+		if (failed[t]) {
+			ok = 0;
+		}
+	}
+
+	for (int t = 0; dense != NULL && t < threads; t++) {
+		free(dense[t]);
+	}
+	for (int t = 0; rhs != NULL && t < threads; t++) {
+		free(rhs[t]);
+	}
+	free(mark);
+	free(pattern);
+	free(pos);
+	free(piv);
+	free(dense);
+	free(rhs);
+	free(failed);
+	free(ptr);
+	free(perm);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = n;
+	out->j = n;
+	out->value = nout_new;
+
+	return sortSparse(out);
+}
+
+/* Sparse LU factors of a block of blockSetupSparse, P*A = L*U with the rows permuted by partial pivoting */
+struct sparselu {
+	int n; //order of the block
+	int* pinv; //position in the factors of each row of the block
+	int* lp; //offsets of the columns of L (n+1 elements)
+	int* li; //rows of the elements of L, the unit diagonal first in each column
+	double* lx; //values of the elements of L
+	int* up; //offsets of the columns of U (n+1 elements)
+	int* ui; //rows of the elements of U, the diagonal last in each column
+	double* ux; //values of the elements of U
+};
+
+/**
+ * @brief Releases the sparse LU factors of a block
+ *
+ * @param lu Pointer to the factors (may be NULL)
+ */
+static void luFreeSparse(struct sparselu* lu) {
+
+	if (lu == NULL) {
+		return;
+	}
+
+	free(lu->pinv);
+	free(lu->lp);
+	free(lu->li);
+	free(lu->lx);
+	free(lu->up);
+	free(lu->ui);
+	free(lu->ux);
+	free(lu);
+}
+
+/**
+ * @brief Rows reached from the pattern of a column in the graph of the columns of L already computed, in topological order
+ *
+ * @param lu Pointer to the factors being computed
+ * @param ap Pointer to the offsets of the columns of the block
+ * @param ai Pointer to the rows of the elements of the block
+ * @param k Column of the block
+ * @param xi Pointer to n elements, the reached rows are stored in xi[top..n-1]
+ * @param stack Pointer to n elements used by the depth first search
+ * @param pstack Pointer to n elements used by the depth first search
+ * @param mark Pointer to n elements, rows equal to k are already reached
+ *
+ * @return top
+ */
+static int luReach(const struct sparselu* lu, const int* ap, const int* ai, const int k, int* xi, int* stack, int* pstack, int* mark) {
+
+	int top = lu->n;
+
+	for (int p = ap[k]; p < ap[k+1]; p++) {
+		if (mark[ai[p]] == k) {
+			continue;
+		}
+
+		//depth first search from the row, the rows are stored when all their children are done
+		int head = 0;
+		stack[0] = ai[p];
+		while (head >= 0) {
+			int j = stack[head];
+			int col = lu->pinv[j];
+			if (mark[j] != k) {
+				mark[j] = k;
+				pstack[head] = col < 0 ? 0 : lu->lp[col];
+			}
+			int end = col < 0 ? 0 : lu->lp[col+1];
+			int done = 1;
+			for (int q = pstack[head]; q < end; q++) {
+				int i = lu->li[q];
+				if (mark[i] == k) {
+					continue;
+				}
+				pstack[head] = q+1;
+				stack[++head] = i;
+				done = 0;
+				break;
+			}
+			if (done) {
+				head--;
+				xi[--top] = j;
+			}
+		}
+	}
+
+	return top;
+}
+
+/**
+ * @brief Left-looking sparse LU factorization with partial pivoting (Gilbert-Peierls) of a block stored by columns
+ *
+ * @param ap Pointer to the n+1 offsets of the columns
+ * @param ai Pointer to the rows of the elements
+ * @param ax Pointer to the values of the elements
+ * @param n Order of the block
+ *
+ * @return the factors, NULL if errors occurred or the block is singular
+ */
+static struct sparselu* luSparse(const int* ap, const int* ai, const double* ax, const int n) {
+
+	struct sparselu* lu = calloc(1, sizeof(struct sparselu));
+	if (lu == NULL) {
+		return NULL;
+	}
+
+	long lcap = 4L*ap[n] + n;
+	long ucap = 4L*ap[n] + n;
+	lu->n = n;
+	lu->pinv = malloc((n > 0 ? n : 1)*sizeof(int));
+	lu->lp = malloc((n+1)*sizeof(int));
+	lu->up = malloc((n+1)*sizeof(int));
+	lu->li = malloc(lcap*sizeof(int));
+	lu->lx = malloc(lcap*sizeof(double));
+	lu->ui = malloc(ucap*sizeof(int));
+	lu->ux = malloc(ucap*sizeof(double));
+	double* x = calloc(n > 0 ? n : 1, sizeof(double));
+	int* xi = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* stack = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* pstack = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* mark = malloc((n > 0 ? n : 1)*sizeof(int));
+	int ok = (lu->pinv != NULL && lu->lp != NULL && lu->up != NULL && lu->li != NULL && lu->lx != NULL
+			&& lu->ui != NULL && lu->ux != NULL && x != NULL && xi != NULL && stack != NULL && pstack != NULL && mark != NULL);
+
+	for (int i = 0; ok && i < n; i++) {
+		lu->pinv[i] = -1;
+		mark[i] = -1;
+	}
+
+	int lnz = 0;
+	int unz = 0;
+	for (int k = 0; ok && k < n; k++) {
+		lu->lp[k] = lnz;
+		lu->up[k] = unz;
+
+		//room for a full column in both factors
+		if (lnz + n > lcap) {
+			lcap = 2*lcap + n;
+			int* li = realloc(lu->li, lcap*sizeof(int));
+			double* lx = li != NULL ? realloc(lu->lx, lcap*sizeof(double)) : NULL;
+			lu->li = li != NULL ? li : lu->li;
+			lu->lx = lx != NULL ? lx : lu->lx;
+			ok = (li != NULL && lx != NULL);
+		}
+		if (ok && unz + n > ucap) {
+			ucap = 2*ucap + n;
+			int* ui = realloc(lu->ui, ucap*sizeof(int));
+			double* ux = ui != NULL ? realloc(lu->ux, ucap*sizeof(double)) : NULL;
+			lu->ui = ui != NULL ? ui : lu->ui;
+			lu->ux = ux != NULL ? ux : lu->ux;
+			ok = (ui != NULL && ux != NULL);
+		}
+		if (!ok) {
+			break;
+		}
+
+		//solving L*x = A(:,k) on the reached rows only
+		int top = luReach(lu, ap, ai, k, xi, stack, pstack, mark);
+		for (int p = ap[k]; p < ap[k+1]; p++) {
+			x[ai[p]] += ax[p];
+		}
+		for (int p = top; p < n; p++) {
+			int j = xi[p];
+			int col = lu->pinv[j];
+			if (col < 0) {
+				continue;
+			}
+			for (int q = lu->lp[col]+1; q < lu->lp[col+1]; q++) {
+				x[lu->li[q]] -= lu->lx[q]*x[j];
+			}
+		}
+
+		//rows already pivoted go to U, the largest of the others is the pivot
+		int ipiv = -1;
+		double largest = 0;
+		for (int p = top; p < n; p++) {
+			int i = xi[p];
+			if (lu->pinv[i] < 0) {
+				if (fabs(x[i]) > largest) {
+					largest = fabs(x[i]);
+					ipiv = i;
+				}
+			} else {
+				lu->ui[unz] = lu->pinv[i];
+				lu->ux[unz] = x[i];
+				unz++;
+			}
+		}
+		if (ipiv < 0) {
+			ok = 0;
+			break;
+		}
+
+		double pivot = x[ipiv];
+		lu->ui[unz] = k;
+		lu->ux[unz] = pivot;
+		unz++;
+		lu->pinv[ipiv] = k;
+		lu->li[lnz] = ipiv;
+		lu->lx[lnz] = 1;
+		lnz++;
+		for (int p = top; p < n; p++) {
+			int i = xi[p];
+			if (lu->pinv[i] < 0) {
+				lu->li[lnz] = i;
+				lu->lx[lnz] = x[i]/pivot;
+				lnz++;
+			}
+			x[i] = 0;
+		}
+	}
+
+	if (ok) {
+		lu->lp[n] = lnz;
+		lu->up[n] = unz;
+
+		//rows of L in the order of the factors
+		for (int p = 0; p < lnz; p++) {
+			lu->li[p] = lu->pinv[lu->li[p]];
+		}
+	}
+
+	free(x);
+	free(xi);
+	free(stack);
+	free(pstack);
+	free(mark);
+
+	if (!ok) {
+		luFreeSparse(lu);
+		return NULL;
+	}
+
+	return lu;
+}
+
+/**
+ * @brief Solves a linear system with the sparse LU factors of a block
+ *
+ * @param lu Pointer to the factors
+ * @param b Pointer to the n elements of the right hand side
+ * @param x Pointer to the n elements where the solution is stored
+ */
+static void luSolveSparse(const struct sparselu* lu, const double* b, double* x) {
+
+	int n = lu->n;
+
+	for (int i = 0; i < n; i++) {
+		x[lu->pinv[i]] = b[i];
+	}
+	for (int c = 0; c < n; c++) {
+		for (int p = lu->lp[c]+1; p < lu->lp[c+1]; p++) {
+			x[lu->li[p]] -= lu->lx[p]*x[c];
+		}
+	}
+	for (int c = n-1; c >= 0; c--) {
+		x[c] /= lu->ux[lu->up[c+1]-1];
+		for (int p = lu->up[c]; p < lu->up[c+1]-1; p++) {
+			x[lu->ui[p]] -= lu->ux[p]*x[c];
+		}
+	}
+}
+
+/**
+ * @brief Builds a block Jacobi (overlap 0) or additive Schwarz preconditioner of the square sparse matrix pointed by in,
+ * factorizing the submatrix of each block with a dense LU (up to BLOCK_DENSE_MAX rows) or a sparse LU
+ *
+ * Blocks are extracted and factorized in parallel when built with OpenMP.
+ *
+ * @param prec Pointer to the preconditioner to build, to release with blockFreeSparse
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param start Pointer to an array of nblocks+1 elements, block b starts at row start[b] and ends before start[b+1]
+ * @param nblocks Number of blocks
+ * @param overlap Number of levels of neighbouring rows added to each block
+ *
+ * @return 0 if errors occurred
+ */
+int blockSetupSparse(blockprec_t* prec, const elem_t* in, const int* start, const int nblocks, const int overlap) {
+
+	//check
+	if (prec == NULL || in == NULL || start == NULL || in->i != in->j || nblocks < 1 || overlap < 0
+			|| start[0] != 0 || start[nblocks] != in->i) {
+		return 0;
+	}
+	for (int b = 0; b < nblocks; b++) {
+		if (start[b] > start[b+1]) {
+			return 0;
+		}
+	}
+
+	int n = in->i;
+
+	prec->n = n;
+	prec->nblocks = nblocks;
+	prec->ptr = calloc(nblocks+1, sizeof(int));
+	prec->offset = calloc(nblocks+1, sizeof(long));
+	prec->sparse = calloc(nblocks, sizeof(struct sparselu*));
+	prec->rows = NULL;
+	prec->lu = NULL;
+	prec->piv = NULL;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		blockFreeSparse(prec);
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int* mark = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* pos = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* rows = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* blockok = malloc(nblocks*sizeof(int));
+	int ok = (prec->ptr != NULL && prec->offset != NULL && prec->sparse != NULL && mark != NULL && pos != NULL
+			&& rows != NULL && blockok != NULL);
+
+	for (int r = 0; ok && r < n; r++) {
+		mark[r] = -1;
+	}
+
+	//rows of each block, extended with the neighbours of the previous level
+	int total = 0;
+	for (int b = 0; ok && b < nblocks; b++) {
+		int len = 0;
+		for (int r = start[b]; r < start[b+1]; r++) {
+			mark[r] = b;
+			rows[len] = r;
+			len++;
+		}
+		int from = 0;
+		for (int l = 0; l < overlap; l++) {
+			int to = len;
+			for (int p = from; p < to; p++) {
+				for (int q = ptr[rows[p]]; q < ptr[rows[p]+1]; q++) {
+					int c = (in+perm[q]+1)->j;
+					if (mark[c] != b) {
+						mark[c] = b;
+						rows[len] = c;
+						len++;
+					}
+				}
+			}
+			from = to;
+		}
+
+		int* grown = realloc(prec->rows, (total+len > 0 ? total+len : 1)*sizeof(int));
+		if (grown == NULL) {
+			ok = 0;
+			break;
+		}
+		prec->rows = grown;
+		for (int p = 0; p < len; p++) {
+			prec->rows[total+p] = rows[p];
+		}
+		total += len;
+		prec->ptr[b+1] = total;
+
+		//only small blocks are stored dense
+		prec->offset[b+1] = prec->offset[b] + (len <= BLOCK_DENSE_MAX ? (long) len*len : 0);
+	}
+
+	if (ok) {
+		prec->lu = calloc(prec->offset[nblocks] > 0 ? prec->offset[nblocks] : 1, sizeof(double));
+		prec->piv = malloc((total > 0 ? total : 1)*sizeof(int));
+		ok = (prec->lu != NULL && prec->piv != NULL);
+	}
+
+	for (long r = 0; ok && r < (long) threads*n; r++) {
+		pos[r] = -1;
+	}
+
+	//extracting and factorizing each block
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 1)
+#endif
+		for (int b = 0; b < nblocks; b++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			int* tpos = pos + (long) t*n;
+			int* brows = prec->rows+prec->ptr[b];
+			int len = prec->ptr[b+1] - prec->ptr[b];
+
+			for (int p = 0; p < len; p++) {
+				tpos[brows[p]] = p;
+			}
+
+			if (len <= BLOCK_DENSE_MAX) {
+				double* dense = prec->lu+prec->offset[b];
+				for (int p = 0; p < len; p++) {
+					for (int q = ptr[brows[p]]; q < ptr[brows[p]+1]; q++) {
+						elem_t curr = *(in+perm[q]+1);
+						if (tpos[curr.j] >= 0) {
+							dense[(long) p*len+tpos[curr.j]] += curr.value;
+						}
+					}
+				}
+				blockok[b] = luDense(dense, prec->piv+prec->ptr[b], len);
+			} else {
+
+				//submatrix of the block by columns
+				int nnz = 0;
+				for (int p = 0; p < len; p++) {
+					nnz += ptr[brows[p]+1] - ptr[brows[p]];
+				}
+				int* ap = calloc(len+1, sizeof(int));
+				int* ai = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+				double* ax = malloc((nnz > 0 ? nnz : 1)*sizeof(double));
+				blockok[b] = (ap != NULL && ai != NULL && ax != NULL);
+				if (blockok[b]) {
+					for (int p = 0; p < len; p++) {
+						for (int q = ptr[brows[p]]; q < ptr[brows[p]+1]; q++) {
+							int c = tpos[(in+perm[q]+1)->j];
+							if (c >= 0) {
+								ap[c+1]++;
+							}
+						}
+					}
+					for (int c = 0; c < len; c++) {
+						ap[c+1] += ap[c];
+					}
+					for (int p = 0; p < len; p++) {
+						for (int q = ptr[brows[p]]; q < ptr[brows[p]+1]; q++) {
+							elem_t curr = *(in+perm[q]+1);
+							int c = tpos[curr.j];
+							if (c >= 0) {
+								ai[ap[c]] = p;
+								ax[ap[c]] = curr.value;
+								ap[c]++;
+							}
+						}
+					}
+					for (int c = len; c > 0; c--) {
+						ap[c] = ap[c-1];
+					}
+					ap[0] = 0;
+
+					prec->sparse[b] = luSparse(ap, ai, ax, len);
+					blockok[b] = (prec->sparse[b] != NULL);
+				}
+				free(ap);
+				free(ai);
+				free(ax);
+			}
+
+			for (int p = 0; p < len; p++) {
+				tpos[brows[p]] = -1;
+			}
+		}
+
+		for (int b = 0; b < nblocks; b++) {
+			ok = ok && blockok[b];
+		}
+	}
+
+	free(mark);
+	free(pos);
+	free(rows);
+	free(blockok);
+	free(ptr);
+	free(perm);
+
+	if (!ok) {
+		blockFreeSparse(prec);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Applies the preconditioner to a vector, summing the solutions of all the blocks
+ *
+ * Blocks are solved in parallel when built with OpenMP, their solutions are then summed in order.
+ *
+ * @param out Pointer to an array of prec->n elements where the result is stored
+ * @param prec Pointer to the preconditioner
+ * @param in Pointer to an array of prec->n elements
+ *
+ * @return 0 if errors occurred
+ */
+int blockApplySparse(double* out, const blockprec_t* prec, const double* in) {
+
+	//check
+	if (out == NULL || prec == NULL || in == NULL || prec->lu == NULL) {
+		return 0;
+	}
+
+	//local right hand sides and solutions of all the blocks
+	int total = prec->ptr[prec->nblocks];
+	double* local = malloc(2*(total > 0 ? total : 1)*sizeof(double));
+	if (local == NULL) {
+		return 0;
+	}
+	double* solution = local + (total > 0 ? total : 1);
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int b = 0; b < prec->nblocks; b++) {
+		const int* brows = prec->rows+prec->ptr[b];
+		int len = prec->ptr[b+1] - prec->ptr[b];
+		double* rhs = local+prec->ptr[b];
+		double* x = solution+prec->ptr[b];
+
+		//restriction and local solve
+		for (int p = 0; p < len; p++) {
+			rhs[p] = in[brows[p]];
+		}
+		if (prec->sparse[b] != NULL) {
+			luSolveSparse(prec->sparse[b], rhs, x);
+		} else {
+			luSolveDense(prec->lu+prec->offset[b], prec->piv+prec->ptr[b], len, rhs);
+			for (int p = 0; p < len; p++) {
+				x[p] = rhs[p];
+			}
+		}
+	}
+
+	//prolongation
+	for (int r = 0; r < prec->n; r++) {
+		out[r] = 0;
+	}
+	for (int p = 0; p < total; p++) {
+		out[prec->rows[p]] += solution[p];
+	}
+
+	free(local);
+
+	return 1;
+}
+
+/**
+ * @brief Releases the memory of the preconditioner
+ *
+ * @param prec Pointer to the preconditioner
+ *
+ * @return 0 if errors occurred
+ */
+int blockFreeSparse(blockprec_t* prec) {
+
+	//check
+	if (prec == NULL) {
+		return 0;
+	}
+
+	for (int b = 0; prec->sparse != NULL && b < prec->nblocks; b++) {
+		luFreeSparse(prec->sparse[b]);
+	}
+	free(prec->ptr);
+	free(prec->rows);
+	free(prec->offset);
+	free(prec->lu);
+	free(prec->piv);
+	free(prec->sparse);
+
+	prec->ptr = NULL;
+	prec->rows = NULL;
+	prec->offset = NULL;
+	prec->lu = NULL;
+	prec->piv = NULL;
+	prec->sparse = NULL;
+	prec->nblocks = 0;
+
+	return 1;
+}
+
+/**
+ * @brief Orders the columns of the sparse matrix pointed by in to limit the fill of its QR factorization, with
+ * approximate minimum degree on the pattern of A'*A in the style of COLAMD: eliminating a column merges the rows
+ * containing it into one row (the pattern of the row of R), so A'*A is never formed
+ *
+ * The score of a column is the sum of the lengths of its rows (less the column), as in COLAMD rows with more than
+ * 10*sqrt(n) elements are left out of the ordering.
+ *
+ * @param order Pointer to an array of in->j elements where the columns are stored in elimination order
+ * @param in Pointer to the first element of the sparse matrix
+ * @param ptr Pointer to the row offsets built by indexSparse
+ * @param perm Pointer to the row permutation built by indexSparse
+ *
+ * @return 0 if errors occurred
+ */
+static int qrOrder(int* order, const elem_t* in, const int* ptr, const int* perm) {
+
+	int m = in->i;
+	int n = in->j;
+	int dense = (int) fmax(16, 10*sqrt(n));
+
+	//the rows of A, then a row for each eliminated column
+	int** rowcols = calloc(m+n > 0 ? m+n : 1, sizeof(int*));
+	int* rowlen = calloc(m+n > 0 ? m+n : 1, sizeof(int));
+	char* rowdead = calloc(m+n > 0 ? m+n : 1, 1);
+
+	//live rows containing each column, and the lists of the columns with the same score
+	int** colrows = calloc(n > 0 ? n : 1, sizeof(int*));
+	int* collen = calloc(n > 0 ? n : 1, sizeof(int));
+	int* colcap = calloc(n > 0 ? n : 1, sizeof(int));
+	int* score = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* head = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* next = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* prev = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* mark = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* merged = malloc((n > 0 ? n : 1)*sizeof(int));
+	int ok = (rowcols != NULL && rowlen != NULL && rowdead != NULL && colrows != NULL && collen != NULL && colcap != NULL
+			&& score != NULL && head != NULL && next != NULL && prev != NULL && mark != NULL && merged != NULL);
+
+	for (int c = 0; ok && c < n; c++) {
+		mark[c] = -1;
+		head[c] = -1;
+	}
+
+	//rows of A without repeated columns
+	for (int r = 0; ok && r < m; r++) {
+		int len = ptr[r+1] - ptr[r];
+		if (len > dense) {
+			rowdead[r] = 1;
+			continue;
+		}
+		rowcols[r] = malloc((len > 0 ? len : 1)*sizeof(int));
+		if (rowcols[r] == NULL) {
+			ok = 0;
+			break;
+		}
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			int c = (in+perm[p]+1)->j;
+			if (mark[c] != r) {
+				mark[c] = r;
+				rowcols[r][rowlen[r]] = c;
+				rowlen[r]++;
+				colcap[c]++;
+			}
+		}
+	}
+	for (int c = 0; ok && c < n; c++) {
+		colcap[c] = (colcap[c] > 0 ? colcap[c] : 1);
+		colrows[c] = malloc(colcap[c]*sizeof(int));
+		ok = (colrows[c] != NULL);
+	}
+	for (int r = 0; ok && r < m; r++) {
+		for (int p = 0; !rowdead[r] && p < rowlen[r]; p++) {
+			int c = rowcols[r][p];
+			colrows[c][collen[c]] = r;
+			collen[c]++;
+		}
+	}
+
+	int mindeg = 0;
+	for (int c = 0; ok && c < n; c++) {
+		long sum = 0;
+		for (int p = 0; p < collen[c]; p++) {
+			sum += rowlen[colrows[c][p]] - 1;
+		}
+		score[c] = (int) (sum < n-1 ? sum : n-1);
+		prev[c] = -1;
+		next[c] = head[score[c]];
+		if (next[c] >= 0) {
+			prev[next[c]] = c;
+		}
+		head[score[c]] = c;
+	}
+
+	for (int step = 0; ok && step < n; step++) {
+
+		//column with the lowest score
+		while (head[mindeg] < 0) {
+			mindeg++;
+		}
+		int pivot = head[mindeg];
+		head[mindeg] = next[pivot];
+		if (next[pivot] >= 0) {
+			prev[next[pivot]] = -1;
+		}
+		order[step] = pivot;
+
+		//merging the rows of the pivot, they are absorbed by the new row
+		int row = m+step;
+		int len = 0;
+		mark[pivot] = row;
+		for (int p = 0; p < collen[pivot]; p++) {
+			int r = colrows[pivot][p];
+			for (int q = 0; q < rowlen[r]; q++) {
+				int c = rowcols[r][q];
+				if (mark[c] != row) {
+					mark[c] = row;
+					merged[len] = c;
+					len++;
+				}
+			}
+			rowdead[r] = 1;
+			free(rowcols[r]);
+			rowcols[r] = NULL;
+		}
+		collen[pivot] = 0;
+		if (len == 0) {
+			continue;
+		}
+		rowcols[row] = malloc(len*sizeof(int));
+		if (rowcols[row] == NULL) {
+			ok = 0;
+			break;
+		}
+		for (int p = 0; p < len; p++) {
+			rowcols[row][p] = merged[p];
+		}
+		rowlen[row] = len;
+
+		//the columns of the new row lose the absorbed rows and get new scores
+		int live = n-step-1;
+		for (int p = 0; ok && p < len; p++) {
+			int c = merged[p];
+			int kept = 0;
+			long sum = 0;
+			for (int q = 0; q < collen[c]; q++) {
+				int r = colrows[c][q];
+				if (!rowdead[r]) {
+					colrows[c][kept] = r;
+					kept++;
+					sum += rowlen[r] - 1;
+				}
+			}
+			if (kept == colcap[c]) {
+				int* grown = realloc(colrows[c], 2*colcap[c]*sizeof(int));
+				if (grown == NULL) {
+					ok = 0;
+					break;
+				}
+				colrows[c] = grown;
+				colcap[c] *= 2;
+			}
+			colrows[c][kept] = row;
+			collen[c] = kept+1;
+			sum += len-1;
+
+			if (prev[c] >= 0) {
+				next[prev[c]] = next[c];
+			} else {
+				head[score[c]] = next[c];
+			}
+			if (next[c] >= 0) {
+				prev[next[c]] = prev[c];
+			}
+			score[c] = (int) (sum < live-1 ? sum : live-1);
+			prev[c] = -1;
+			next[c] = head[score[c]];
+			if (next[c] >= 0) {
+				prev[next[c]] = c;
+			}
+			head[score[c]] = c;
+			if (score[c] < mindeg) {
+				mindeg = score[c];
+			}
+		}
+	}
+
+	for (int r = 0; rowcols != NULL && r < m+n; r++) {
+		free(rowcols[r]);
+	}
+	for (int c = 0; colrows != NULL && c < n; c++) {
+		free(colrows[c]);
+	}
+	free(rowcols);
+	free(rowlen);
+	free(rowdead);
+	free(colrows);
+	free(collen);
+	free(colcap);
+	free(score);
+	free(head);
+	free(next);
+	free(prev);
+	free(mark);
+	free(merged);
+
+	return ok;
+}
+
+/**
+ * @brief Sparse QR factorization of the sparse matrix pointed by in (with at least as many rows as columns),
+ * multifrontal with Householder reflections after ordering the columns to limit the fill of R
+ *
+ * The columns are ordered with approximate minimum degree on A'*A, in the style of COLAMD. The chains of columns
+ * of the column elimination tree with the same pattern in R (fundamental supernodes) share a dense front with the
+ * rows of A starting in them and the contribution blocks of their children, its Householder QR gives their rows of
+ * R and the contribution block for the parent. The fronts of a level of the tree are independent and are
+ * factorized in parallel with OpenMP.
+ * Q isn't stored, qrSolveSparse uses the matrix again to solve least squares problems.
+ *
+ * @param qr Pointer to the factorization to build, to release with qrFreeSparse
+ * @param in Pointer to the first element of the sparse matrix
+ *
+ * @return 0 if errors occurred
+ */
+int qrSparse(sparseqr_t* qr, const elem_t* in) {
+
+	//check
+	if (qr == NULL || in == NULL || in->i < in->j) {
+		return 0;
+	}
+
+	int m = in->i;
+	int n = in->j;
+
+	qr->m = m;
+	qr->n = n;
+	qr->perm = malloc((n > 0 ? n : 1)*sizeof(int));
+	qr->len = calloc(n > 0 ? n : 1, sizeof(int));
+	qr->cols = calloc(n > 0 ? n : 1, sizeof(int*));
+	qr->vals = calloc(n > 0 ? n : 1, sizeof(double*));
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		qrFreeSparse(qr);
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int* position = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* leftptr = calloc(n+1, sizeof(int));
+	int* leftrows = malloc((m > 0 ? m : 1)*sizeof(int));
+	int* rowleft = malloc((m > 0 ? m : 1)*sizeof(int));
+	int* child = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* sibling = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* first = malloc((n+1)*sizeof(int));
+	int* super = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* frows = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* cbrows = calloc(n > 0 ? n : 1, sizeof(int));
+	int* height = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* levelptr = calloc(n+1, sizeof(int));
+	int* levelfronts = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* mark = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* work = malloc((n > 0 ? n : 1)*sizeof(int));
+	int* pos = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	int* frontok = malloc((n > 0 ? n : 1)*sizeof(int));
+	double** cb = calloc(n > 0 ? n : 1, sizeof(double*));
+	int ok = (qr->perm != NULL && qr->len != NULL && qr->cols != NULL && qr->vals != NULL
+			&& position != NULL && leftptr != NULL && leftrows != NULL && rowleft != NULL && child != NULL
+			&& sibling != NULL && first != NULL && super != NULL && frows != NULL && cbrows != NULL && height != NULL
+			&& levelptr != NULL && levelfronts != NULL && mark != NULL && work != NULL && pos != NULL
+			&& frontok != NULL && cb != NULL);
+
+	//fill reducing order of the columns
+	ok = ok && qrOrder(qr->perm, in, ptr, perm);
+	for (int c = 0; ok && c < n; c++) {
+		position[qr->perm[c]] = c;
+		mark[c] = -1;
+		child[c] = -1;
+	}
+
+	//rows of A grouped by their leftmost column, where they enter the factorization
+	for (int r = 0; ok && r < m; r++) {
+		rowleft[r] = n;
+		for (int p = ptr[r]; p < ptr[r+1]; p++) {
+			int c = position[(in+perm[p]+1)->j];
+			if (c < rowleft[r]) {
+				rowleft[r] = c;
+			}
+		}
+		if (rowleft[r] < n) {
+			leftptr[rowleft[r]+1]++;
+		}
+	}
+	for (int c = 0; ok && c < n; c++) {
+		leftptr[c+1] += leftptr[c];
+		work[c] = leftptr[c];
+	}
+	for (int r = 0; ok && r < m; r++) {
+		if (rowleft[r] < n) {
+			leftrows[work[rowleft[r]]] = r;
+			work[rowleft[r]]++;
+		}
+	}
+
+	//symbolic factorization, the pattern of a row of R joins the rows of A starting in the column and the
+	//patterns of its children in the column elimination tree (the parent is the second column of the pattern)
+	int nsuper = 0;
+	for (int k = 0; ok && k < n; k++) {
+		int len = 1;
+		work[0] = k;
+		mark[k] = k;
+		for (int p = leftptr[k]; p < leftptr[k+1]; p++) {
+			int r = leftrows[p];
+			for (int q = ptr[r]; q < ptr[r+1]; q++) {
+				int c = position[(in+perm[q]+1)->j];
+				if (mark[c] != k) {
+					mark[c] = k;
+					work[len] = c;
+					len++;
+				}
+			}
+		}
+		for (int c = child[k]; c >= 0; c = sibling[c]) {
+			for (int p = 1; p < qr->len[c]; p++) {
+				if (mark[qr->cols[c][p]] != k) {
+					mark[qr->cols[c][p]] = k;
+					work[len] = qr->cols[c][p];
+					len++;
+				}
+			}
+		}
+		for (int p = 1; p < len; p++) {
+			int c = work[p];
+			int q = p;
+			while (q > 0 && work[q-1] > c) {
+				work[q] = work[q-1];
+				q--;
+			}
+			work[q] = c;
+		}
+
+		qr->cols[k] = malloc(len*sizeof(int));
+		qr->vals[k] = malloc(len*sizeof(double));
+		if (qr->cols[k] == NULL || qr->vals[k] == NULL) {
+			ok = 0;
+			break;
+		}
+		for (int p = 0; p < len; p++) {
+			qr->cols[k][p] = work[p];
+		}
+		qr->len[k] = len;
+		if (len > 1) {
+			sibling[k] = child[work[1]];
+			child[work[1]] = k;
+		}
+
+		//a column continues the supernode of its only child if it has the same pattern
+		if (k > 0 && child[k] == k-1 && sibling[k-1] < 0 && len == qr->len[k-1]-1) {
+			super[k] = super[k-1];
+		} else {
+			super[k] = nsuper;
+			first[nsuper] = k;
+			nsuper++;
+		}
+	}
+
+	//rows and levels of the fronts, the children of a supernode are the children of its first column
+	int levels = 0;
+	for (int s = 0; ok && s < nsuper; s++) {
+		int k = first[s];
+		int last = (s+1 < nsuper ? first[s+1] : n);
+		frows[s] = leftptr[last] - leftptr[k];
+		height[s] = 0;
+		for (int c = child[k]; c >= 0; c = sibling[c]) {
+			frows[s] += cbrows[super[c]];
+			if (height[super[c]]+1 > height[s]) {
+				height[s] = height[super[c]]+1;
+			}
+		}
+		cbrows[s] = (frows[s] < qr->len[k] ? frows[s] : qr->len[k]) - (last-k);
+		if (cbrows[s] < 0) {
+			cbrows[s] = 0;
+		}
+		if (height[s]+1 > levels) {
+			levels = height[s]+1;
+		}
+		levelptr[height[s]+1]++;
+	}
+	if (ok) {
+		first[nsuper] = n;
+	}
+	for (int h = 0; ok && h < levels; h++) {
+		levelptr[h+1] += levelptr[h];
+		work[h] = levelptr[h];
+	}
+	for (int s = 0; ok && s < nsuper; s++) {
+		levelfronts[work[height[s]]] = s;
+		work[height[s]]++;
+	}
+
+	for (long r = 0; ok && r < (long) threads*n; r++) {
+		pos[r] = -1;
+	}
+
+	//numeric factorization, a level only depends on the contribution blocks of the levels below
+	for (int h = 0; ok && h < levels; h++) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 1)
+#endif
+		for (int f = levelptr[h]; f < levelptr[h+1]; f++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			int* tpos = pos + (long) t*n;
+			int s = levelfronts[f];
+			int k = first[s];
+			int pivots = first[s+1] - k;
+			int len = qr->len[k];
+			int rows = frows[s];
+			int* cols = qr->cols[k];
+
+			double* front = calloc((long) rows*len > 0 ? (long) rows*len : 1, sizeof(double));
+			double* block = malloc(((long) cbrows[s]*(len-pivots) > 0 ? (long) cbrows[s]*(len-pivots) : 1)*sizeof(double));
+			frontok[s] = (front != NULL && block != NULL);
+			if (!frontok[s]) {
+				free(front);
+				free(block);
+				continue;
+			}
+			for (int p = 0; p < len; p++) {
+				tpos[cols[p]] = p;
+			}
+
+			//assembling the rows of A and the contribution blocks of the children (by columns)
+			int r = 0;
+			for (int p = leftptr[k]; p < leftptr[k+pivots]; p++) {
+				for (int q = ptr[leftrows[p]]; q < ptr[leftrows[p]+1]; q++) {
+					elem_t curr = *(in+perm[q]+1);
+					front[r + (long) tpos[position[curr.j]]*rows] += curr.value;
+				}
+				r++;
+			}
+			for (int c = child[k]; c >= 0; c = sibling[c]) {
+				int cs = super[c];
+				int* ccols = qr->cols[first[cs]];
+				int cpivots = first[cs+1] - first[cs];
+				int clen = qr->len[first[cs]] - cpivots;
+				for (int i = 0; i < cbrows[cs]; i++) {
+					for (int u = i; u < clen; u++) {
+						front[r + (long) tpos[ccols[cpivots+u]]*rows] = cb[cs][(long) i*clen+u];
+					}
+					r++;
+				}
+				free(cb[cs]);
+				cb[cs] = NULL;
+			}
+
+			//Householder QR of the front
+			int steps = (rows < len ? rows : len);
+			for (int i = 0; i < steps; i++) {
+				double* x = front + i + (long) i*rows;
+				double sigma = 0;
+				for (int q = 1; q < rows-i; q++) {
+					sigma += x[q]*x[q];
+				}
+				if (sigma == 0) {
+					continue;
+				}
+				double alpha = x[0];
+				double beta = -copysign(sqrt(alpha*alpha + sigma), alpha);
+				double tau = (beta-alpha)/beta;
+				for (int q = 1; q < rows-i; q++) {
+					x[q] /= alpha-beta;
+				}
+				x[0] = beta;
+				for (int c = i+1; c < len; c++) {
+					double* y = front + i + (long) c*rows;
+					double w = y[0];
+					for (int q = 1; q < rows-i; q++) {
+						w += x[q]*y[q];
+					}
+					w *= tau;
+					y[0] -= w;
+					for (int q = 1; q < rows-i; q++) {
+						y[q] -= w*x[q];
+					}
+				}
+			}
+
+			//the first rows are the rows of R of the pivots, the rest (upper trapezoidal) goes to the parent
+			for (int i = 0; i < pivots; i++) {
+				for (int p = i; p < len; p++) {
+					qr->vals[k+i][p-i] = (i < rows ? front[i + (long) p*rows] : 0);
+				}
+			}
+			for (int i = 0; i < cbrows[s]; i++) {
+				for (int u = i; u < len-pivots; u++) {
+					block[(long) i*(len-pivots)+u] = front[pivots+i + (long) (pivots+u)*rows];
+				}
+			}
+			cb[s] = block;
+
+			for (int p = 0; p < len; p++) {
+				tpos[cols[p]] = -1;
+			}
+			free(front);
+		}
+
+		for (int f = levelptr[h]; f < levelptr[h+1]; f++) {
+			ok = ok && frontok[levelfronts[f]];
+		}
+	}
+
+	for (int s = 0; cb != NULL && s < n; s++) {
+		free(cb[s]);
+	}
+	free(position);
+	free(leftptr);
+	free(leftrows);
+	free(rowleft);
+	free(child);
+	free(sibling);
+	free(first);
+	free(super);
+	free(frows);
+	free(cbrows);
+	free(height);
+	free(levelptr);
+	free(levelfronts);
+	free(mark);
+	free(work);
+	free(pos);
+	free(frontok);
+	free(cb);
+	free(ptr);
+	free(perm);
+
+	if (!ok) {
+		qrFreeSparse(qr);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Solves R'*x = y in place with the rows of R (permuted columns)
+ *
+ * @param qr Pointer to the factorization
+ * @param y Pointer to the right hand side, replaced by the solution
+ *
+ * @return 0 if R is singular
+ */
+static int qrSolveRT(const sparseqr_t* qr, double* y) {
+
+	int n = qr->n;
+
+	//forward substitution, a row of R is a column of R'
+	for (int k = 0; k < n; k++) {
+		double diagonal = 0;
+		for (int p = 0; p < qr->len[k]; p++) {
+			if (qr->cols[k][p] == k) {
+				diagonal = qr->vals[k][p];
+			}
+		}
+		if (diagonal == 0) {
+			return 0;
+		}
+		y[k] /= diagonal;
+		for (int p = 0; p < qr->len[k]; p++) {
+			if (qr->cols[k][p] > k) {
+				y[qr->cols[k][p]] -= qr->vals[k][p]*y[k];
+			}
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Solves R*x = y in place with the rows of R (permuted columns)
+ *
+ * @param qr Pointer to the factorization
+ * @param y Pointer to the right hand side, replaced by the solution
+ *
+ * @return 0 if R is singular
+ */
+static int qrSolveR(const sparseqr_t* qr, double* y) {
+
+	//back substitution
+	for (int k = qr->n-1; k >= 0; k--) {
+		double diagonal = 0;
+		for (int p = 0; p < qr->len[k]; p++) {
+			if (qr->cols[k][p] == k) {
+				diagonal = qr->vals[k][p];
+			} else {
+				y[k] -= qr->vals[k][p]*y[qr->cols[k][p]];
+			}
+		}
+		if (diagonal == 0) {
+			return 0;
+		}
+		y[k] /= diagonal;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Solves R'*R*x = y in place with the rows of R (permuted columns)
+ *
+ * @param qr Pointer to the factorization
+ * @param y Pointer to the right hand side, replaced by the solution
+ *
+ * @return 0 if R is singular
+ */
+static int qrSemiNormal(const sparseqr_t* qr, double* y) {
+
+	return qrSolveRT(qr, y) && qrSolveR(qr, y);
+}
+
+/**
+ * @brief Solves the least squares problem min ||A*x-b|| with the factorization of A, using the corrected
+ * semi-normal equations R'*R*x = A'*b (one step of refinement), so any number of right hand sides can be solved
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param qr Pointer to the factorization of the matrix
+ * @param in Pointer to the first element of the factorized sparse matrix
+ * @param b Pointer to an array of in->i elements
+ *
+ * @return 0 if errors occurred (also if the matrix is rank deficient)
+ */
+int qrSolveSparse(double* x, const sparseqr_t* qr, const elem_t* in, const double* b) {
+
+	//check
+	if (x == NULL || qr == NULL || qr->perm == NULL || in == NULL || b == NULL || in->i != qr->m || in->j != qr->n) {
+		return 0;
+	}
+
+	int m = qr->m;
+	int n = qr->n;
+	int nnz = (int) in->value;
+
+	int* position = malloc((n > 0 ? n : 1)*sizeof(int));
+	double* y = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* residual = malloc((m > 0 ? m : 1)*sizeof(double));
+	if (position == NULL || y == NULL || residual == NULL) {
+		free(position);
+		free(y);
+		free(residual);
+		return 0;
+	}
+	for (int c = 0; c < n; c++) {
+		position[qr->perm[c]] = c;
+		x[c] = 0;
+	}
+	for (int r = 0; r < m; r++) {
+		residual[r] = b[r];
+	}
+
+	int ok = 1;
+	for (int step = 0; ok && step < 2; step++) {
+
+		//y = A'*residual in the permuted order
+		for (int c = 0; c < n; c++) {
+			y[c] = 0;
+		}
+		for (int k = 0; k < nnz; k++) {
+			elem_t curr = *(in+k+1);
+			y[position[curr.j]] += curr.value*residual[curr.i];
+		}
+
+		ok = qrSemiNormal(qr, y);
+
+		for (int c = 0; ok && c < n; c++) {
+			x[qr->perm[c]] += y[c];
+		}
+
+		//residual of the current solution
+		for (int r = 0; r < m; r++) {
+			residual[r] = b[r];
+		}
+		for (int k = 0; k < nnz; k++) {
+			elem_t curr = *(in+k+1);
+			residual[curr.i] -= curr.value*x[curr.j];
+		}
+	}
+
+	free(position);
+	free(y);
+	free(residual);
+
+	return ok;
+}
+
+/**
+ * @brief Releases the memory of the factorization
+ *
+ * @param qr Pointer to the factorization
+ *
+ * @return 0 if errors occurred
+ */
+int qrFreeSparse(sparseqr_t* qr) {
+
+	//check
+	if (qr == NULL) {
+		return 0;
+	}
+
+	for (int k = 0; qr->cols != NULL && k < qr->n; k++) {
+		free(qr->cols[k]);
+	}
+	for (int k = 0; qr->vals != NULL && k < qr->n; k++) {
+		free(qr->vals[k]);
+	}
+	free(qr->perm);
+	free(qr->len);
+	free(qr->cols);
+	free(qr->vals);
+
+	qr->perm = NULL;
+	qr->len = NULL;
+	qr->cols = NULL;
+	qr->vals = NULL;
+
+	return 1;
+}
+
+/**
+ * @brief Multiplies the transpose of the sparse matrix pointed by in by a vector and stores the result in the vector pointed by out
+ *
+ * @param out Pointer to an array of in->j elements where the result is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param v Pointer to an array of in->i elements
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_VectorT(double* out, const elem_t* in, const double* v) {
+
+	//check
+	if (out == NULL || in == NULL || v == NULL) {
+		return 0;
+	}
+
+	for (int c = 0; c < in->j; c++) {
+		out[c] = 0;
+	}
+
+	//same elements of multiplySparse_Vector with the roles of i and j swapped
+	for (int k = 0; k < (int) in->value; k++) {
+		elem_t curr = *(in+k+1);
+		out[curr.j] += curr.value*v[curr.i];
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Multiplies by the sparse matrix pointed by in, or by A*P*R^-1 with R and P of a factorization used as
+ * right preconditioner
+ *
+ * @param out Pointer to an array of in->i elements where the result is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param prec Pointer to the factorization (NULL for A alone)
+ * @param v Pointer to an array of in->j elements
+ * @param work Pointer to a buffer of 2*in->j elements (used with prec)
+ */
+static void precProduct(double* out, const elem_t* in, const sparseqr_t* prec, const double* v, double* work) {
+
+	if (prec == NULL) {
+		multiplySparse_Vector(out, in, v);
+		return;
+	}
+
+	int n = in->j;
+	for (int c = 0; c < n; c++) {
+		work[c] = v[c];
+	}
+	qrSolveR(prec, work);
+	for (int c = 0; c < n; c++) {
+		work[n+prec->perm[c]] = work[c];
+	}
+	multiplySparse_Vector(out, in, work+n);
+}
+
+/**
+ * @brief Multiplies by the transpose of the sparse matrix pointed by in, or by R^-T*P'*A' with R and P of a
+ * factorization used as right preconditioner
+ *
+ * @param out Pointer to an array of in->j elements where the result is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param prec Pointer to the factorization (NULL for A alone)
+ * @param u Pointer to an array of in->i elements
+ * @param work Pointer to a buffer of 2*in->j elements (used with prec)
+ */
+static void precProductT(double* out, const elem_t* in, const sparseqr_t* prec, const double* u, double* work) {
+
+	if (prec == NULL) {
+		multiplySparse_VectorT(out, in, u);
+		return;
+	}
+
+	int n = in->j;
+	multiplySparse_VectorT(work+n, in, u);
+	for (int c = 0; c < n; c++) {
+		out[c] = work[n+prec->perm[c]];
+	}
+	qrSolveRT(prec, out);
+}
+
+/**
+ * @brief Step of Golub-Kahan bidiagonalization: u = A*v - alpha*u, normalized, then v = A'*u - beta*v, normalized
+ *
+ * The scaling of each vector is fused with the computation of the norm of the next one.
+ *
+ * @param in Pointer to the first element of the sparse matrix
+ * @param prec Pointer to the factorization used as right preconditioner (NULL for none)
+ * @param u Pointer to the left vector (in->i elements)
+ * @param v Pointer to the right vector (in->j elements)
+ * @param tmp Pointer to a buffer of max(in->i,in->j) elements
+ * @param work Pointer to a buffer of 2*in->j elements (used with prec)
+ * @param alpha Pointer to the norm of v, updated
+ * @param beta Pointer to the norm of u, updated
+ */
+static void bidiagStep(const elem_t* in, const sparseqr_t* prec, double* u, double* v, double* tmp, double* work, double* alpha, double* beta) {
+
+	int m = in->i;
+	int n = in->j;
+
+	precProduct(tmp, in, prec, v, work);
+	double norm = 0;
+	for (int r = 0; r < m; r++) {
+		u[r] = tmp[r] - *alpha*u[r];
+		norm += u[r]*u[r];
+	}
+	*beta = sqrt(norm);
+
+	if (*beta > 0) {
+		for (int r = 0; r < m; r++) {
+			u[r] /= *beta;
+		}
+	}
+
+	precProductT(tmp, in, prec, u, work);
+	norm = 0;
+	for (int c = 0; c < n; c++) {
+		v[c] = tmp[c] - *beta*v[c];
+		norm += v[c]*v[c];
+	}
+	*alpha = sqrt(norm);
+
+	if (*alpha > 0) {
+		for (int c = 0; c < n; c++) {
+			v[c] /= *alpha;
+		}
+	}
+}
+
+/**
+ * @brief Start of Golub-Kahan bidiagonalization: beta*u = b, alpha*v = A'*u
+ *
+ * @param in Pointer to the first element of the sparse matrix
+ * @param prec Pointer to the factorization used as right preconditioner (NULL for none)
+ * @param b Pointer to the right hand side (in->i elements)
+ * @param u Pointer to the left vector (in->i elements)
+ * @param v Pointer to the right vector (in->j elements)
+ * @param work Pointer to a buffer of 2*in->j elements (used with prec)
+ * @param alpha Where to store the norm of v
+ * @param beta Where to store the norm of u
+ */
+static void bidiagStart(const elem_t* in, const sparseqr_t* prec, const double* b, double* u, double* v, double* work, double* alpha, double* beta) {
+
+	int m = in->i;
+	int n = in->j;
+
+	double norm = 0;
+	for (int r = 0; r < m; r++) {
+		norm += b[r]*b[r];
+	}
+	*beta = sqrt(norm);
+	for (int r = 0; r < m; r++) {
+		u[r] = *beta > 0 ? b[r] / *beta : 0;
+	}
+
+	precProductT(v, in, prec, u, work);
+	norm = 0;
+	for (int c = 0; c < n; c++) {
+		norm += v[c]*v[c];
+	}
+	*alpha = sqrt(norm);
+	if (*alpha > 0) {
+		for (int c = 0; c < n; c++) {
+			v[c] /= *alpha;
+		}
+	}
+}
+
+/**
+ * @brief Iterations of LSQR on min ||A*M*y-b||, where M is P*R^-1 with the factorization prec (x = M*y) or the identity
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param prec Pointer to the factorization used as right preconditioner (NULL for none)
+ * @param b Pointer to an array of in->i elements
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests, ||M'*A'*r|| <= tol*||A*M||*||r|| or (compatible systems)
+ * ||r|| <= tol*||b|| + tol*||A*M||*||y||
+ *
+ * @return 0 if errors occurred
+ */
+static int lsqrRun(double* x, const elem_t* in, const sparseqr_t* prec, const double* b, const int maxIter, const double tol) {
+
+	int m = in->i;
+	int n = in->j;
+	int big = m > n ? m : n;
+
+	double* u = malloc((m > 0 ? m : 1)*sizeof(double));
+	double* v = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* w = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* tmp = malloc((big > 0 ? big : 1)*sizeof(double));
+	double* work = malloc((2*n > 0 ? 2*n : 1)*sizeof(double));
+	if (u == NULL || v == NULL || w == NULL || tmp == NULL || work == NULL) {
+		free(u);
+		free(v);
+		free(w);
+		free(tmp);
+		free(work);
+		return 0;
+	}
+
+	double alpha;
+	double beta;
+	bidiagStart(in, prec, b, u, v, work, &alpha, &beta);
+
+	for (int c = 0; c < n; c++) {
+		x[c] = 0;
+		w[c] = v[c];
+	}
+
+	double bnorm = beta;
+	double phibar = beta;
+	double rhobar = alpha;
+	double anorm = 0;
+
+	for (int iter = 0; iter < maxIter && alpha*beta > 0; iter++) {
+
+		bidiagStep(in, prec, u, v, tmp, work, &alpha, &beta);
+		anorm = sqrt(anorm*anorm + alpha*alpha + beta*beta);
+
+		//plane rotation eliminating beta
+		double rho = hypot(rhobar, beta);
+		double c = rhobar/rho;
+		double s = beta/rho;
+		double theta = s*alpha;
+		rhobar = -c*alpha;
+		double phi = c*phibar;
+		phibar = s*phibar;
+
+		//updating x and w in the same pass
+		double xnorm = 0;
+		for (int k = 0; k < n; k++) {
+			x[k] += (phi/rho)*w[k];
+			w[k] = v[k] - (theta/rho)*w[k];
+			xnorm += x[k]*x[k];
+		}
+		xnorm = sqrt(xnorm);
+
+		//phibar is ||r|| and phibar*alpha*|c| is ||A'*r||
+		if (phibar <= tol*bnorm + tol*anorm*xnorm || phibar*alpha*fabs(c) <= tol*anorm*phibar) {
+			break;
+		}
+	}
+
+	//back to the variables of A
+	if (prec != NULL) {
+		qrSolveR(prec, x);
+		for (int c = 0; c < n; c++) {
+			work[prec->perm[c]] = x[c];
+		}
+		for (int c = 0; c < n; c++) {
+			x[c] = work[c];
+		}
+	}
+
+	free(u);
+	free(v);
+	free(w);
+	free(tmp);
+	free(work);
+
+	return 1;
+}
+
+/**
+ * @brief Solves min ||A*x-b|| with LSQR, using only products by the sparse matrix pointed by in and by its transpose
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests, ||A'*r|| <= tol*||A||*||r|| or (compatible systems)
+ * ||r|| <= tol*||b|| + tol*||A||*||x||
+ *
+ * @return 0 if errors occurred
+ */
+int lsqrSparse(double* x, const elem_t* in, const double* b, const int maxIter, const double tol) {
+
+	//check
+	if (x == NULL || in == NULL || b == NULL) {
+		return 0;
+	}
+
+	return lsqrRun(x, in, NULL, b, maxIter, tol);
+}
+
+/**
+ * @brief Solves min ||A*x-b|| with LSMR, using only products by the sparse matrix pointed by in and by its transpose
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests, ||A'*r|| <= tol*||A||*||r|| or (compatible systems)
+ * ||r|| <= tol*||b|| + tol*||A||*||x||
+ *
+ * @return 0 if errors occurred
+ */
+int lsmrSparse(double* x, const elem_t* in, const double* b, const int maxIter, const double tol) {
+
+	//check
+	if (x == NULL || in == NULL || b == NULL) {
+		return 0;
+	}
+
+	int m = in->i;
+	int n = in->j;
+	int big = m > n ? m : n;
+
+	double* u = malloc((m > 0 ? m : 1)*sizeof(double));
+	double* v = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* h = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* hbar = malloc((n > 0 ? n : 1)*sizeof(double));
+	double* tmp = malloc((big > 0 ? big : 1)*sizeof(double));
+	if (u == NULL || v == NULL || h == NULL || hbar == NULL || tmp == NULL) {
+		free(u);
+		free(v);
+		free(h);
+		free(hbar);
+		free(tmp);
+		return 0;
+	}
+
+	double alpha;
+	double beta;
+	bidiagStart(in, NULL, b, u, v, NULL, &alpha, &beta);
+
+	for (int c = 0; c < n; c++) {
+		x[c] = 0;
+		h[c] = v[c];
+		hbar[c] = 0;
+	}
+
+	double bnorm = beta;
+	double zetabar = alpha*beta;
+	double alphabar = alpha;
+	double rho = 1;
+	double rhobar = 1;
+	double cbar = 1;
+	double sbar = 0;
+	double anorm2 = alpha*alpha;
+
+	//quantities to estimate ||r||
+	double betadd = beta;
+	double betad = 0;
+	double rhodold = 1;
+	double tautildeold = 0;
+	double thetatilde = 0;
+	double zeta = 0;
+	double d = 0;
+
+	for (int iter = 0; iter < maxIter && alpha*beta > 0; iter++) {
+
+		bidiagStep(in, NULL, u, v, tmp, NULL, &alpha, &beta);
+
+		//rotation P
+		double rhoold = rho;
+		rho = hypot(alphabar, beta);
+		double c = alphabar/rho;
+		double s = beta/rho;
+		double thetanew = s*alpha;
+		alphabar = c*alpha;
+
+		//rotation Pbar
+		double rhobarold = rhobar;
+		double zetaold = zeta;
+		double thetabar = sbar*rho;
+		rhobar = hypot(cbar*rho, thetanew);
+		cbar = cbar*rho/rhobar;
+		sbar = thetanew/rhobar;
+		zeta = cbar*zetabar;
+		zetabar = -sbar*zetabar;
+
+		//updating hbar, x and h in the same pass
+		double xnorm = 0;
+		for (int k = 0; k < n; k++) {
+			hbar[k] = h[k] - (thetabar*rho/(rhoold*rhobarold))*hbar[k];
+			x[k] += (zeta/(rho*rhobar))*hbar[k];
+			h[k] = v[k] - (thetanew/rho)*h[k];
+			xnorm += x[k]*x[k];
+		}
+		xnorm = sqrt(xnorm);
+
+		//estimate of ||r||, without damping the rotation Qhat is the identity
+		double betaacute = betadd;
+		double betacheck = 0;
+		double betahat = c*betaacute;
+		betadd = -s*betaacute;
+		double thetatildeold = thetatilde;
+		double rhotildeold = hypot(rhodold, thetabar);
+		double ctildeold = rhodold/rhotildeold;
+		double stildeold = thetabar/rhotildeold;
+		thetatilde = stildeold*rhobar;
+		rhodold = ctildeold*rhobar;
+		betad = -stildeold*betad + ctildeold*betahat;
+		tautildeold = (zetaold - thetatildeold*tautildeold)/rhotildeold;
+		double taud = (zeta - thetatilde*tautildeold)/rhodold;
+		d += betacheck*betacheck;
+		double rnorm = sqrt(d + (betad-taud)*(betad-taud) + betadd*betadd);
+
+		//estimate of ||A||
+		anorm2 += beta*beta;
+		double anorm = sqrt(anorm2);
+		anorm2 += alpha*alpha;
+
+		//|zetabar| is ||A'*r||
+		if (rnorm <= tol*bnorm + tol*anorm*xnorm || fabs(zetabar) <= tol*anorm*rnorm) {
+			break;
+		}
+	}
+
+	free(u);
+	free(v);
+	free(h);
+	free(hbar);
+	free(tmp);
+
+	return 1;
+}
+
+/**
+ * @brief Product of a sparse matrix (or its transpose) by a dense matrix, by rows of the result over tiles of
+ * DENSE_TILE columns
+ *
+ * @param out Pointer to the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param x Pointer to the dense matrix, by rows
+ * @param k Number of columns of the dense matrix
+ * @param transposed If not 0 the transpose of the sparse matrix is used
+ *
+ * @return 0 if errors occurred
+ */
+static int denseProduct(double* out, const elem_t* in, const double* x, const int k, const int transposed) {
+
+	//check
+	if (out == NULL || in == NULL || x == NULL || k < 1) {
+		return 0;
+	}
+
+	int rows = transposed ? in->j : in->i;
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, transposed, &ptr, &perm)) {
+		return 0;
+	}
+
+	//rows of the result (in parallel), then tiles of columns over the elements of the row
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int r = 0; r < rows; r++) {
+		double* dst = out+(long) r*k;
+		for (int c0 = 0; c0 < k; c0 += DENSE_TILE) {
+			int c1 = c0+DENSE_TILE < k ? c0+DENSE_TILE : k;
+			for (int c = c0; c < c1; c++) {
+				dst[c] = 0;
+			}
+			for (int p = ptr[r]; p < ptr[r+1]; p++) {
+				elem_t curr = *(in+perm[p]+1);
+				const double* src = x+(long) (transposed ? curr.i : curr.j)*k;
+				for (int c = c0; c < c1; c++) {
+					dst[c] += curr.value*src[c];
+				}
+			}
+		}
+	}
+
+	free(ptr);
+	free(perm);
+
+	return 1;
+}
+
+/**
+ * @brief Multiplies the sparse matrix pointed by in by a dense matrix of k columns and stores the result in the dense matrix pointed by out
+ *
+ * Rows of the result are computed in parallel with OpenMP, each one over tiles of DENSE_TILE columns.
+ *
+ * @param out Pointer to the in->i*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param x Pointer to the in->j*k elements of the dense matrix, by rows
+ * @param k Number of columns of the dense matrix
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_Dense(double* out, const elem_t* in, const double* x, const int k) {
+	return denseProduct(out, in, x, k, 0);
+}
+
+/**
+ * @brief Multiplies the transpose of the sparse matrix pointed by in by a dense matrix of k columns and stores the result in the dense matrix pointed by out
+ *
+ * The elements are grouped by column, so the rows of the result are computed in parallel as in multiplySparse_Dense.
+ *
+ * @param out Pointer to the in->j*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param x Pointer to the in->i*k elements of the dense matrix, by rows
+ * @param k Number of columns of the dense matrix
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_DenseT(double* out, const elem_t* in, const double* x, const int k) {
+	return denseProduct(out, in, x, k, 1);
+}
+
+/**
+ * @brief Orthonormalizes the columns of a dense matrix with classical Gram-Schmidt applied twice, in place, and
+ * optionally stores the factor R of a = Q*R
+ *
+ * The projections of a column on all the previous ones are computed in one pass over the rows, so the matrix is
+ * read by rows and the passes are parallel over the rows with OpenMP. Columns depending on the previous ones
+ * become zero.
+ *
+ * @param a Pointer to the rows*cols elements of the matrix, by rows
+ * @param r Pointer to cols*cols elements where the upper triangular factor is stored, by rows (can be NULL)
+ * @param rows Number of rows of the matrix
+ * @param cols Number of columns of the matrix
+ *
+ * @return 0 if errors occurred
+ */
+static int orthoDense(double* a, double* r, const int rows, const int cols) {
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	double* partial = malloc((long) threads*(cols > 0 ? cols : 1)*sizeof(double));
+	double* dot = malloc((cols > 0 ? cols : 1)*sizeof(double));
+	if (partial == NULL || dot == NULL) {
+		free(partial);
+		free(dot);
+		return 0;
+	}
+
+	for (long p = 0; r != NULL && p < (long) cols*cols; p++) {
+		r[p] = 0;
+	}
+
+	for (int c = 0; c < cols; c++) {
+
+		double original = 0;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) reduction(+:original)
+#endif
+		for (int row = 0; row < rows; row++) {
+			original += a[(long) row*cols+c]*a[(long) row*cols+c];
+		}
+
+		for (int pass = 0; c > 0 && pass < 2; pass++) {
+			for (long p = 0; p < (long) threads*cols; p++) {
+				partial[p] = 0;
+			}
+#ifdef _OPENMP
+			#pragma omp parallel for schedule(static)
+#endif
+			for (int row = 0; row < rows; row++) {
+				int t = 0;
+#ifdef _OPENMP
+				t = omp_get_thread_num();
+#endif
+				const double* arow = a+(long) row*cols;
+				double* tpartial = partial+(long) t*cols;
+				for (int p = 0; p < c; p++) {
+					tpartial[p] += arow[p]*arow[c];
+				}
+			}
+			for (int p = 0; p < c; p++) {
+				dot[p] = 0;
+				for (int t = 0; t < threads; t++) {
+					dot[p] += partial[(long) t*cols+p];
+				}
+				if (r != NULL) {
+					r[(long) p*cols+c] += dot[p];
+				}
+			}
+#ifdef _OPENMP
+			#pragma omp parallel for schedule(static)
+#endif
+			for (int row = 0; row < rows; row++) {
+				double* arow = a+(long) row*cols;
+				double sum = 0;
+				for (int p = 0; p < c; p++) {
+					sum += dot[p]*arow[p];
+				}
+				arow[c] -= sum;
+			}
+		}
+
+		double norm = 0;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static) reduction(+:norm)
+#endif
+		for (int row = 0; row < rows; row++) {
+			norm += a[(long) row*cols+c]*a[(long) row*cols+c];
+		}
+		norm = sqrt(norm);
+		int kept = norm > 1e-12*sqrt(original);
+		if (r != NULL) {
+			r[(long) c*cols+c] = kept ? norm : 0;
+		}
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for (int row = 0; row < rows; row++) {
+			a[(long) row*cols+c] = kept ? a[(long) row*cols+c]/norm : 0;
+		}
+	}
+
+	free(partial);
+	free(dot);
+
+	return 1;
+}
+
+/**
+ * @brief Hashed rows and signs of the nonzeros of column index of a sparse sign (or CountSketch) matrix, so the
+ * sketch is never stored and the same seed always gives the same matrix
+ *
+ * The rows of a column are distinct, a row already taken is drawn again, so two nonzeros never fall together.
+ *
+ * @param seed Seed of the sketch
+ * @param index Column of the sketch matrix (row of the sketched matrix)
+ * @param density Number of nonzeros of the column (at most rows)
+ * @param rows Number of rows of the sketch matrix
+ * @param row Pointer to density elements where the rows of the nonzeros are stored
+ * @param sign Pointer to density elements where the signs of the nonzeros are stored (+1 or -1)
+ */
+static void sketchColumn(const uint64_t seed, const long index, const int density, const int rows, int* row, double* sign) {
+
+	uint64_t state = seed ^ ((uint64_t) index*0xD1B54A32D192ED03ULL);
+
+	for (int d = 0; d < density; d++) {
+		int taken = 1;
+		while (taken) {
+			row[d] = (int) (randomUniform(&state)*rows);
+			if (row[d] >= rows) {
+				row[d] = rows-1;
+			}
+			taken = 0;
+			for (int e = 0; e < d; e++) {
+				if (row[e] == row[d]) {
+					taken = 1;
+				}
+			}
+		}
+		sign[d] = randomUniform(&state) < 0.5 ? -1 : 1;
+	}
+}
+
+/**
+ * @brief Truncated singular value decomposition A ~ U*S*V' of the sparse matrix pointed by in with the randomized
+ * range finder: the range of A is sampled with a sparse sign sketch of k+oversample columns, refined with
+ * power iterations, and the small projected matrix is decomposed with one-sided Jacobi
+ *
+ * The n x l transpose of the projected matrix is first factorized with Gram-Schmidt, so the Jacobi sweeps only run
+ * on its l x l triangular factor, where l = k+oversample. The products by A and A' are parallel with OpenMP.
+ *
+ * @param u Pointer to the in->i*k elements of the left singular vectors, by rows
+ * @param s Pointer to the k singular values, in decreasing order
+ * @param v Pointer to the in->j*k elements of the right singular vectors, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param k Number of singular triplets
+ * @param oversample Number of additional random vectors (usually 5-10)
+ * @param power Number of power iterations (usually 1-3)
+ * @param seed Seed of the random generator
+ *
+ * @return 0 if errors occurred
+ */
+int svdSparse(double* u, double* s, double* v, const elem_t* in, const int k, const int oversample, const int power, const unsigned long seed) {
+
+	int m = in != NULL ? in->i : 0;
+	int n = in != NULL ? in->j : 0;
+	int l = k + (oversample > 0 ? oversample : 0);
+	if (l > m) {
+		l = m;
+	}
+	if (l > n) {
+		l = n;
+	}
+
+	//check
+	if (u == NULL || s == NULL || v == NULL || in == NULL || k < 1 || k > l) {
+		return 0;
+	}
+
+	double* q = malloc((long) m*l*sizeof(double));
+	double* z = malloc((long) n*l*sizeof(double));
+	double* rz = malloc((long) l*l*sizeof(double));
+	double* w = calloc((long) l*l, sizeof(double));
+	double* sigma = malloc(l*sizeof(double));
+	int* order = malloc(l*sizeof(int));
+	if (q == NULL || z == NULL || rz == NULL || w == NULL || sigma == NULL || order == NULL) {
+		free(q);
+		free(z);
+		free(rz);
+		free(w);
+		free(sigma);
+		free(order);
+		return 0;
+	}
+
+	//product by a sparse sign test matrix with SKETCH_DENSITY nonzeros per row, never stored
+	int density = SKETCH_DENSITY < l ? SKETCH_DENSITY : l;
+	for (long c = 0; c < (long) m*l; c++) {
+		q[c] = 0;
+	}
+	for (int e = 0; e < (int) in->value; e++) {
+		elem_t curr = *(in+e+1);
+		int col[SKETCH_DENSITY];
+		double sign[SKETCH_DENSITY];
+		sketchColumn(seed, curr.j, density, l, col, sign);
+		for (int d = 0; d < density; d++) {
+			q[(long) curr.i*l+col[d]] += sign[d]*curr.value;
+		}
+	}
+
+	//range of A, refined with power iterations
+	int ok = orthoDense(q, NULL, m, l);
+	for (int p = 0; ok && p < power; p++) {
+		ok = multiplySparse_DenseT(z, in, q, l) && orthoDense(z, NULL, n, l) && multiplySparse_Dense(q, in, z, l)
+				&& orthoDense(q, NULL, m, l);
+	}
+
+	//z = A'*Q is the transpose of the projected matrix, factorized as Qz*Rz so that only the l x l factor Rz is
+	//decomposed: its columns are made orthogonal with rotations kept in w
+	ok = ok && multiplySparse_DenseT(z, in, q, l) && orthoDense(z, rz, n, l);
+	for (int c = 0; c < l; c++) {
+		w[c*l+c] = 1;
+	}
+	for (int sweep = 0; ok && sweep < 60; sweep++) {
+		int rotated = 0;
+		for (int a = 0; a < l-1; a++) {
+			for (int b = a+1; b < l; b++) {
+				double alpha = 0;
+				double beta = 0;
+				double gamma = 0;
+				for (int r = 0; r < l; r++) {
+					alpha += rz[r*l+a]*rz[r*l+a];
+					beta += rz[r*l+b]*rz[r*l+b];
+					gamma += rz[r*l+a]*rz[r*l+b];
+				}
+				if (fabs(gamma) <= 1e-15*sqrt(alpha*beta)) {
+					continue;
+				}
+				rotated = 1;
+
+				double zeta = (beta-alpha)/(2*gamma);
+				double t = (zeta >= 0 ? 1 : -1)/(fabs(zeta) + sqrt(1+zeta*zeta));
+				double c = 1/sqrt(1+t*t);
+				double sn = c*t;
+				for (int r = 0; r < l; r++) {
+					double za = rz[r*l+a];
+					double zb = rz[r*l+b];
+					rz[r*l+a] = c*za - sn*zb;
+					rz[r*l+b] = sn*za + c*zb;
+					double wa = w[r*l+a];
+					double wb = w[r*l+b];
+					w[r*l+a] = c*wa - sn*wb;
+					w[r*l+b] = sn*wa + c*wb;
+				}
+			}
+		}
+		if (!rotated) {
+			break;
+		}
+	}
+
+	//singular values are the norms of the columns, sorted in decreasing order
+	for (int c = 0; c < l; c++) {
+		sigma[c] = 0;
+		for (int r = 0; r < l; r++) {
+			sigma[c] += rz[r*l+c]*rz[r*l+c];
+		}
+		sigma[c] = sqrt(sigma[c]);
+		order[c] = c;
+	}
+	for (int a = 1; a < l; a++) {
+		int curr = order[a];
+		int b = a;
+		while (b > 0 && sigma[order[b-1]] < sigma[curr]) {
+			order[b] = order[b-1];
+			b--;
+		}
+		order[b] = curr;
+	}
+
+	//U = Q*W and V = Qz times the columns of Rz scaled by the singular values
+	for (int c = 0; ok && c < k; c++) {
+		int o = order[c];
+		s[c] = sigma[o];
+	}
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for (int r = 0; r < m; r++) {
+			for (int c = 0; c < k; c++) {
+				double sum = 0;
+				for (int p = 0; p < l; p++) {
+					sum += q[(long) r*l+p]*w[p*l+order[c]];
+				}
+				u[(long) r*k+c] = sum;
+			}
+		}
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for (int r = 0; r < n; r++) {
+			for (int c = 0; c < k; c++) {
+				int o = order[c];
+				double sum = 0;
+				for (int p = 0; p < l; p++) {
+					sum += z[(long) r*l+p]*rz[p*l+o];
+				}
+				v[(long) r*k+c] = sigma[o] > 0 ? sum/sigma[o] : 0;
+			}
+		}
+	}
+
+	free(q);
+	free(z);
+	free(rz);
+	free(w);
+	free(sigma);
+	free(order);
+
+	return ok;
+}
+
+/**
+ * @brief Nonzeros of the sketch matrix grouped by row, so each row of a sketched product is accumulated on its own
+ *
+ * @param seed Seed of the sketch
+ * @param m Number of columns of the sketch matrix
+ * @param rows Number of rows of the sketch matrix
+ * @param density Number of nonzeros of each column (at most rows)
+ * @param ptr Where to store the offsets of the rows (rows+1 elements, to release)
+ * @param src Where to store the column of each nonzero (m*density elements, to release)
+ * @param sign Where to store the sign of each nonzero (m*density elements, to release)
+ *
+ * @return 0 if errors occurred
+ */
+static int sketchBuckets(const uint64_t seed, const int m, const int rows, const int density, int** ptr, int** src, double** sign) {
+
+	long len = (long) m*density;
+
+	int* hrow = malloc((len > 0 ? len : 1)*sizeof(int));
+	double* hsign = malloc((len > 0 ? len : 1)*sizeof(double));
+	*ptr = calloc(rows+1, sizeof(int));
+	*src = malloc((len > 0 ? len : 1)*sizeof(int));
+	*sign = malloc((len > 0 ? len : 1)*sizeof(double));
+	if (hrow == NULL || hsign == NULL || *ptr == NULL || *src == NULL || *sign == NULL) {
+		free(hrow);
+		free(hsign);
+		free(*ptr);
+		free(*src);
+		free(*sign);
+		return 0;
+	}
+
+	//hashing the columns
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+#endif
+	for (int i = 0; i < m; i++) {
+		sketchColumn(seed, i, density, rows, hrow+(long) i*density, hsign+(long) i*density);
+	}
+
+	//counting sort by row, the columns stay in order
+	for (long p = 0; p < len; p++) {
+		(*ptr)[hrow[p]+1]++;
+	}
+	for (int r = 0; r < rows; r++) {
+		(*ptr)[r+1] += (*ptr)[r];
+	}
+	for (long p = 0; p < len; p++) {
+		int q = (*ptr)[hrow[p]];
+		(*src)[q] = (int) (p/density);
+		(*sign)[q] = hsign[p];
+		(*ptr)[hrow[p]]++;
+	}
+	for (int r = rows; r > 0; r--) {
+		(*ptr)[r] = (*ptr)[r-1];
+	}
+	(*ptr)[0] = 0;
+
+	free(hrow);
+	free(hsign);
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the product S*A, where S is a random sparse sign matrix with
+ * density nonzeros (+-1/sqrt(density)) per column (a CountSketch with density 1) that is generated by hashing and never stored
+ *
+ * The nonzeros of S are grouped by row and each row of S*A accumulates its rows of A (in parallel with OpenMP).
+ *
+ * @param out Pointer to the first element of the result sparse matrix (rows x in->j), out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the sparse matrix to sketch
+ * @param rows Number of rows of the sketch
+ * @param density Number of nonzeros of each column of S (at most rows)
+ * @param seed Seed of the sketch, the same seed gives the same S
+ *
+ * @return 0 if errors occurred
+ */
+int sketchSparse(elem_t* out, const elem_t* in, const int rows, const int density, const unsigned long seed) {
+
+	//check
+	if (out == NULL || in == NULL || rows < 1 || density < 1 || density > rows) {
+		return 0;
+	}
+
+	int n = in->j;
+	int size = (int) out->value;
+	double scale = 1/sqrt(density);
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int* sptr = NULL;
+	int* src = NULL;
+	double* sign = NULL;
+	long* rowoff = calloc(rows+1, sizeof(long));
+	int* mark = malloc((long) threads*(n > 0 ? n : 1)*sizeof(int));
+	double* acc = malloc((long) threads*(n > 0 ? n : 1)*sizeof(double));
+	elem_t* buf = NULL;
+	int ok = (rowoff != NULL && mark != NULL && acc != NULL && sketchBuckets(seed, in->i, rows, density, &sptr, &src, &sign));
+
+	for (long c = 0; ok && c < (long) threads*n; c++) {
+		mark[c] = -1;
+	}
+
+	//number of columns of each row of S*A
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int r = 0; r < rows; r++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			int* tmark = mark + (long) t*n;
+			long len = 0;
+			for (int q = sptr[r]; q < sptr[r+1]; q++) {
+				for (int p = ptr[src[q]]; p < ptr[src[q]+1]; p++) {
+					int c = (in+perm[p]+1)->j;
+					if (tmark[c] != r) {
+						tmark[c] = r;
+						len++;
+					}
+				}
+			}
+			rowoff[r+1] = len;
+		}
+		for (int r = 0; r < rows; r++) {
+			rowoff[r+1] += rowoff[r];
+		}
+		buf = malloc((2*rowoff[rows] > 0 ? 2*rowoff[rows] : 1)*sizeof(elem_t));
+		ok = (buf != NULL);
+	}
+
+	for (long c = 0; ok && c < (long) threads*n; c++) {
+		mark[c] = -1;
+	}
+
+	//each row accumulates its rows of A, sorted by column in its own segment
+	if (ok) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int r = 0; r < rows; r++) {
+			int t = 0;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+#endif
+			int* tmark = mark + (long) t*n;
+			double* tacc = acc + (long) t*n;
+			elem_t* row = buf + rowoff[r];
+			int len = 0;
+			for (int q = sptr[r]; q < sptr[r+1]; q++) {
+				for (int p = ptr[src[q]]; p < ptr[src[q]+1]; p++) {
+					elem_t curr = *(in+perm[p]+1);
+					if (tmark[curr.j] != r) {
+						tmark[curr.j] = r;
+						tacc[curr.j] = 0;
+						row[len].i = r;
+						row[len].j = curr.j;
+						len++;
+					}
+					tacc[curr.j] += sign[q]*scale*curr.value;
+				}
+			}
+			for (int p = 0; p < len; p++) {
+				row[p].value = tacc[row[p].j];
+			}
+			radixSortElem(row, buf + rowoff[rows] + rowoff[r], len, r, n);
+		}
+	}
+
+	//elements in order, without the ones cancelled
+	int nout_new = 0;
+	for (long k = 0; ok && k < rowoff[rows]; k++) {
+		if (buf[k].value == 0) {
+			continue;
+		}
+		if (nout_new >= size) {
+			ok = 0;
+			break;
+		}
+		*(out+nout_new+1) = buf[k];
+		nout_new++;
+	}
+
+	free(ptr);
+	free(perm);
+	free(sptr);
+	free(src);
+	free(sign);
+	free(rowoff);
+	free(mark);
+	free(acc);
+	free(buf);
+
+	if (!ok) {
+		return 0;
+	}
+
+	out->i = rows;
+	out->j = n;
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the vector pointed by out the product S*v with the same S of sketchSparse (rows in parallel
+ * with OpenMP)
+ *
+ * @param out Pointer to an array of rows elements where the result is stored
+ * @param v Pointer to an array of m elements
+ * @param m Number of elements of v
+ * @param rows Number of rows of the sketch
+ * @param density Number of nonzeros of each column of S (at most rows)
+ * @param seed Seed of the sketch
+ *
+ * @return 0 if errors occurred
+ */
+int sketchSparse_Vector(double* out, const double* v, const int m, const int rows, const int density, const unsigned long seed) {
+
+	//check
+	if (out == NULL || v == NULL || rows < 1 || density < 1 || density > rows) {
+		return 0;
+	}
+
+	double scale = 1/sqrt(density);
+
+	int* sptr;
+	int* src;
+	double* sign;
+	if (!sketchBuckets(seed, m, rows, density, &sptr, &src, &sign)) {
+		return 0;
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+#endif
+	for (int r = 0; r < rows; r++) {
+		double sum = 0;
+		for (int q = sptr[r]; q < sptr[r+1]; q++) {
+			sum += sign[q]*v[src[q]];
+		}
+		out[r] = scale*sum;
+	}
+
+	free(sptr);
+	free(src);
+	free(sign);
+
+	return 1;
+}
+
+/**
+ * @brief Approximately solves min ||A*x-b|| with sketch and solve: min ||S*A*x-S*b|| is solved with qrSparse
+ *
+ * The solution isn't the one of the full problem, its residual is only within a factor (1+eps) of the optimal one,
+ * with eps decreasing as the sketch grows. lsqrSketchSparse uses the same sketch to solve the full problem.
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param rows Number of rows of the sketch (at least in->j, usually a few times more)
+ * @param density Number of nonzeros of each column of S
+ * @param seed Seed of the sketch
+ *
+ * @return 0 if errors occurred
+ */
+int lsqSketchSparse(double* x, const elem_t* in, const double* b, const int rows, const int density, const unsigned long seed) {
+
+	//check
+	if (x == NULL || in == NULL || b == NULL || rows < in->j || density < 1) {
+		return 0;
+	}
+
+	long size = (long) in->value*density;
+	elem_t* sketched = malloc((size+1)*sizeof(elem_t));
+	double* sb = malloc(rows*sizeof(double));
+	if (sketched == NULL || sb == NULL) {
+		free(sketched);
+		free(sb);
+		return 0;
+	}
+	sketched->value = size;
+
+	sparseqr_t qr;
+	int ok = sketchSparse(sketched, in, rows, density, seed) && sketchSparse_Vector(sb, b, in->i, rows, density, seed)
+			&& qrSparse(&qr, sketched);
+	if (ok) {
+		ok = qrSolveSparse(x, &qr, sketched, sb);
+		qrFreeSparse(&qr);
+	}
+
+	free(sketched);
+	free(sb);
+
+	return ok;
+}
+
+/**
+ * @brief Solves min ||A*x-b|| with sketch and precondition: R of the QR factorization of S*A (qrSparse) is the right
+ * preconditioner of LSQR, A*R^-1 is well conditioned so few iterations reach the solution of the full problem
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param rows Number of rows of the sketch (at least in->j, usually a few times more)
+ * @param density Number of nonzeros of each column of S
+ * @param seed Seed of the sketch
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests of lsqrSparse (on the preconditioned problem)
+ *
+ * @return 0 if errors occurred (also if S*A is rank deficient)
+ */
+int lsqrSketchSparse(double* x, const elem_t* in, const double* b, const int rows, const int density, const unsigned long seed, const int maxIter, const double tol) {
+
+	//check
+	if (x == NULL || in == NULL || b == NULL || rows < in->j || density < 1) {
+		return 0;
+	}
+
+	long size = (long) in->value*density;
+	elem_t* sketched = malloc((size+1)*sizeof(elem_t));
+	if (sketched == NULL) {
+		return 0;
+	}
+	sketched->value = size;
+
+	sparseqr_t qr;
+	int ok = sketchSparse(sketched, in, rows, density, seed) && qrSparse(&qr, sketched);
+	free(sketched);
+	if (!ok) {
+		return 0;
+	}
+
+	//R must be regular to precondition
+	for (int k = 0; ok && k < qr.n; k++) {
+		ok = 0;
+		for (int p = 0; p < qr.len[k]; p++) {
+			if (qr.cols[k][p] == k && qr.vals[k][p] != 0) {
+				ok = 1;
+			}
+		}
+	}
+
+	ok = ok && lsqrRun(x, in, &qr, b, maxIter, tol);
+	qrFreeSparse(&qr);
+
+	return ok;
+}
+
+/**
+ * @brief Initializes an empty append-only matrix of n columns
+ *
+ * @param stream Pointer to the matrix to initialize, to release with streamFreeSparse
+ * @param n Number of columns
+ * @param aggregates Aggregates to maintain (STREAM_COLSUM, STREAM_SKETCH or both)
+ * @param sketchRows Number of rows of the sketch (used with STREAM_SKETCH)
+ * @param seed Seed of the sketch
+ *
+ * @return 0 if errors occurred
+ */
+int streamInitSparse(stream_t* stream, const int n, const int aggregates, const int sketchRows, const unsigned long seed) {
+
+	//check
+	if (stream == NULL || n < 1 || ((aggregates & STREAM_SKETCH) && sketchRows < 1)) {
+		return 0;
+	}
+
+	stream->m = 0;
+	stream->n = n;
+	stream->nsegments = 0;
+	stream->segments = NULL;
+	stream->first = NULL;
+	stream->aggregates = aggregates;
+	stream->colsum = NULL;
+	stream->sketchRows = sketchRows;
+	stream->seed = seed;
+	stream->sketch = NULL;
+
+	if (aggregates & STREAM_COLSUM) {
+		stream->colsum = calloc(n, sizeof(double));
+		if (stream->colsum == NULL) {
+			return 0;
+		}
+	}
+	if (aggregates & STREAM_SKETCH) {
+		stream->sketch = calloc((long) sketchRows*n, sizeof(double));
+		if (stream->sketch == NULL) {
+			free(stream->colsum);
+			stream->colsum = NULL;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Appends a segment of rows to the matrix, updating the aggregates with the new rows only, and optionally
+ * multiplies the new rows by a vector
+ *
+ * @param y Pointer to an array of rows->i elements where the product of the new rows by x is stored (can be NULL)
+ * @param stream Pointer to the matrix
+ * @param rows Pointer to the first element of the sparse matrix of the new rows (copied)
+ * @param x Pointer to an array of stream->n elements (can be NULL)
+ *
+ * @return 0 if errors occurred (also if an element is outside rows->i x stream->n, the matrix is then unchanged)
+ */
+int streamAppendSparse(double* y, stream_t* stream, const elem_t* rows, const double* x) {
+
+	//check
+	if (stream == NULL || rows == NULL || rows->j != stream->n || rows->i < 0 || rows->value < 0
+			|| rows->i > INT_MAX - stream->m) {
+		return 0;
+	}
+
+	int nnz = (int) rows->value;
+
+	//indexes out of range would update the aggregates outside their arrays
+	for (int k = 0; k < nnz; k++) {
+		elem_t curr = *(rows+k+1);
+		if (curr.i < 0 || curr.i >= rows->i || curr.j < 0 || curr.j >= stream->n) {
+			return 0;
+		}
+	}
+
+	elem_t** segments = realloc(stream->segments, (stream->nsegments+1)*sizeof(elem_t*));
+	if (segments == NULL) {
+		return 0;
+	}
+	stream->segments = segments;
+	int* first = realloc(stream->first, (stream->nsegments+1)*sizeof(int));
+	if (first == NULL) {
+		return 0;
+	}
+	stream->first = first;
+
+	elem_t* segment = malloc((nnz+1)*sizeof(elem_t));
+	if (segment == NULL) {
+		return 0;
+	}
+	for (int k = 0; k < nnz+1; k++) {
+		*(segment+k) = *(rows+k);
+	}
+
+	stream->segments[stream->nsegments] = segment;
+	stream->first[stream->nsegments] = stream->m;
+	stream->nsegments++;
+
+	//aggregates only see the new elements
+	for (int k = 0; k < nnz; k++) {
+		elem_t curr = *(segment+k+1);
+		if (stream->colsum != NULL) {
+			stream->colsum[curr.j] += curr.value;
+		}
+		if (stream->sketch != NULL) {
+			int row;
+			double sign;
+			sketchColumn(stream->seed, (long) stream->m + curr.i, 1, stream->sketchRows, &row, &sign);
+			stream->sketch[(long) row*stream->n+curr.j] += sign*curr.value;
+		}
+	}
+
+	stream->m += rows->i;
+
+	if (y != NULL && x != NULL) {
+		return multiplySparse_Vector(y, segment, x);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Multiplies the whole matrix by a vector
+ *
+ * @param y Pointer to an array of stream->m elements where the result is stored
+ * @param stream Pointer to the matrix
+ * @param x Pointer to an array of stream->n elements
+ *
+ * @return 0 if errors occurred
+ */
+int streamMultiplySparse(double* y, const stream_t* stream, const double* x) {
+
+	//check
+	if (y == NULL || stream == NULL || x == NULL) {
+		return 0;
+	}
+
+	for (int s = 0; s < stream->nsegments; s++) {
+		if (!multiplySparse_Vector(y+stream->first[s], stream->segments[s], x)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Releases the memory of the matrix
+ *
+ * @param stream Pointer to the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int streamFreeSparse(stream_t* stream) {
+
+	//check
+	if (stream == NULL) {
+		return 0;
+	}
+
+	for (int s = 0; s < stream->nsegments; s++) {
+		free(stream->segments[s]);
+	}
+	free(stream->segments);
+	free(stream->first);
+	free(stream->colsum);
+	free(stream->sketch);
+
+	stream->segments = NULL;
+	stream->first = NULL;
+	stream->colsum = NULL;
+	stream->sketch = NULL;
+	stream->nsegments = 0;
+	stream->m = 0;
+
+	return 1;
+}
+
+/**
+ * @brief Initializes an empty result cache
+ *
+ * @param cache Pointer to the cache to initialize, to release with cacheFreeSparse
+ * @param budget Maximum memory (in bytes) of the stored results and their operands, least recently used results are evicted beyond it
+ *
+ * @return 0 if errors occurred
+ */
+int cacheInitSparse(cache_t* cache, const size_t budget) {
+
+	//check
+	if (cache == NULL) {
+		return 0;
+	}
+
+	cache->budget = budget;
+	cache->bytes = 0;
+	cache->nentries = 0;
+	cache->entries = NULL;
+	cache->clock = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+
+	return 1;
+}
+
+/**
+ * @brief Copy of the sparse matrix in canonical form: sorted, duplicates summed and without zeros, so equal
+ * matrixes have the same copy
+ *
+ * @param in Pointer to the first element of the sparse matrix
+ *
+ * @return the copy (to release), NULL if errors occurred
+ */
+static elem_t* canonicalSparse(const elem_t* in) {
+
+	int nnz = (int) in->value;
+	elem_t* copy = malloc((nnz+1)*sizeof(elem_t));
+	if (copy == NULL) {
+		return NULL;
+	}
+	memcpy(copy, in, (nnz+1)*sizeof(elem_t));
+	if (!sortSparse(copy)) {
+		free(copy);
+		return NULL;
+	}
+
+	int len = 0;
+	for (int k = 0; k < nnz;) {
+		elem_t curr = *(copy+k+1);
+		for (k++; k < nnz && (copy+k+1)->i == curr.i && (copy+k+1)->j == curr.j; k++) {
+			curr.value += (copy+k+1)->value;
+		}
+		if (curr.value != 0) {
+			*(copy+len+1) = curr;
+			len++;
+		}
+	}
+	copy->value = len;
+
+	return copy;
+}
+
+/**
+ * @brief Checks if two sparse matrixes in canonical form are identical (bit by bit)
+ *
+ * @param in1 Pointer to the first element of the first sparse matrix
+ * @param in2 Pointer to the first element of the second sparse matrix
+ *
+ * @return 1 if identical
+ */
+static int sameSparse(const elem_t* in1, const elem_t* in2) {
+
+	return in1->i == in2->i && in1->j == in2->j && in1->value == in2->value
+			&& memcmp(in1+1, in2+1, (size_t) in1->value*sizeof(elem_t)) == 0;
+}
+
+/**
+ * @brief Mixes the bits of a 64 bit number (finalizer of splitmix64)
+ *
+ * @param z Number to mix
+ *
+ * @return the mixed number
+ */
+static uint64_t mixHash(uint64_t z) {
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+/**
+ * @brief Hash of a sparse matrix in canonical form, chaining the elements in their (sorted) order so that moving a
+ * value to another position changes the hash
+ *
+ * The elements are split in HASH_STRIPES stripes, chained in parallel with OpenMP, and the hashes of the stripes
+ * are then chained in order. The stripes only depend on the number of elements, so the hash doesn't depend on the
+ * number of threads.
+ *
+ * @param in Pointer to the first element of the sparse matrix in canonical form
+ *
+ * @return the hash
+ */
+static uint64_t hashCanonical(const elem_t* in) {
+
+	int nnz = (int) in->value;
+	uint64_t stripes[HASH_STRIPES];
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static, 1) if (nnz >= 8*HASH_STRIPES*HASH_STRIPES)
+#endif
+	for (int s = 0; s < HASH_STRIPES; s++) {
+		uint64_t hash = mixHash((uint64_t) s + 0x9E3779B97F4A7C15ULL);
+		int lo = (int) ((long) nnz*s/HASH_STRIPES);
+		int hi = (int) ((long) nnz*(s+1)/HASH_STRIPES);
+		for (int k = lo; k < hi; k++) {
+			elem_t curr = *(in+k+1);
+			uint64_t bits;
+			memcpy(&bits, &curr.value, sizeof(bits));
+			hash = mixHash((hash ^ (((uint64_t) (uint32_t) curr.i << 32) | (uint32_t) curr.j)) + 0x9E3779B97F4A7C15ULL);
+			hash = mixHash((hash ^ bits) + 0x9E3779B97F4A7C15ULL);
+		}
+		stripes[s] = hash;
+	}
+
+	uint64_t hash = mixHash(((uint64_t) (uint32_t) in->i << 32) | (uint32_t) in->j);
+	for (int s = 0; s < HASH_STRIPES; s++) {
+		hash = mixHash((hash ^ stripes[s]) + 0x9E3779B97F4A7C15ULL);
+	}
+
+	return mixHash(hash ^ (uint64_t) nnz);
+}
+
+/**
+ * @brief Looks for a result in the cache and copies it in out, a result is found only if the hashes match and
+ * the stored operands are identical to the passed ones
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param cache Pointer to the cache
+ * @param op Operation
+ * @param key1 Hash of the first operand
+ * @param key2 Hash of the second operand
+ * @param operand1 Pointer to the first operand in canonical form
+ * @param operand2 Pointer to the second operand in canonical form (NULL if unused)
+ *
+ * @return 1 if found and copied, 0 if not found, -1 if found but out is too small
+ */
+static int cacheLookup(elem_t* out, cache_t* cache, const int op, const uint64_t key1, const uint64_t key2, const elem_t* operand1, const elem_t* operand2) {
+
+	for (int e = 0; e < cache->nentries; e++) {
+		struct cacheentry* entry = cache->entries+e;
+		if (entry->op != op || entry->key1 != key1 || entry->key2 != key2) {
+			continue;
+		}
+
+		//a hash collision must not return the result of other operands
+		if (!sameSparse(entry->operand1, operand1) || (operand2 != NULL && !sameSparse(entry->operand2, operand2))) {
+			continue;
+		}
+
+		if (entry->result->value > out->value) {
+			return -1;
+		}
+		for (int k = 0; k < (int) entry->result->value+1; k++) {
+			*(out+k) = *(entry->result+k);
+		}
+		cache->clock++;
+		entry->used = cache->clock;
+		cache->hits++;
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Stores a copy of a result in the cache with its operands, evicting the least recently used results beyond
+ * the budget
+ *
+ * A result bigger than the budget (with its operands) isn't stored.
+ *
+ * @param cache Pointer to the cache
+ * @param op Operation
+ * @param key1 Hash of the first operand
+ * @param key2 Hash of the second operand
+ * @param operand1 Pointer to the first operand in canonical form, owned by the cache from now on
+ * @param operand2 Pointer to the second operand in canonical form (NULL if unused), owned by the cache from now on
+ * @param result Pointer to the first element of the result sparse matrix
+ */
+static void cacheStore(cache_t* cache, const int op, const uint64_t key1, const uint64_t key2, elem_t* operand1, elem_t* operand2, const elem_t* result) {
+
+	size_t bytes = ((size_t) result->value + 1)*sizeof(elem_t) + ((size_t) operand1->value + 1)*sizeof(elem_t)
+			+ (operand2 != NULL ? ((size_t) operand2->value + 1)*sizeof(elem_t) : 0);
+	if (bytes > cache->budget) {
+		free(operand1);
+		free(operand2);
+		return;
+	}
+
+	while (cache->bytes + bytes > cache->budget && cache->nentries > 0) {
+		int lru = 0;
+		for (int e = 1; e < cache->nentries; e++) {
+			if (cache->entries[e].used < cache->entries[lru].used) {
+				lru = e;
+			}
+		}
+		cache->bytes -= cache->entries[lru].bytes;
+		free(cache->entries[lru].result);
+		free(cache->entries[lru].operand1);
+		free(cache->entries[lru].operand2);
+		cache->entries[lru] = cache->entries[cache->nentries-1];
+		cache->nentries--;
+	}
+
+	struct cacheentry* entries = realloc(cache->entries, (cache->nentries+1)*sizeof(struct cacheentry));
+	elem_t* copy = malloc(((size_t) result->value + 1)*sizeof(elem_t));
+	if (entries != NULL) {
+		cache->entries = entries;
+	}
+	if (entries == NULL || copy == NULL) {
+		free(copy);
+		free(operand1);
+		free(operand2);
+		return;
+	}
+	for (int k = 0; k < (int) result->value+1; k++) {
+		*(copy+k) = *(result+k);
+	}
+
+	struct cacheentry* entry = cache->entries+cache->nentries;
+	entry->op = op;
+	entry->key1 = key1;
+	entry->key2 = key2;
+	entry->operand1 = operand1;
+	entry->operand2 = operand2;
+	entry->result = copy;
+	entry->bytes = bytes;
+	cache->clock++;
+	entry->used = cache->clock;
+	cache->nentries++;
+	cache->bytes += bytes;
+}
+
+/**
+ * @brief Multiplies two sparse matrixes as multiplySparse_ESC does, reusing the result stored in the cache
+ * if the same operands were already multiplied
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param cache Pointer to the cache
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ *
+ * @return 0 if errors occurred
+ */
+int cacheMultiplySparse(elem_t* out, cache_t* cache, const elem_t* in1, const elem_t* in2) {
+
+	//check
+	if (out == NULL || cache == NULL || in1 == NULL || in2 == NULL) {
+		return 0;
+	}
+
+	elem_t* operand1 = canonicalSparse(in1);
+	elem_t* operand2 = canonicalSparse(in2);
+	if (operand1 == NULL || operand2 == NULL) {
+		free(operand1);
+		free(operand2);
+		return 0;
+	}
+	uint64_t key1 = hashCanonical(operand1);
+	uint64_t key2 = hashCanonical(operand2);
+
+	int found = cacheLookup(out, cache, CACHE_MULTIPLY, key1, key2, operand1, operand2);
+	if (found != 0 || !multiplySparse_ESC(out, in1, in2)) {
+		free(operand1);
+		free(operand2);
+		return found > 0;
+	}
+	cache->misses++;
+	cacheStore(cache, CACHE_MULTIPLY, key1, key2, operand1, operand2, out);
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the transpose of the sparse matrix pointed by in, sorted,
+ * reusing the result stored in the cache if the same matrix was already transposed
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param cache Pointer to the cache
+ * @param in Pointer to the first element of the sparse matrix to transpose
+ *
+ * @return 0 if errors occurred
+ */
+int cacheTransposeSparse(elem_t* out, cache_t* cache, const elem_t* in) {
+
+	//check
+	if (out == NULL || cache == NULL || in == NULL || in->value > out->value) {
+		return 0;
+	}
+
+	elem_t* operand = canonicalSparse(in);
+	if (operand == NULL) {
+		return 0;
+	}
+	uint64_t key = hashCanonical(operand);
+
+	int found = cacheLookup(out, cache, CACHE_TRANSPOSE, key, 0, operand, NULL);
+	if (found != 0) {
+		free(operand);
+		return found > 0;
+	}
+
+	for (int k = 0; k < (int) in->value+1; k++) {
+		*(out+k) = *(in+k);
+	}
+	if (!transposeSparse(out) || !sortSparse(out)) {
+		free(operand);
+		return 0;
+	}
+	cache->misses++;
+	cacheStore(cache, CACHE_TRANSPOSE, key, 0, operand, NULL, out);
+
+	return 1;
+}
+
+/**
+ * @brief Releases the memory of the cache
+ *
+ * @param cache Pointer to the cache
+ *
+ * @return 0 if errors occurred
+ */
+int cacheFreeSparse(cache_t* cache) {
+
+	//check
+	if (cache == NULL) {
+		return 0;
+	}
+
+	for (int e = 0; e < cache->nentries; e++) {
+		free(cache->entries[e].result);
+		free(cache->entries[e].operand1);
+		free(cache->entries[e].operand2);
+	}
+	free(cache->entries);
+
+	cache->entries = NULL;
+	cache->nentries = 0;
+	cache->bytes = 0;
+
+	return 1;
+}
+
+/**
+ * @brief Computes a hash of the sparse matrix that depends on the position of each value but not on the order in
+ * which the elements are stored: the elements are sorted (duplicates summed, zeros dropped) and chained in that order
+ *
+ * The sort and the chaining of the elements are parallel with OpenMP for large matrixes.
+ *
+ * @param hash Where to store the hash
+ * @param in Pointer to the first element of the sparse matrix
+ *
+ * @return 0 if errors occurred
+ */
+int hashSparse(uint64_t* hash, const elem_t* in) {
+
+	//check
+	if (hash == NULL || in == NULL) {
+		return 0;
+	}
+
+	elem_t* canonical = canonicalSparse(in);
+	if (canonical == NULL) {
+		return 0;
+	}
+	*hash = hashCanonical(canonical);
+	free(canonical);
+
+	return 1;
+}
+
+/**
+ * @brief Checks if the elements of the sparse matrix are sorted by row and column without duplicates (in parallel
+ * with OpenMP)
+ *
+ * @param in Pointer to the first element of the sparse matrix
+ *
+ * @return 1 if sorted
+ */
+static int isSortedSparse(const elem_t* in) {
+
+	int nnz = (int) in->value;
+
+	int unsorted = 0;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) reduction(max:unsorted) if (nnz >= SORT_CHUNK)
+#endif
+	for (int k = 1; k < nnz; k++) {
+		elem_t prev = *(in+k);
+		elem_t curr = *(in+k+1);
+		if (prev.i > curr.i || (prev.i == curr.i && prev.j >= curr.j)) {
+			unsorted = 1;
+		}
+	}
+
+	return !unsorted;
+}
+
+/**
+ * @brief Checks if two sparse matrixes have the same dimensions and the same elements (in any order), up to a tolerance,
+ * stopping at the first difference
+ *
+ * An element present in only one of the matrixes is compared with 0, and NaN is never equal to anything. Sorted
+ * matrixes are merged in one pass, unsorted ones through sorted copies (sorted in parallel for large matrixes).
+ *
+ * @param equal Where to store 1 if the matrixes are equal, 0 otherwise
+ * @param in1 Pointer to the first element of the first sparse matrix
+ * @param in2 Pointer to the first element of the second sparse matrix
+ * @param tol Largest absolute difference between equal elements
+ *
+ * @return 0 if errors occurred
+ */
+int equalSparse(int* equal, const elem_t* in1, const elem_t* in2, const double tol) {
+
+	//check
+	if (equal == NULL || in1 == NULL || in2 == NULL) {
+		return 0;
+	}
+
+	*equal = 0;
+	if (in1->i != in2->i || in1->j != in2->j) {
+		return 1;
+	}
+
+	//unsorted matrixes are compared through sorted copies
+	const elem_t* a = in1;
+	const elem_t* b = in2;
+	elem_t* copy1 = NULL;
+	elem_t* copy2 = NULL;
+	if (!isSortedSparse(in1)) {
+		copy1 = malloc(((int) in1->value+1)*sizeof(elem_t));
+		if (copy1 == NULL) {
+			return 0;
+		}
+		memcpy(copy1, in1, ((int) in1->value+1)*sizeof(elem_t));
+		if (!sortSparse(copy1)) {
+			free(copy1);
+			return 0;
+		}
+		a = copy1;
+	}
+	if (!isSortedSparse(in2)) {
+		copy2 = malloc(((int) in2->value+1)*sizeof(elem_t));
+		if (copy2 == NULL) {
+			free(copy1);
+			return 0;
+		}
+		memcpy(copy2, in2, ((int) in2->value+1)*sizeof(elem_t));
+		if (!sortSparse(copy2)) {
+			free(copy1);
+			free(copy2);
+			return 0;
+		}
+		b = copy2;
+	}
+
+	//merge of the sorted elements, duplicates are summed
+	int na = (int) a->value;
+	int nb = (int) b->value;
+	int ka = 0;
+	int kb = 0;
+	int same = 1;
+	while (same && (ka < na || kb < nb)) {
+		const elem_t* ca = ka < na ? a+ka+1 : NULL;
+		const elem_t* cb = kb < nb ? b+kb+1 : NULL;
+		int i;
+		int j;
+		if (cb == NULL || (ca != NULL && (ca->i < cb->i || (ca->i == cb->i && ca->j <= cb->j)))) {
+			i = ca->i;
+			j = ca->j;
+		} else {
+			i = cb->i;
+			j = cb->j;
+		}
+
+		double va = 0;
+		while (ka < na && (a+ka+1)->i == i && (a+ka+1)->j == j) {
+			va += (a+ka+1)->value;
+			ka++;
+		}
+		double vb = 0;
+		while (kb < nb && (b+kb+1)->i == i && (b+kb+1)->j == j) {
+			vb += (b+kb+1)->value;
+			kb++;
+		}
+
+		//NaN is never within the tolerance
+		if (!(fabs(va - vb) <= tol)) {
+			same = 0;
+		}
+	}
+
+	free(copy1);
+	free(copy2);
+
+	*equal = same;
+
+	return 1;
+}
+
+/* Block of rows shared by copy-on-write matrixes */
+struct sharedblock {
+	atomic_int refs; //number of matrixes using the block
+	int cap; //number of elements allocated for data (first element excluded)
+	elem_t* data; //sparse matrix of the rows of the block (same row indexes of the whole matrix)
+};
+
+/**
+ * @brief Allocates a block of rows with one reference and a copy of the passed elements
+ *
+ * @param m Number of rows of the whole matrix
+ * @param n Number of columns of the whole matrix
+ * @param elems Pointer to the elements to copy
+ * @param len Number of elements to copy
+ * @param cap Number of elements to allocate (at least len)
+ *
+ * @return the block, NULL if errors occurred
+ */
+static struct sharedblock* newBlock(const int m, const int n, const elem_t* elems, const int len, const int cap) {
+
+	struct sharedblock* block = malloc(sizeof(struct sharedblock));
+	if (block == NULL) {
+		return NULL;
+	}
+	block->data = malloc((cap+1)*sizeof(elem_t));
+	if (block->data == NULL) {
+		free(block);
+		return NULL;
+	}
+
+	atomic_init(&block->refs, 1);
+	block->cap = cap;
+	block->data->i = m;
+	block->data->j = n;
+	block->data->value = len;
+	for (int k = 0; k < len; k++) {
+		*(block->data+k+1) = elems[k];
+	}
+
+	return block;
+}
+
+/**
+ * @brief Drops a reference to a block of rows, freeing it when it was the last one
+ *
+ * @param block Pointer to the block
+ */
+static void releaseBlock(struct sharedblock* block) {
+
+	if (atomic_fetch_sub(&block->refs, 1) == 1) {
+		free(block->data);
+		free(block);
+	}
+}
+
+/**
+ * @brief Builds a copy-on-write matrix from the sparse matrix pointed by in, split in blocks of rows
+ *
+ * @param out Pointer to the matrix to build, to release with shareFreeSparse
+ * @param in Pointer to the first element of the sparse matrix (copied)
+ * @param blockRows Number of rows of each block
+ *
+ * @return 0 if errors occurred
+ */
+int shareCreateSparse(shared_t* out, const elem_t* in, const int blockRows) {
+
+	//check
+	if (out == NULL || in == NULL || blockRows < 1) {
+		return 0;
+	}
+
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	out->m = in->i;
+	out->n = in->j;
+	out->blockRows = blockRows;
+	out->nblocks = (in->i + blockRows - 1)/blockRows;
+	out->blocks = calloc(out->nblocks > 0 ? out->nblocks : 1, sizeof(struct sharedblock*));
+	elem_t* elems = malloc(((int) in->value > 0 ? (int) in->value : 1)*sizeof(elem_t));
+	int ok = (out->blocks != NULL && elems != NULL);
+
+	for (int b = 0; ok && b < out->nblocks; b++) {
+		int first = b*blockRows;
+		int last = first+blockRows < in->i ? first+blockRows : in->i;
+		int len = 0;
+		for (int p = ptr[first]; p < ptr[last]; p++) {
+			elems[len] = *(in+perm[p]+1);
+			len++;
+		}
+		out->blocks[b] = newBlock(in->i, in->j, elems, len, len);
+		ok = (out->blocks[b] != NULL);
+	}
+
+	free(elems);
+	free(ptr);
+	free(perm);
+
+	if (!ok) {
+		shareFreeSparse(out);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Makes a copy of the copy-on-write matrix sharing all its blocks, in time proportional to the number of blocks
+ *
+ * Copies can be used and released by different threads, but a single copy must not be used by two threads at the same time.
+ *
+ * @param out Pointer to the copy, to release with shareFreeSparse
+ * @param in Pointer to the matrix to copy
+ *
+ * @return 0 if errors occurred
+ */
+int shareCopySparse(shared_t* out, const shared_t* in) {
+
+	//check
+	if (out == NULL || in == NULL || in->blocks == NULL) {
+		return 0;
+	}
+
+	out->blocks = malloc((in->nblocks > 0 ? in->nblocks : 1)*sizeof(struct sharedblock*));
+	if (out->blocks == NULL) {
+		return 0;
+	}
+
+	out->m = in->m;
+	out->n = in->n;
+	out->blockRows = in->blockRows;
+	out->nblocks = in->nblocks;
+	for (int b = 0; b < in->nblocks; b++) {
+		atomic_fetch_add(&in->blocks[b]->refs, 1);
+		out->blocks[b] = in->blocks[b];
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Sets the element (i,j) of the copy-on-write matrix, duplicating first its block of rows if it is shared
+ *
+ * @param matrix Pointer to the matrix
+ * @param i Row of the element
+ * @param j Column of the element
+ * @param value New value of the element
+ *
+ * @return 0 if errors occurred
+ */
+int shareSetSparse(shared_t* matrix, const int i, const int j, const double value) {
+
+	//check
+	if (matrix == NULL || matrix->blocks == NULL || i < 0 || i >= matrix->m || j < 0 || j >= matrix->n) {
+		return 0;
+	}
+
+	struct sharedblock* block = matrix->blocks[i/matrix->blockRows];
+	int len = (int) block->data->value;
+
+	//updating an existing element
+	int pos = -1;
+	for (int k = 0; k < len; k++) {
+		if ((block->data+k+1)->i == i && (block->data+k+1)->j == j) {
+			pos = k;
+			break;
+		}
+	}
+
+	//only this matrix can see a block with one reference, otherwise it is duplicated (with room to grow)
+	if (atomic_load(&block->refs) > 1) {
+		struct sharedblock* copy = newBlock(matrix->m, matrix->n, block->data+1, len, len+(len/4)+1);
+		if (copy == NULL) {
+			return 0;
+		}
+		releaseBlock(block);
+		matrix->blocks[i/matrix->blockRows] = copy;
+		block = copy;
+	}
+
+	if (pos < 0 && len == block->cap) {
+		elem_t* grown = realloc(block->data, (2*block->cap+2)*sizeof(elem_t));
+		if (grown == NULL) {
+			return 0;
+		}
+		block->data = grown;
+		block->cap = 2*block->cap+1;
+	}
+
+	if (pos < 0) {
+		pos = len;
+		(block->data+pos+1)->i = i;
+		(block->data+pos+1)->j = j;
+		block->data->value = len+1;
+	}
+	(block->data+pos+1)->value = value;
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the elements of the copy-on-write matrix
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int shareGetSparse(elem_t* out, const shared_t* in) {
+
+	//check
+	if (out == NULL || in == NULL || in->blocks == NULL) {
+		return 0;
+	}
+
+	int size = (int) out->value;
+	int nout_new = 0;
+	for (int b = 0; b < in->nblocks; b++) {
+		const elem_t* data = in->blocks[b]->data;
+		if (nout_new + (int) data->value > size) {
+			return 0;
+		}
+		for (int k = 0; k < (int) data->value; k++) {
+			*(out+nout_new+1) = *(data+k+1);
+			nout_new++;
+		}
+	}
+
+	out->i = in->m;
+	out->j = in->n;
+	out->value = nout_new;
+
+	return 1;
+}
+
+/**
+ * @brief Releases the copy-on-write matrix, blocks are freed when no other copy uses them
+ *
+ * @param matrix Pointer to the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int shareFreeSparse(shared_t* matrix) {
+
+	//check
+	if (matrix == NULL) {
+		return 0;
+	}
+
+	for (int b = 0; matrix->blocks != NULL && b < matrix->nblocks; b++) {
+		if (matrix->blocks[b] != NULL) {
+			releaseBlock(matrix->blocks[b]);
+		}
+	}
+	free(matrix->blocks);
+
+	matrix->blocks = NULL;
+	matrix->nblocks = 0;
+
+	return 1;
+}
+
+/* Value of an assembly target, updated with atomics */
+struct atomicvalue {
+	_Atomic double value;
+};
+
+/**
+ * @brief Builds an assembly target with the pattern of the sparse matrix pointed by pattern, with all values 0
+ *
+ * @param out Pointer to the assembly target to build, to release with assemblyFreeSparse
+ * @param pattern Pointer to the first element of the sparse matrix giving the pattern (values are ignored)
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyInitSparse(assembly_t* out, const elem_t* pattern) {
+
+	//check
+	if (out == NULL || pattern == NULL) {
+		return 0;
+	}
+
+	int m = pattern->i;
+	int nnz = (int) pattern->value;
+
+	//sorted copy of the pattern
+	elem_t* sorted = malloc((2*nnz > 0 ? 2*nnz : 1)*sizeof(elem_t));
+	out->m = m;
+	out->n = pattern->j;
+	out->ptr = calloc(m+1, sizeof(int));
+	out->cols = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+	out->values = malloc((nnz > 0 ? nnz : 1)*sizeof(struct atomicvalue));
+	if (sorted == NULL || out->ptr == NULL || out->cols == NULL || out->values == NULL) {
+		free(sorted);
+		assemblyFreeSparse(out);
+		return 0;
+	}
+
+	for (int k = 0; k < nnz; k++) {
+		sorted[k] = *(pattern+k+1);
+	}
+	radixSortElem(sorted, sorted+nnz, nnz, 0, pattern->j);
+
+	//rows without duplicated columns
+	int len = 0;
+	for (int k = 0; k < nnz; k++) {
+		if (len > 0 && sorted[k].i == sorted[k-1].i && sorted[k].j == sorted[k-1].j) {
+			continue;
+		}
+		out->ptr[sorted[k].i+1]++;
+		out->cols[len] = sorted[k].j;
+		atomic_init(&(out->values+len)->value, 0.0);
+		len++;
+	}
+	for (int r = 0; r < m; r++) {
+		out->ptr[r+1] += out->ptr[r];
+	}
+
+	free(sorted);
+
+	return 1;
+}
+
+/**
+ * @brief Position of the element (i,j) in the assembly target
+ *
+ * @param assembly Pointer to the assembly target
+ * @param i Row of the element
+ * @param j Column of the element
+ *
+ * @return the position, -1 if (i,j) isn't in the pattern
+ */
+static int assemblyFind(const assembly_t* assembly, const int i, const int j) {
+
+	if (i < 0 || i >= assembly->m) {
+		return -1;
+	}
+
+	int lo = assembly->ptr[i];
+	int hi = assembly->ptr[i+1]-1;
+	while (lo <= hi) {
+		int mid = (lo+hi)/2;
+		if (assembly->cols[mid] == j) {
+			return mid;
+		}
+		if (assembly->cols[mid] < j) {
+			lo = mid+1;
+		} else {
+			hi = mid-1;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Adds value to the element (i,j) of the assembly target, found with a binary search in its row and updated
+ * with an atomic compare and swap, so any number of threads can call it at the same time
+ *
+ * @param assembly Pointer to the assembly target
+ * @param i Row of the element
+ * @param j Column of the element
+ * @param value Value to add
+ *
+ * @return 0 if errors occurred (also if (i,j) isn't in the pattern)
+ */
+int assemblyAddSparse(assembly_t* assembly, const int i, const int j, const double value) {
+
+	//check
+	if (assembly == NULL || assembly->values == NULL) {
+		return 0;
+	}
+
+	int pos = assemblyFind(assembly, i, j);
+	if (pos < 0) {
+		return 0;
+	}
+
+	//on failure expected is reloaded with the current value
+	double expected = atomic_load_explicit(&(assembly->values+pos)->value, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak_explicit(&(assembly->values+pos)->value, &expected, expected+value,
+			memory_order_relaxed, memory_order_relaxed)) {
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Sets to 0 all the values of the assembly target, keeping the pattern
+ *
+ * @param assembly Pointer to the assembly target
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyResetSparse(assembly_t* assembly) {
+
+	//check
+	if (assembly == NULL || assembly->values == NULL) {
+		return 0;
+	}
+
+	for (int k = 0; k < assembly->ptr[assembly->m]; k++) {
+		atomic_store_explicit(&(assembly->values+k)->value, 0.0, memory_order_relaxed);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the elements of the assembly target, sorted
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param assembly Pointer to the assembly target
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyGetSparse(elem_t* out, const assembly_t* assembly) {
+
+	//check
+	if (out == NULL || assembly == NULL || assembly->values == NULL || assembly->ptr[assembly->m] > (int) out->value) {
+		return 0;
+	}
+
+	for (int r = 0; r < assembly->m; r++) {
+		for (int p = assembly->ptr[r]; p < assembly->ptr[r+1]; p++) {
+			(out+p+1)->i = r;
+			(out+p+1)->j = assembly->cols[p];
+			(out+p+1)->value = atomic_load_explicit(&(assembly->values+p)->value, memory_order_relaxed);
+		}
+	}
+
+	out->i = assembly->m;
+	out->j = assembly->n;
+	out->value = assembly->ptr[assembly->m];
+
+	return 1;
+}
+
+/**
+ * @brief Releases the memory of the assembly target
+ *
+ * @param assembly Pointer to the assembly target
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyFreeSparse(assembly_t* assembly) {
+
+	//check
+	if (assembly == NULL) {
+		return 0;
+	}
+
+	free(assembly->ptr);
+	free(assembly->cols);
+	free(assembly->values);
+
+	assembly->ptr = NULL;
+	assembly->cols = NULL;
+	assembly->values = NULL;
+
+	return 1;
+}
+
+/**
+ * @brief Colors mesh elements so that no two elements of the same color share a row (greedy, smallest free color)
+ *
+ * Elements of the same color can then be assembled at the same time with assemblyElementSparse without atomics.
+ *
+ * @param color Pointer to an array of nelem elements where the color of each element is stored
+ * @param ncolors Where to store the number of colors
+ * @param elemPtr Pointer to an array of nelem+1 offsets of the rows of each element into elemRows
+ * @param elemRows Pointer to the rows of each element
+ * @param nelem Number of elements
+ * @param m Number of rows of the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int colorElementsSparse(int* color, int* ncolors, const int* elemPtr, const int* elemRows, const int nelem, const int m) {
+
+	//check
+	if (color == NULL || ncolors == NULL || elemPtr == NULL || elemRows == NULL || nelem < 0 || m < 0) {
+		return 0;
+	}
+
+	int len = elemPtr[nelem];
+
+	//elements touching each row
+	int* rowPtr = calloc(m+1, sizeof(int));
+	int* rowElems = malloc((len > 0 ? len : 1)*sizeof(int));
+	int* forbidden = malloc((nelem > 0 ? nelem : 1)*sizeof(int));
+	if (rowPtr == NULL || rowElems == NULL || forbidden == NULL) {
+		free(rowPtr);
+		free(rowElems);
+		free(forbidden);
+		return 0;
+	}
+	for (int p = 0; p < len; p++) {
+		if (elemRows[p] < 0 || elemRows[p] >= m) {
+			free(rowPtr);
+			free(rowElems);
+			free(forbidden);
+			return 0;
+		}
+		rowPtr[elemRows[p]+1]++;
+	}
+	for (int r = 0; r < m; r++) {
+		rowPtr[r+1] += rowPtr[r];
+	}
+	for (int e = 0; e < nelem; e++) {
+		for (int p = elemPtr[e]; p < elemPtr[e+1]; p++) {
+			rowElems[rowPtr[elemRows[p]]++] = e;
+		}
+	}
+	for (int r = m; r > 0; r--) {
+		rowPtr[r] = rowPtr[r-1];
+	}
+	rowPtr[0] = 0;
+
+	*ncolors = 0;
+	for (int e = 0; e < nelem; e++) {
+		forbidden[e] = -1;
+	}
+
+	for (int e = 0; e < nelem; e++) {
+
+		//colors of the already colored elements sharing a row
+		for (int p = elemPtr[e]; p < elemPtr[e+1]; p++) {
+			int r = elemRows[p];
+			for (int q = rowPtr[r]; q < rowPtr[r+1] && rowElems[q] < e; q++) {
+				forbidden[color[rowElems[q]]] = e;
+			}
+		}
+
+		int c = 0;
+		while (forbidden[c] == e) {
+			c++;
+		}
+		color[e] = c;
+		if (c+1 > *ncolors) {
+			*ncolors = c+1;
+		}
+	}
+
+	free(rowPtr);
+	free(rowElems);
+	free(forbidden);
+
+	return 1;
+}
+
+/**
+ * @brief Adds the dense matrix of a mesh element to the assembly target, at the rows and columns listed in rows
+ *
+ * With atomic 0 the values are updated without atomic read-modify-write, which is safe only if no other thread
+ * is updating the same rows at the same time (e.g. elements of the same color of colorElementsSparse).
+ *
+ * @param assembly Pointer to the assembly target
+ * @param rows Pointer to the nrows rows (and columns) of the element
+ * @param nrows Number of rows of the element
+ * @param values Pointer to the nrows*nrows values of the element matrix, by rows
+ * @param atomic If not 0 each value is added with assemblyAddSparse
+ *
+ * @return 0 if errors occurred (also if an element isn't in the pattern)
+ */
+int assemblyElementSparse(assembly_t* assembly, const int* rows, const int nrows, const double* values, const int atomic) {
+
+	//check
+	if (assembly == NULL || assembly->values == NULL || rows == NULL || values == NULL) {
+		return 0;
+	}
+
+	int ok = 1;
+	for (int a = 0; a < nrows; a++) {
+		for (int b = 0; b < nrows; b++) {
+			double value = values[a*nrows+b];
+
+			if (atomic) {
+				ok = assemblyAddSparse(assembly, rows[a], rows[b], value) && ok;
+				continue;
+			}
+
+			//relaxed load and store compile to plain moves
+			int pos = assemblyFind(assembly, rows[a], rows[b]);
+			if (pos < 0) {
+				ok = 0;
+				continue;
+			}
+			double current = atomic_load_explicit(&(assembly->values+pos)->value, memory_order_relaxed);
+			atomic_store_explicit(&(assembly->values+pos)->value, current+value, memory_order_relaxed);
+		}
+	}
+
+	return ok;
+}
+
+/**
+ * @brief Initializes an empty sparse tensor
+ *
+ * @param out Pointer to the tensor to initialize, to release with tensorFreeSparse
+ * @param order Number of modes
+ * @param dims Pointer to the size of each mode
+ * @param cap Number of elements to allocate (the tensor grows when needed)
+ *
+ * @return 0 if errors occurred
+ */
+int tensorInitSparse(tensor_t* out, const int order, const int* dims, const int cap) {
+
+	//check
+	if (out == NULL || dims == NULL || order < 1 || cap < 0) {
+		return 0;
+	}
+	for (int m = 0; m < order; m++) {
+		if (dims[m] < 1) {
+			return 0;
+		}
+	}
+
+	out->order = order;
+	out->nnz = 0;
+	out->cap = cap;
+	out->dims = malloc(order*sizeof(int));
+	out->ind = malloc(((long) cap*order > 0 ? (long) cap*order : 1)*sizeof(int));
+	out->values = malloc((cap > 0 ? cap : 1)*sizeof(double));
+	if (out->dims == NULL || out->ind == NULL || out->values == NULL) {
+		tensorFreeSparse(out);
+		return 0;
+	}
+	memcpy(out->dims, dims, order*sizeof(int));
+
+	return 1;
+}
+
+/**
+ * @brief Appends an element to the sparse tensor, duplicates are summed by csfSparse
+ *
+ * @param tensor Pointer to the tensor
+ * @param index Pointer to the order coordinates of the element
+ * @param value Value of the element
+ *
+ * @return 0 if errors occurred
+ */
+int tensorAppendSparse(tensor_t* tensor, const int* index, const double value) {
+
+	//check
+	if (tensor == NULL || index == NULL || tensor->ind == NULL) {
+		return 0;
+	}
+	for (int m = 0; m < tensor->order; m++) {
+		if (index[m] < 0 || index[m] >= tensor->dims[m]) {
+			return 0;
+		}
+	}
+
+	//room for the element
+	if (tensor->nnz == tensor->cap) {
+		int cap = 2*tensor->cap+1;
+		int* ind = realloc(tensor->ind, (long) cap*tensor->order*sizeof(int));
+		if (ind == NULL) {
+			return 0;
+		}
+		tensor->ind = ind;
+		double* values = realloc(tensor->values, cap*sizeof(double));
+		if (values == NULL) {
+			return 0;
+		}
+		tensor->values = values;
+		tensor->cap = cap;
+	}
+
+	memcpy(tensor->ind+(long) tensor->nnz*tensor->order, index, tensor->order*sizeof(int));
+	tensor->values[tensor->nnz] = value;
+	tensor->nnz++;
+
+	return 1;
+}
+
+/**
+ * @brief Releases the memory of the sparse tensor
+ *
+ * @param tensor Pointer to the tensor
+ *
+ * @return 0 if errors occurred
+ */
+int tensorFreeSparse(tensor_t* tensor) {
+
+	//check
+	if (tensor == NULL) {
+		return 0;
+	}
+
+	free(tensor->dims);
+	free(tensor->ind);
+	free(tensor->values);
+
+	tensor->dims = NULL;
+	tensor->ind = NULL;
+	tensor->values = NULL;
+	tensor->nnz = 0;
+	tensor->cap = 0;
+
+	return 1;
+}
+
+/**
+ * @brief Sorts the elements of a sparse tensor by their coordinates in the given order of modes (stable counting
+ * sort on each mode from the last one)
+ *
+ * @param perm Pointer to an array of in->nnz elements where the sorted positions of the elements are stored
+ * @param in Pointer to the sparse tensor
+ * @param modes Pointer to the modes, from the most significant
+ *
+ * @return 0 if errors occurred
+ */
+static int sortTensor(int* perm, const tensor_t* in, const int* modes) {
+
+	int nnz = in->nnz;
+	int order = in->order;
+	int maxDim = 1;
+	for (int m = 0; m < order; m++) {
+		maxDim = in->dims[m] > maxDim ? in->dims[m] : maxDim;
+	}
+
+	int* count = malloc((maxDim+1)*sizeof(int));
+	int* tmp = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+	if (count == NULL || tmp == NULL) {
+		free(count);
+		free(tmp);
+		return 0;
+	}
+
+	for (int k = 0; k < nnz; k++) {
+		perm[k] = k;
+	}
+	for (int level = order-1; level >= 0; level--) {
+		int mode = modes[level];
+		memset(count, 0, (in->dims[mode]+1)*sizeof(int));
+		for (int k = 0; k < nnz; k++) {
+			count[in->ind[(long) perm[k]*order+mode]+1]++;
+		}
+		for (int c = 0; c < in->dims[mode]; c++) {
+			count[c+1] += count[c];
+		}
+		for (int k = 0; k < nnz; k++) {
+			tmp[count[in->ind[(long) perm[k]*order+mode]]++] = perm[k];
+		}
+		memcpy(perm, tmp, nnz*sizeof(int));
+	}
+
+	free(count);
+	free(tmp);
+
+	return 1;
+}
+
+/**
+ * @brief Builds the compressed sparse fiber form of the sparse tensor pointed by in, summing duplicated elements
+ *
+ * @param out Pointer to the tensor to build, to release with csfFreeSparse
+ * @param in Pointer to the sparse tensor
+ * @param modes Pointer to the mode of each level from the root, if NULL modes are sorted by increasing size
+ *
+ * @return 0 if errors occurred
+ */
+int csfSparse(csf_t* out, const tensor_t* in, const int* modes) {
+
+	//check
+	if (out == NULL || in == NULL || in->ind == NULL) {
+		return 0;
+	}
+
+	int order = in->order;
+	int nnz = in->nnz;
+
+	out->order = order;
+	out->dims = malloc(order*sizeof(int));
+	out->modes = malloc(order*sizeof(int));
+	out->nnodes = calloc(order, sizeof(int));
+	out->ptr = calloc(order, sizeof(int*));
+	out->ind = calloc(order, sizeof(int*));
+	out->values = NULL;
+	int* perm = malloc((nnz > 0 ? nnz : 1)*sizeof(int));
+	int* pos = malloc(order*sizeof(int));
+	if (out->dims == NULL || out->modes == NULL || out->nnodes == NULL || out->ptr == NULL || out->ind == NULL || perm == NULL || pos == NULL) {
+		free(perm);
+		free(pos);
+		csfFreeSparse(out);
+		return 0;
+	}
+	memcpy(out->dims, in->dims, order*sizeof(int));
+
+	//order of the levels, shortest modes first by default
+	if (modes != NULL) {
+		memset(pos, 0, order*sizeof(int));
+		for (int l = 0; l < order; l++) {
+			if (modes[l] < 0 || modes[l] >= order || pos[modes[l]]++ > 0) {
+				free(perm);
+				free(pos);
+				csfFreeSparse(out);
+				return 0;
+			}
+			out->modes[l] = modes[l];
+		}
+	} else {
+		for (int l = 0; l < order; l++) {
+			int m = l;
+			for (; m > 0 && in->dims[out->modes[m-1]] > in->dims[l]; m--) {
+				out->modes[m] = out->modes[m-1];
+			}
+			out->modes[m] = l;
+		}
+	}
+
+	if (!sortTensor(perm, in, out->modes)) {
+		free(perm);
+		free(pos);
+		csfFreeSparse(out);
+		return 0;
+	}
+
+	//number of nodes of each level: an element starts a node at every level from the first coordinate that differs from the previous one
+	for (int k = 0; k < nnz; k++) {
+		const int* cur = in->ind+(long) perm[k]*order;
+		const int* prev = k > 0 ? in->ind+(long) perm[k-1]*order : NULL;
+		int l = 0;
+		for (; prev != NULL && l < order && cur[out->modes[l]] == prev[out->modes[l]]; l++);
+		for (; l < order; l++) {
+			out->nnodes[l]++;
+		}
+	}
+
+	int ok = 1;
+	for (int l = 0; l < order; l++) {
+		out->ind[l] = malloc((out->nnodes[l] > 0 ? out->nnodes[l] : 1)*sizeof(int));
+		ok = ok && out->ind[l] != NULL;
+		if (l < order-1) {
+			out->ptr[l] = malloc((out->nnodes[l]+1)*sizeof(int));
+			ok = ok && out->ptr[l] != NULL;
+		}
+	}
+	out->values = malloc((out->nnodes[order-1] > 0 ? out->nnodes[order-1] : 1)*sizeof(double));
+	if (!ok || out->values == NULL) {
+		free(perm);
+		free(pos);
+		csfFreeSparse(out);
+		return 0;
+	}
+
+	//nodes
+	for (int l = 0; l < order; l++) {
+		pos[l] = -1;
+	}
+	for (int k = 0; k < nnz; k++) {
+		const int* cur = in->ind+(long) perm[k]*order;
+		const int* prev = k > 0 ? in->ind+(long) perm[k-1]*order : NULL;
+		int l = 0;
+		for (; prev != NULL && l < order && cur[out->modes[l]] == prev[out->modes[l]]; l++);
+		if (l == order) {
+			out->values[pos[order-1]] += in->values[perm[k]];
+			continue;
+		}
+		for (; l < order; l++) {
+			pos[l]++;
+			out->ind[l][pos[l]] = cur[out->modes[l]];
+			if (l < order-1) {
+				out->ptr[l][pos[l]] = pos[l+1]+1;
+			}
+		}
+		out->values[pos[order-1]] = in->values[perm[k]];
+	}
+	for (int l = 0; l < order-1; l++) {
+		out->ptr[l][out->nnodes[l]] = out->nnodes[l+1];
+	}
+
+	free(perm);
+	free(pos);
+
+	return 1;
+}
+
+/**
+ * @brief Releases the memory of the compressed sparse fiber tensor
+ *
+ * @param tensor Pointer to the tensor
+ *
+ * @return 0 if errors occurred
+ */
+int csfFreeSparse(csf_t* tensor) {
+
+	//check
+	if (tensor == NULL) {
+		return 0;
+	}
+
+	for (int l = 0; l < tensor->order; l++) {
+		if (tensor->ptr != NULL) {
+			free(tensor->ptr[l]);
+		}
+		if (tensor->ind != NULL) {
+			free(tensor->ind[l]);
+		}
+	}
+	free(tensor->dims);
+	free(tensor->modes);
+	free(tensor->nnodes);
+	free(tensor->ptr);
+	free(tensor->ind);
+	free(tensor->values);
+
+	tensor->dims = NULL;
+	tensor->modes = NULL;
+	tensor->nnodes = NULL;
+	tensor->ptr = NULL;
+	tensor->ind = NULL;
+	tensor->values = NULL;
+
+	return 1;
+}
+
+/**
+ * @brief Sum over the subtree of a node of the values times the element-wise product of the factor rows of the
+ * levels from the node down to the leaves
+ *
+ * @param work Pointer to order*rank elements, the result is stored at work+level*rank (deeper levels are overwritten)
+ * @param in Pointer to the compressed sparse fiber tensor
+ * @param factors Pointer to the factor of each mode
+ * @param rank Number of columns of the factors
+ * @param level Level of the node
+ * @param node Position of the node in its level
+ */
+static void csfBelow(double* work, const csf_t* in, double* const* factors, const int rank, const int level, const int node) {
+
+	double* acc = work+level*rank;
+	const double* row = factors[in->modes[level]]+(long) in->ind[level][node]*rank;
+
+	if (level == in->order-1) {
+		for (int r = 0; r < rank; r++) {
+			acc[r] = in->values[node]*row[r];
+		}
+		return;
+	}
+
+	for (int r = 0; r < rank; r++) {
+		acc[r] = 0;
+	}
+	for (int c = in->ptr[level][node]; c < in->ptr[level][node+1]; c++) {
+		csfBelow(work, in, factors, rank, level+1, c);
+		for (int r = 0; r < rank; r++) {
+			acc[r] += work[(level+1)*rank+r];
+		}
+	}
+	for (int r = 0; r < rank; r++) {
+		acc[r] *= row[r];
+	}
+}
+
+/**
+ * @brief MTTKRP of the subtree of a node above or at the level of the result mode
+ *
+ * @param out Pointer to the result
+ * @param prefix Pointer to order*rank elements, prefix+level*rank holds the product of the factor rows from the root to the node
+ * @param work Pointer to order*rank elements used by csfBelow
+ * @param in Pointer to the compressed sparse fiber tensor
+ * @param factors Pointer to the factor of each mode
+ * @param rank Number of columns of the factors
+ * @param target Level of the result mode
+ * @param level Level of the node
+ * @param node Position of the node in its level
+ */
+static void csfMttkrp(double* out, double* prefix, double* work, const csf_t* in, double* const* factors, const int rank, const int target, const int level, const int node) {
+
+	const double* above = level > 0 ? prefix+(level-1)*rank : NULL;
+
+	if (level < target) {
+		const double* row = factors[in->modes[level]]+(long) in->ind[level][node]*rank;
+		for (int r = 0; r < rank; r++) {
+			prefix[level*rank+r] = above != NULL ? above[r]*row[r] : row[r];
+		}
+		for (int c = in->ptr[level][node]; c < in->ptr[level][node+1]; c++) {
+			csfMttkrp(out, prefix, work, in, factors, rank, target, level+1, c);
+		}
+		return;
+	}
+
+	double* dst = out+(long) in->ind[level][node]*rank;
+	if (level == in->order-1) {
+		for (int r = 0; r < rank; r++) {
+			dst[r] += in->values[node]*(above != NULL ? above[r] : 1);
+		}
+		return;
+	}
+
+	for (int c = in->ptr[level][node]; c < in->ptr[level][node+1]; c++) {
+		csfBelow(work, in, factors, rank, level+1, c);
+		for (int r = 0; r < rank; r++) {
+			dst[r] += work[(level+1)*rank+r]*(above != NULL ? above[r] : 1);
+		}
+	}
+}
+
+/**
+ * @brief Matricized tensor times Khatri-Rao product along a mode: out(i,:) is the sum over the elements with
+ * coordinate i in mode of value times the element-wise product of the rows of the factors of the other modes
+ *
+ * Root fibers are processed in parallel with OpenMP, each thread accumulating in its own copy of the result
+ * (summed at the end) unless mode is the mode of the root.
+ *
+ * @param out Pointer to the dims[mode]*rank result, by rows
+ * @param in Pointer to the compressed sparse fiber tensor
+ * @param factors Pointer to the dims[m]*rank factor of each mode m, by rows (the one of mode isn't used)
+ * @param rank Number of columns of the factors
+ * @param mode Mode of the result
+ *
+ * @return 0 if errors occurred
+ */
+int mttkrpSparse(double* out, const csf_t* in, double* const* factors, const int rank, const int mode) {
+
+	//check
+	if (out == NULL || in == NULL || in->values == NULL || factors == NULL || rank < 1 || mode < 0 || mode >= in->order) {
+		return 0;
+	}
+	for (int m = 0; m < in->order; m++) {
+		if (m != mode && factors[m] == NULL) {
+			return 0;
+		}
+	}
+
+	int target = 0;
+	for (; in->modes[target] != mode; target++);
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	long size = (long) in->dims[mode]*rank;
+	long scratch = 2L*in->order*rank;
+	double* prefix = malloc(threads*scratch*sizeof(double));
+	if (prefix == NULL) {
+		return 0;
+	}
+
+	//root nodes have distinct coordinates, so they write distinct rows only if the result mode is the root,
+	//otherwise each thread accumulates in its own copy of the result (if it can't be allocated, one thread does all)
+	double* priv = NULL;
+	if (target > 0 && threads > 1) {
+		priv = calloc(threads*size, sizeof(double));
+	}
+
+	//static schedule, so the sums don't depend on the run
+	memset(out, 0, size*sizeof(double));
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) if(target == 0 || priv != NULL)
+#endif
+	for (int node = 0; node < in->nnodes[0]; node++) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		double* tprefix = prefix+t*scratch;
+		csfMttkrp(priv != NULL ? priv+t*size : out, tprefix, tprefix+in->order*rank, in, factors, rank, target, 0, node);
+	}
+
+	//sum of the copies, in the order of the threads
+	if (priv != NULL) {
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for (long k = 0; k < size; k++) {
+			double sum = 0;
+			for (int t = 0; t < threads; t++) {
+				sum += priv[t*size+k];
+			}
+			out[k] = sum;
+		}
+	}
+
+	free(prefix);
+	free(priv);
+
+	return 1;
+}
+
+/**
+ * @brief Tensor times vector along a mode, the result has one mode less (mode is removed, the others keep their order)
+ *
+ * The products of the leaves are computed in parallel with OpenMP over the root fibers, then sorted and summed.
+ *
+ * @param out Pointer to the sparse tensor to build, to release with tensorFreeSparse
+ * @param in Pointer to the compressed sparse fiber tensor, of order at least 2
+ * @param v Pointer to the vector of dims[mode] elements
+ * @param mode Mode to contract
+ *
+ * @return 0 if errors occurred
+ */
+int ttvSparse(tensor_t* out, const csf_t* in, const double* v, const int mode) {
+
+	//check
+	if (out == NULL || in == NULL || in->values == NULL || v == NULL || in->order < 2 || mode < 0 || mode >= in->order) {
+		return 0;
+	}
+
+	int order = in->order;
+	int nleaves = in->nnodes[order-1];
+
+	//mode of the result of each mode of the tensor
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int* outMode = malloc(order*sizeof(int));
+	int* node = malloc((long) threads*order*sizeof(int));
+	tensor_t tmp;
+	if (outMode == NULL || node == NULL || !tensorInitSparse(&tmp, order-1, in->dims, nleaves)) {
+		free(outMode);
+		free(node);
+		return 0;
+	}
+	for (int m = 0; m < order; m++) {
+		outMode[m] = m < mode ? m : m-1;
+		if (m != mode) {
+			tmp.dims[outMode[m]] = in->dims[m];
+		}
+	}
+
+	//one product for each leaf, with the coordinates of its ancestors: root fibers are processed in parallel, each
+	//leaf writes its own slot
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int root = 0; root < in->nnodes[0]; root++) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		int* tnode = node+(long) t*order;
+
+		//first descendant of each level and end of the leaves of the fiber
+		tnode[0] = root;
+		int end = root+1;
+		for (int l = 0; l < order-1; l++) {
+			tnode[l+1] = in->ptr[l][tnode[l]];
+			end = in->ptr[l][end];
+		}
+		for (int k = tnode[order-1]; k < end; k++) {
+			tnode[order-1] = k;
+			for (int l = order-2; l > 0; l--) {
+				while (in->ptr[l][tnode[l]+1] <= tnode[l+1]) {
+					tnode[l]++;
+				}
+			}
+			int* index = tmp.ind+(long) k*(order-1);
+			double value = in->values[k];
+			for (int l = 0; l < order; l++) {
+				if (in->modes[l] == mode) {
+					value *= v[in->ind[l][tnode[l]]];
+				} else {
+					index[outMode[in->modes[l]]] = in->ind[l][tnode[l]];
+				}
+			}
+			tmp.values[k] = value;
+		}
+	}
+	tmp.nnz = nleaves;
+
+	free(node);
+	free(outMode);
+
+	//sum of the products with the same coordinates
+	int* modes = malloc((order-1)*sizeof(int));
+	int* perm = malloc((nleaves > 0 ? nleaves : 1)*sizeof(int));
+	if (modes == NULL || perm == NULL || !tensorInitSparse(out, order-1, tmp.dims, nleaves)) {
+		free(modes);
+		free(perm);
+		tensorFreeSparse(&tmp);
+		return 0;
+	}
+	for (int m = 0; m < order-1; m++) {
+		modes[m] = m;
+	}
+	if (!sortTensor(perm, &tmp, modes)) {
+		free(modes);
+		free(perm);
+		tensorFreeSparse(&tmp);
+		tensorFreeSparse(out);
+		return 0;
+	}
+
+	for (int k = 0; k < nleaves; k++) {
+		const int* index = tmp.ind+(long) perm[k]*(order-1);
+		if (out->nnz > 0 && memcmp(index, out->ind+(long) (out->nnz-1)*(order-1), (order-1)*sizeof(int)) == 0) {
+			out->values[out->nnz-1] += tmp.values[perm[k]];
+			continue;
+		}
+		memcpy(out->ind+(long) out->nnz*(order-1), index, (order-1)*sizeof(int));
+		out->values[out->nnz] = tmp.values[perm[k]];
+		out->nnz++;
+	}
+
+	free(modes);
+	free(perm);
+	tensorFreeSparse(&tmp);
+
+	return 1;
+}
+
+/**
+ * @brief Generates a random sparse tensor with uniformly distributed coordinates and values in (0,1]
+ * (duplicated coordinates are possible, csfSparse sums them)
+ *
+ * @param out Pointer to the tensor to build, to release with tensorFreeSparse
+ * @param order Number of modes
+ * @param dims Pointer to the size of each mode
+ * @param nnz Number of elements to generate
+ * @param seed Seed of the random generator
+ *
+ * @return 0 if errors occurred
+ */
+int randomTensorSparse(tensor_t* out, const int order, const int* dims, const int nnz, const unsigned long seed) {
+
+	//check
+	if (nnz < 0 || !tensorInitSparse(out, order, dims, nnz)) {
+		return 0;
+	}
+
+	uint64_t state = seed;
+	for (int k = 0; k < nnz; k++) {
+		for (int m = 0; m < order; m++) {
+			int c = (int) (randomUniform(&state)*dims[m]);
+			out->ind[(long) k*order+m] = c < dims[m] ? c : dims[m]-1;
+		}
+		out->values[k] = 1-randomUniform(&state);
+	}
+	out->nnz = nnz;
+
+	return 1;
+}
+
+/**
+ * @brief CP decomposition of a sparse tensor with alternating least squares: each factor is updated with
+ * mttkrpSparse and a rank*rank dense solve with the Hadamard product of the Gram matrices of the other factors
+ *
+ * Columns of the factors are normalized, their norms are stored in lambda. Iterations stop when the fit changes less than tol.
+ *
+ * @param factors Pointer to the dims[m]*rank factor of each mode m, by rows, initialized randomly
+ * @param lambda Pointer to an array of rank elements where the weights of the components are stored
+ * @param fit Where to store the fit 1-||X-Xhat||/||X|| reached (may be NULL)
+ * @param modeTime Pointer to an array of order elements where the elapsed seconds spent on each mode are stored (may be NULL)
+ * @param in Pointer to the compressed sparse fiber tensor
+ * @param rank Number of components
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance on the change of the fit
+ * @param seed Seed of the random initialization
+ *
+ * @return 0 if errors occurred
+ */
+int cpalsSparse(double** factors, double* lambda, double* fit, double* modeTime, const csf_t* in, const int rank, const int maxIter, const double tol, const unsigned long seed) {
+
+	//check
+	if (factors == NULL || lambda == NULL || in == NULL || in->values == NULL || rank < 1 || maxIter < 0) {
+		return 0;
+	}
+
+	int order = in->order;
+	int maxDim = 1;
+	for (int m = 0; m < order; m++) {
+		if (factors[m] == NULL) {
+			return 0;
+		}
+		maxDim = in->dims[m] > maxDim ? in->dims[m] : maxDim;
+	}
+
+	double* gram = malloc((long) order*rank*rank*sizeof(double));
+	double* v = malloc(rank*rank*sizeof(double));
+	double* mat = malloc((long) maxDim*rank*sizeof(double));
+	int* piv = malloc(rank*sizeof(int));
+	if (gram == NULL || v == NULL || mat == NULL || piv == NULL) {
+		free(gram);
+		free(v);
+		free(mat);
+		free(piv);
+		return 0;
+	}
+
+	//random factors and their Gram matrices
+	uint64_t state = seed;
+	for (int m = 0; m < order; m++) {
+		double* a = factors[m];
+		for (long q = 0; q < (long) in->dims[m]*rank; q++) {
+			a[q] = randomUniform(&state);
+		}
+		for (int r = 0; r < rank; r++) {
+			for (int s = 0; s < rank; s++) {
+				double sum = 0;
+				for (int i = 0; i < in->dims[m]; i++) {
+					sum += a[(long) i*rank+r]*a[(long) i*rank+s];
+				}
+				gram[(long) m*rank*rank+r*rank+s] = sum;
+			}
+		}
+		if (modeTime != NULL) {
+			modeTime[m] = 0;
+		}
+	}
+
+	double normX = 0;
+	for (int k = 0; k < in->nnodes[order-1]; k++) {
+		normX += in->values[k]*in->values[k];
+	}
+	normX = sqrt(normX);
+
+	double fitOld = 0;
+	double fitNew = 0;
+	int ok = 1;
+	for (int iter = 0; ok && iter < maxIter; iter++) {
+		for (int mode = 0; ok && mode < order; mode++) {
+			//elapsed time, clock() would sum the threads of mttkrpSparse
+#ifdef _OPENMP
+			double start = omp_get_wtime();
+#else
+			double start = (double) clock()/CLOCKS_PER_SEC;
+#endif
+			double* a = factors[mode];
+			int rows = in->dims[mode];
+
+			//right hand sides and system matrix
+			ok = mttkrpSparse(mat, in, factors, rank, mode);
+			for (int q = 0; q < rank*rank; q++) {
+				v[q] = 1;
+				for (int m = 0; m < order; m++) {
+					if (m != mode) {
+						v[q] *= gram[(long) m*rank*rank+q];
+					}
+				}
+			}
+			ok = ok && luDense(v, piv, rank);
+			if (!ok) {
+				break;
+			}
+
+			//solving by rows (the system matrix is symmetric)
+			memcpy(a, mat, (long) rows*rank*sizeof(double));
+			for (int i = 0; i < rows; i++) {
+				luSolveDense(v, piv, rank, a+(long) i*rank);
+			}
+
+			//normalizing the columns
+			for (int r = 0; r < rank; r++) {
+				double norm = 0;
+				for (int i = 0; i < rows; i++) {
+					norm += a[(long) i*rank+r]*a[(long) i*rank+r];
+				}
+				lambda[r] = sqrt(norm);
+				if (lambda[r] > 0) {
+					for (int i = 0; i < rows; i++) {
+						a[(long) i*rank+r] /= lambda[r];
+					}
+				}
+			}
+
+			for (int r = 0; r < rank; r++) {
+				for (int s = 0; s < rank; s++) {
+					double sum = 0;
+					for (int i = 0; i < rows; i++) {
+						sum += a[(long) i*rank+r]*a[(long) i*rank+s];
+					}
+					gram[(long) mode*rank*rank+r*rank+s] = sum;
+				}
+			}
+
+			if (modeTime != NULL) {
+#ifdef _OPENMP
+				modeTime[mode] += omp_get_wtime()-start;
+#else
+				modeTime[mode] += (double) clock()/CLOCKS_PER_SEC-start;
+#endif
+			}
+		}
+		if (!ok) {
+			break;
+		}
+
+		//fit from the last product: <X,Xhat> and ||Xhat|| from the Gram matrices
+		double* a = factors[order-1];
+		double inner = 0;
+		for (long q = 0; q < (long) in->dims[order-1]*rank; q++) {
+			inner += lambda[q%rank]*a[q]*mat[q];
+		}
+		double normXhat = 0;
+		for (int r = 0; r < rank; r++) {
+			for (int s = 0; s < rank; s++) {
+				double prod = lambda[r]*lambda[s];
+				for (int m = 0; m < order; m++) {
+					prod *= gram[(long) m*rank*rank+r*rank+s];
+				}
+				normXhat += prod;
+			}
+		}
+		double residual = normX*normX+normXhat-2*inner;
+		fitNew = normX > 0 ? 1-sqrt(residual > 0 ? residual : 0)/normX : 1;
+		if (iter > 0 && fabs(fitNew-fitOld) < tol) {
+			break;
+		}
+		fitOld = fitNew;
+	}
+
+	if (fit != NULL) {
+		*fit = fitNew;
+	}
+
+	free(gram);
+	free(v);
+	free(mat);
+	free(piv);
+
+	return ok;
+}
+
+/**
+ * @brief Product of a normalized sparse matrix (or its transpose) by a dense matrix, by rows of the result over
+ * tiles of GNN_TILE columns
+ *
+ * @param out Pointer to the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param x Pointer to the dense matrix, by rows
+ * @param k Number of columns of the dense matrix
+ * @param norm Normalization: GNN_NONE, GNN_ROW or GNN_SYM
+ * @param transposed If not 0 the transpose of the normalized matrix is used
+ *
+ * @return 0 if errors occurred
+ */
+static int gnnProduct(double* out, const elem_t* in, const double* x, const int k, const int norm, const int transposed) {
+
+	//check
+	if (out == NULL || in == NULL || x == NULL || k < 1 || (norm != GNN_NONE && norm != GNN_ROW && norm != GNN_SYM)) {
+		return 0;
+	}
+
+	int m = in->i;
+	int n = in->j;
+	int rows = transposed ? n : m;
+
+	//scaling of the rows and of the columns
+	double* left = malloc((m > 0 ? m : 1)*sizeof(double));
+	double* right = malloc((n > 0 ? n : 1)*sizeof(double));
+	int* ptr;
+	int* perm;
+	if (left == NULL || right == NULL || !indexSparse(in, transposed, &ptr, &perm)) {
+		free(left);
+		free(right);
+		return 0;
+	}
+
+	for (int i = 0; i < m; i++) {
+		left[i] = 0;
+	}
+	for (int j = 0; j < n; j++) {
+		right[j] = 0;
+	}
+	for (int e = 0; e < (int) in->value; e++) {
+		left[(in+e+1)->i] += (in+e+1)->value;
+		right[(in+e+1)->j] += (in+e+1)->value;
+	}
+	for (int i = 0; i < m; i++) {
+		if (norm == GNN_NONE) {
+			left[i] = 1;
+		} else if (norm == GNN_ROW) {
+			left[i] = left[i] != 0 ? 1/left[i] : 0;
+		} else {
+			left[i] = left[i] > 0 ? 1/sqrt(left[i]) : 0;
+		}
+	}
+	for (int j = 0; j < n; j++) {
+		right[j] = norm == GNN_SYM ? (right[j] > 0 ? 1/sqrt(right[j]) : 0) : 1;
+	}
+
+	//rows of the result (in parallel), then tiles of columns over the elements of the row
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int r = 0; r < rows; r++) {
+		double* dst = out+(long) r*k;
+		for (int c0 = 0; c0 < k; c0 += GNN_TILE) {
+			int c1 = c0+GNN_TILE < k ? c0+GNN_TILE : k;
+			for (int c = c0; c < c1; c++) {
+				dst[c] = 0;
+			}
+			for (int p = ptr[r]; p < ptr[r+1]; p++) {
+				elem_t curr = *(in+perm[p]+1);
+				double scale = curr.value*left[curr.i]*right[curr.j];
+				const double* src = x+(long) (transposed ? curr.i : curr.j)*k;
+				for (int c = c0; c < c1; c++) {
+					dst[c] += scale*src[c];
+				}
+			}
+		}
+	}
+
+	free(left);
+	free(right);
+	free(ptr);
+	free(perm);
+
+	return 1;
+}
+
+/**
+ * @brief Multiplies the normalized sparse matrix pointed by in by the dense feature matrix h of k columns
+ * (aggregation of a graph neural network layer), the normalization is applied on the fly
+ *
+ * Rows of the result are computed in parallel with OpenMP, each one over tiles of GNN_TILE features: the elements
+ * of the row are read once per tile and the tile of the result row stays in cache.
+ *
+ * @param out Pointer to the in->i*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param h Pointer to the in->j*k elements of the feature matrix, by rows
+ * @param k Number of features
+ * @param norm Normalization: GNN_NONE, GNN_ROW or GNN_SYM
+ *
+ * @return 0 if errors occurred
+ */
+int gnnMultiplySparse(double* out, const elem_t* in, const double* h, const int k, const int norm) {
+	return gnnProduct(out, in, h, k, norm, 0);
+}
+
+/**
+ * @brief Multiplies the transpose of the normalized sparse matrix pointed by in by the dense gradient g of k columns
+ * (backward pass of gnnMultiplySparse), without building the transpose
+ *
+ * @param out Pointer to the in->j*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param g Pointer to the in->i*k elements of the gradient, by rows
+ * @param k Number of features
+ * @param norm Normalization used in the forward pass: GNN_NONE, GNN_ROW or GNN_SYM
+ *
+ * @return 0 if errors occurred
+ */
+int gnnMultiplySparseT(double* out, const elem_t* in, const double* g, const int k, const int norm) {
+	return gnnProduct(out, in, g, k, norm, 1);
+}
+
+/**
+ * @brief Sparse attention restricted to the pattern of the sparse matrix pointed by in: for each row i the scores
+ * scale*q(i,:).k(j,:) of its elements (SDDMM) go through a softmax over the row and weight the rows v(j,:) (SpMM)
+ *
+ * The three steps are fused one row at a time, rows in parallel with OpenMP, the scores of the row are kept in a
+ * buffer of the thread. Values of the pattern are ignored, rows without elements give zero rows.
+ *
+ * @param out Pointer to the in->i*dv elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix giving the pattern
+ * @param q Pointer to the in->i*d elements of the queries, by rows
+ * @param k Pointer to the in->j*d elements of the keys, by rows
+ * @param v Pointer to the in->j*dv elements of the values, by rows
+ * @param d Number of columns of queries and keys
+ * @param dv Number of columns of the values
+ * @param scale Factor of the scores (usually 1/sqrt(d))
+ *
+ * @return 0 if errors occurred
+ */
+int attentionSparse(double* out, const elem_t* in, const double* q, const double* k, const double* v, const int d, const int dv, const double scale) {
+
+	//check
+	if (out == NULL || in == NULL || q == NULL || k == NULL || v == NULL || d < 1 || dv < 1) {
+		return 0;
+	}
+
+	int m = in->i;
+	int* ptr;
+	int* perm;
+	if (!indexSparse(in, 0, &ptr, &perm)) {
+		return 0;
+	}
+
+	//buffer for the scores of the longest row, one for each thread
+	int maxlen = 0;
+	for (int r = 0; r < m; r++) {
+		maxlen = ptr[r+1]-ptr[r] > maxlen ? ptr[r+1]-ptr[r] : maxlen;
+	}
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	double* scores = malloc((long) threads*(maxlen > 0 ? maxlen : 1)*sizeof(double));
+	if (scores == NULL) {
+		free(ptr);
+		free(perm);
+		return 0;
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int r = 0; r < m; r++) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		double* score = scores + (long) t*(maxlen > 0 ? maxlen : 1);
+		const double* qrow = q+(long) r*d;
+		double* dst = out+(long) r*dv;
+		int len = ptr[r+1]-ptr[r];
+
+		for (int c = 0; c < dv; c++) {
+			dst[c] = 0;
+		}
+		if (len == 0) {
+			continue;
+		}
+
+		//scores of the row
+		double max = -INFINITY;
+		for (int p = 0; p < len; p++) {
+			const double* krow = k+(long) (in+perm[ptr[r]+p]+1)->j*d;
+			double dot = 0;
+			for (int c = 0; c < d; c++) {
+				dot += qrow[c]*krow[c];
+			}
+			score[p] = scale*dot;
+			max = score[p] > max ? score[p] : max;
+		}
+
+		//softmax and weighted sum of the values
+		double sum = 0;
+		for (int p = 0; p < len; p++) {
+			score[p] = exp(score[p]-max);
+			sum += score[p];
+			const double* vrow = v+(long) (in+perm[ptr[r]+p]+1)->j*dv;
+			for (int c = 0; c < dv; c++) {
+				dst[c] += score[p]*vrow[c];
+			}
+		}
+		for (int c = 0; c < dv; c++) {
+			dst[c] /= sum;
+		}
+	}
+
+	free(scores);
+	free(ptr);
+	free(perm);
+
+	return 1;
+}
@@ -7,8 +7,16 @@
  * @since 1.0
  */
 
+#ifndef SPARSE_H
+#define SPARSE_H
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 struct elem {
 	int i;
@@ -116,3 +124,1107 @@ int deleteZerosSparse(elem_t* out);
  * @return 0 if errors occurred
  */
 int printSparse(const elem_t* matrix);
+
+/* Number of partial products expanded at once by multiplySparse_ESC (two buffers of this size should fit in cache) */
+#define ESC_BATCH 8192
+
+/* Smallest number of elements of each chunk sorted in parallel by sortSparse */
+#define SORT_CHUNK 32768
+
+/**
+ * @brief Sorts the elements of the sparse matrix by row and then by column with a radix sort
+ *
+ * With OpenMP, matrixes of at least 2*SORT_CHUNK elements are sorted in parallel over chunks of the elements.
+ *
+ * @param matrix Pointer to the first element of the sparse matrix
+ *
+ * @return 0 if errors occurred
+ */
+int sortSparse(elem_t* matrix);
+
+/**
+ * @brief Multiplies two sparse matrixes with the expand-sort-compress method and stores the sorted result in the sparse matrix pointed by out
+ *
+ * Partial products are expanded for batches of rows of in1 (about ESC_BATCH at a time), so the working memory doesn't
+ * depend on the size of the product (a row with more partial products gets a buffer of its own size, released after
+ * it). Each row is sorted and compressed in its own part of the buffer, in parallel when built with OpenMP.
+ *
+ * Unlike multiplySparse, only the elements that sum exactly to zero are dropped: elements below INFVALUE are kept.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ *
+ * @return 0 if errors occurred (also if a row has more than INT_MAX partial products)
+ */
+int multiplySparse_ESC(elem_t* out, const elem_t* in1, const elem_t* in2);
+
+/**
+ * @brief Adds alpha times the sparse matrix pointed by in to the sparse matrix pointed by out, in place
+ *
+ * Elements already present in out are only updated, new elements are appended after the last element of out
+ * (which is never reallocated) and zeros aren't deleted, so the pattern of out stays stable between calls.
+ *
+ * @param out Pointer to the first element of the sparse matrix to update
+ * @param size Number of elements allocated for out (first element excluded)
+ * @param in Pointer to the first element of the sparse matrix to add
+ * @param alpha Coefficient of in
+ *
+ * @return 0 if errors occurred (out isn't modified)
+ */
+int accumulateSparse(elem_t* out, const int size, const elem_t* in, const double alpha);
+
+/**
+ * @brief Adds alpha times the product of the sparse matrixes pointed by in1 and in2 to the sparse matrix pointed by out, in place
+ *
+ * Partial products are added to out one row at a time, the product isn't built and no value is dropped.
+ * New elements are appended after the last element of out as in accumulateSparse.
+ *
+ * @param out Pointer to the first element of the sparse matrix to update
+ * @param size Number of elements allocated for out (first element excluded)
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ * @param alpha Coefficient of the product
+ *
+ * @return 0 if errors occurred (out isn't modified)
+ */
+int accumulateMultiplySparse(elem_t* out, const int size, const elem_t* in1, const elem_t* in2, const double alpha);
+
+/**
+ * @brief Prunes each row of the sparse matrix, keeping at most k elements with the largest absolute values
+ * and deleting elements below an absolute or relative (to the largest absolute value of the row) threshold
+ *
+ * The elements of the matrix are left sorted by row and column. Rows are pruned in parallel with OpenMP.
+ *
+ * @param matrix Pointer to the first element of the sparse matrix
+ * @param k Maximum number of elements kept in each row (0 to keep all of them)
+ * @param absolute Elements with absolute value below this threshold are deleted
+ * @param relative Elements with absolute value below relative times the largest absolute value of their row are deleted
+ *
+ * @return 0 if errors occurred
+ */
+int pruneSparse(elem_t* matrix, const int k, const double absolute, const double relative);
+
+/**
+ * @brief Multiplies two sparse matrixes row by row, pruning each row of the result as pruneSparse does before storing it
+ * in the sparse matrix pointed by out, so the full product is never stored
+ *
+ * Batches of rows are computed in parallel with OpenMP (each thread with its own dense accumulator), each pruned row
+ * in its own part of a buffer, then copied in order.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ * @param k Maximum number of elements kept in each row (0 to keep all of them)
+ * @param absolute Elements with absolute value below this threshold are deleted
+ * @param relative Elements with absolute value below relative times the largest absolute value of their row are deleted
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_Prune(elem_t* out, const elem_t* in1, const elem_t* in2, const int k, const double absolute, const double relative);
+
+/**
+ * @brief Raises each element of the sparse matrix to the passed power and normalizes the rows to sum 1, in place
+ *
+ * Elements can be in any order, rows are inflated and normalized in parallel with OpenMP.
+ *
+ * @param matrix Pointer to the first element of the sparse matrix
+ * @param power Exponent applied to the absolute value of each element
+ *
+ * @return 0 if errors occurred
+ */
+int inflateSparse(elem_t* matrix, const double power);
+
+/**
+ * @brief Markov clustering of the graph whose adjacency matrix is the sparse matrix pointed by in
+ *
+ * The matrix is used as row stochastic (row v holds the transition probabilities from vertex v) and self loops
+ * should already be present. Each iteration squares the matrix with multiplySparse_Prune, so only one row of the
+ * product exists at a time for each thread, then inflates it with inflateSparse, until the chaos (largest difference,
+ * over the rows, between the largest value and the sum of the squares) is below tol. Expansion, inflation and chaos
+ * run in parallel over the rows with OpenMP.
+ *
+ * @param out Pointer to the first element of the limit sparse matrix, out->value must contain the number of elements allocated
+ * @param clusters Pointer to an array of in->i integers where the attractor of each vertex is stored (can be NULL)
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param inflation Inflation exponent (usually 2)
+ * @param k Maximum number of elements kept in each row after expansion (0 to keep all of them)
+ * @param threshold Elements below this value are pruned after expansion
+ * @param maxIter Maximum number of iterations
+ * @param tol Chaos under which the iterations stop
+ *
+ * @return 0 if errors occurred
+ */
+int mclSparse(elem_t* out, int* clusters, const elem_t* in, const double inflation, const int k, const double threshold, const int maxIter, const double tol);
+
+/* Similarity measures of similaritySparse */
+#define SIMILARITY_COSINE 0
+#define SIMILARITY_JACCARD 1
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the similarities between the rows of the sparse matrix pointed by in
+ * that are at least threshold, without storing the product of in by its transpose
+ *
+ * Rows are computed one at a time, in parallel with OpenMP, each one in a hash accumulator sized by the rows sharing
+ * a column with it (no array of in->i elements per thread). Its similarities above the threshold are pruned to the
+ * top k as soon as the row is complete, so out only needs room for the result. The result is sorted by row and
+ * column, the diagonal isn't stored and rows with zero norm have no similarities.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the sparse matrix whose rows are compared
+ * @param metric SIMILARITY_COSINE or SIMILARITY_JACCARD (of the patterns of the rows)
+ * @param threshold Pairs with similarity below this value aren't stored
+ * @param k Maximum number of elements kept in each row (0 to keep all of them)
+ *
+ * @return 0 if errors occurred
+ */
+int similaritySparse(elem_t* out, const elem_t* in, const int metric, const double threshold, const int k);
+
+/**
+ * @brief Generates the sparse matrix of a random R-MAT graph with 2^scale vertices, without duplicated edges
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * (at least edgefactor*2^scale, at most INT_MAX)
+ * @param scale Logarithm in base 2 of the number of vertices
+ * @param edgefactor Number of edges generated per vertex (before removing duplicates)
+ * @param a Probability of the top left quadrant
+ * @param b Probability of the top right quadrant
+ * @param c Probability of the bottom left quadrant (the bottom right one has 1-a-b-c)
+ * @param seed Seed of the random generator
+ *
+ * @return 0 if errors occurred
+ */
+int rmatSparse(elem_t* out, const int scale, const int edgefactor, const double a, const double b, const double c, const unsigned long seed);
+
+/**
+ * @brief Counts the triangles of the undirected graph whose adjacency pattern is the sparse matrix pointed by in
+ *
+ * Edges are oriented from the vertex of lower degree to the one of higher degree and the triangles are found as
+ * the nonzeros of (L*L) masked by L, in parallel over the vertices, intersecting adjacency lists with a marker
+ * array per thread.
+ *
+ * @param total Where to store the number of triangles
+ * @param perVertex Pointer to an array of in->i elements where the number of triangles of each vertex is stored (can be NULL)
+ * @param in Pointer to the first element of the sparse matrix of the graph (direction, values and diagonal are ignored)
+ *
+ * @return 0 if errors occurred
+ */
+int triangleSparse(long* total, long* perVertex, const elem_t* in);
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the k-truss of the undirected graph whose adjacency pattern is
+ * the sparse matrix pointed by in, that is the largest subgraph where each edge is in at least k-2 triangles
+ *
+ * The triangles of each edge are counted once, in parallel over the vertices as in triangleSparse. Edges are then
+ * peeled from a queue: removing an edge decrements the support of the two other edges of each of its remaining
+ * triangles, and an edge is queued when its support falls below k-2.
+ *
+ * @param out Pointer to the first element of the result sparse matrix (both directions of each edge, valued with
+ * the number of triangles of the edge), out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the sparse matrix of the graph (direction, values and diagonal are ignored)
+ * @param k Order of the truss
+ *
+ * @return 0 if errors occurred
+ */
+int trussSparse(elem_t* out, const elem_t* in, const int k);
+
+/**
+ * @brief Single source shortest paths with Bellman-Ford, as repeated (min,+) products of the frontier of updated
+ * vertices by the sparse matrix pointed by in, where element (i,j) is the weight of the edge from i to j
+ *
+ * @param dist Pointer to an array of in->i elements where the distances are stored (INFINITY if not reachable)
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param source Index of the source vertex
+ *
+ * @return 0 if errors occurred (also if a negative cycle is reachable)
+ */
+int bellmanFordSparse(double* dist, const elem_t* in, const int source);
+
+/* Largest number of buckets of deltaSteppingSparse (ceil(maxWeight/delta)+1) */
+#define DELTA_MAX_BUCKETS 16777216
+
+/**
+ * @brief Single source shortest paths with delta-stepping on the sparse matrix pointed by in, where element (i,j)
+ * is the non-negative weight of the edge from i to j
+ *
+ * Buckets are kept in a circular array of ceil(maxWeight/delta)+1 buckets, the tentative distances never span more.
+ * The edges of the vertices of a bucket are relaxed in parallel, each thread collecting the tentative distances in
+ * its own buffer, and the smallest distance of each vertex is then applied moving it to its bucket.
+ *
+ * @param dist Pointer to an array of in->i elements where the distances are stored (INFINITY if not reachable)
+ * @param in Pointer to the first element of the sparse matrix of the graph
+ * @param source Index of the source vertex
+ * @param delta Width of the buckets, edges not heavier than delta are relaxed inside the bucket
+ *
+ * @return 0 if errors occurred (also if a weight is negative or maxWeight/delta needs more than DELTA_MAX_BUCKETS buckets)
+ */
+int deltaSteppingSparse(double* dist, const elem_t* in, const int source, const double delta);
+
+/**
+ * @brief Multiplies the sparse matrix pointed by in by a vector and stores the result in the vector pointed by out
+ *
+ * @param out Pointer to an array of in->i elements where the result is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param v Pointer to an array of in->j elements
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_Vector(double* out, const elem_t* in, const double* v);
+
+/**
+ * @brief Computes the action of the exponential of t times the sparse matrix pointed by in on a vector, exp(t*A)*v,
+ * with a truncated Taylor series and scaling, using only products of the matrix by vectors
+ *
+ * @param out Pointer to an array of in->i elements where the result is stored
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param t Time (multiplier of the matrix)
+ * @param v Pointer to an array of in->j elements
+ *
+ * @return 0 if errors occurred (also if the 1-norm of t*A is above INT_MAX, the number of steps)
+ */
+int expmvSparse(double* out, const elem_t* in, const double t, const double* v);
+
+/**
+ * @brief Sparse approximate inverse with static pattern: stores in the sparse matrix pointed by out the matrix M
+ * minimizing the Frobenius norm of M*A-I, where each row of M can have nonzeros only in the pattern of the same row of A^level
+ *
+ * Each row is a small dense least squares problem, the rows are solved in parallel when built with OpenMP. Elements
+ * below threshold in absolute value are then dropped (except the diagonal). Applying M is a product of the matrix
+ * by a vector.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param level Power of the matrix giving the pattern (at least 1)
+ * @param threshold Elements below this value are dropped
+ *
+ * @return 0 if errors occurred
+ */
+int spaiSparse(elem_t* out, const elem_t* in, const int level, const double threshold);
+
+/**
+ * @brief Factorized sparse approximate inverse of a symmetric positive definite matrix: stores in the sparse matrix
+ * pointed by out the lower triangular matrix G such that G*A*G' is close to the identity, so that G'*G approximates
+ * the inverse of A, where the row i of G has nonzeros only in the lower pattern of the same row of A^level
+ *
+ * Each row is a small dense linear system, the rows are solved in parallel when built with OpenMP.
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param level Power of the matrix giving the pattern (at least 1)
+ * @param threshold Elements below this value are dropped (except the diagonal)
+ *
+ * @return 0 if errors occurred
+ */
+int fsaiSparse(elem_t* out, const elem_t* in, const int level, const double threshold);
+
+/* Largest block factorized with a dense LU by blockSetupSparse, larger blocks use a sparse LU */
+#define BLOCK_DENSE_MAX 256
+
+/* Sparse LU factors of a block, defined in sparse.c */
+struct sparselu;
+
+/* Block Jacobi / additive Schwarz preconditioner built by blockSetupSparse */
+struct blockprec {
+	int n; //order of the matrix
+	int nblocks; //number of blocks
+	int* ptr; //offsets of the rows of each block into rows (nblocks+1 elements)
+	int* rows; //rows of each block, overlap included
+	long* offset; //offsets of the dense factors of each block into lu (nblocks+1 elements, none for sparse blocks)
+	double* lu; //dense LU factors of the blocks
+	int* piv; //pivot rows of the dense factors, with the same offsets of rows
+	struct sparselu** sparse; //sparse LU factors of the blocks larger than BLOCK_DENSE_MAX rows (NULL for dense blocks)
+};
+
+typedef struct blockprec blockprec_t;
+
+/**
+ * @brief Builds a block Jacobi (overlap 0) or additive Schwarz preconditioner of the square sparse matrix pointed by in,
+ * factorizing the submatrix of each block with a dense LU (up to BLOCK_DENSE_MAX rows) or a sparse LU
+ *
+ * Blocks are extracted and factorized in parallel when built with OpenMP.
+ *
+ * @param prec Pointer to the preconditioner to build, to release with blockFreeSparse
+ * @param in Pointer to the first element of the square sparse matrix
+ * @param start Pointer to an array of nblocks+1 elements, block b starts at row start[b] and ends before start[b+1]
+ * @param nblocks Number of blocks
+ * @param overlap Number of levels of neighbouring rows added to each block
+ *
+ * @return 0 if errors occurred
+ */
+int blockSetupSparse(blockprec_t* prec, const elem_t* in, const int* start, const int nblocks, const int overlap);
+
+/**
+ * @brief Applies the preconditioner to a vector, summing the solutions of all the blocks
+ *
+ * Blocks are solved in parallel when built with OpenMP, their solutions are then summed in order.
+ *
+ * @param out Pointer to an array of prec->n elements where the result is stored
+ * @param prec Pointer to the preconditioner
+ * @param in Pointer to an array of prec->n elements
+ *
+ * @return 0 if errors occurred
+ */
+int blockApplySparse(double* out, const blockprec_t* prec, const double* in);
+
+/**
+ * @brief Releases the memory of the preconditioner
+ *
+ * @param prec Pointer to the preconditioner
+ *
+ * @return 0 if errors occurred
+ */
+int blockFreeSparse(blockprec_t* prec);
+
+/* Sparse QR factorization (R only) built by qrSparse */
+struct sparseqr {
+	int m; //number of rows of the matrix
+	int n; //number of columns of the matrix
+	int* perm; //original column of each column of R
+	int* len; //number of elements of each row of R
+	int** cols; //columns of the elements of each row of R
+	double** vals; //values of the elements of each row of R
+};
+
+typedef struct sparseqr sparseqr_t;
+
+/**
+ * @brief Sparse QR factorization of the sparse matrix pointed by in (with at least as many rows as columns),
+ * multifrontal with Householder reflections after ordering the columns to limit the fill of R
+ *
+ * The columns are ordered with approximate minimum degree on A'*A, in the style of COLAMD. The chains of columns
+ * of the column elimination tree with the same pattern in R (fundamental supernodes) share a dense front with the
+ * rows of A starting in them and the contribution blocks of their children, its Householder QR gives their rows of
+ * R and the contribution block for the parent. The fronts of a level of the tree are independent and are
+ * factorized in parallel with OpenMP.
+ * Q isn't stored, qrSolveSparse uses the matrix again to solve least squares problems.
+ *
+ * @param qr Pointer to the factorization to build, to release with qrFreeSparse
+ * @param in Pointer to the first element of the sparse matrix
+ *
+ * @return 0 if errors occurred
+ */
+int qrSparse(sparseqr_t* qr, const elem_t* in);
+
+/**
+ * @brief Solves the least squares problem min ||A*x-b|| with the factorization of A, using the corrected
+ * semi-normal equations R'*R*x = A'*b (one step of refinement), so any number of right hand sides can be solved
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param qr Pointer to the factorization of the matrix
+ * @param in Pointer to the first element of the factorized sparse matrix
+ * @param b Pointer to an array of in->i elements
+ *
+ * @return 0 if errors occurred (also if the matrix is rank deficient)
+ */
+int qrSolveSparse(double* x, const sparseqr_t* qr, const elem_t* in, const double* b);
+
+/**
+ * @brief Releases the memory of the factorization
+ *
+ * @param qr Pointer to the factorization
+ *
+ * @return 0 if errors occurred
+ */
+int qrFreeSparse(sparseqr_t* qr);
+
+/**
+ * @brief Multiplies the transpose of the sparse matrix pointed by in by a vector and stores the result in the vector pointed by out
+ *
+ * @param out Pointer to an array of in->j elements where the result is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param v Pointer to an array of in->i elements
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_VectorT(double* out, const elem_t* in, const double* v);
+
+/**
+ * @brief Solves min ||A*x-b|| with LSQR, using only products by the sparse matrix pointed by in and by its transpose
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests, ||A'*r|| <= tol*||A||*||r|| or (compatible systems)
+ * ||r|| <= tol*||b|| + tol*||A||*||x||
+ *
+ * @return 0 if errors occurred
+ */
+int lsqrSparse(double* x, const elem_t* in, const double* b, const int maxIter, const double tol);
+
+/**
+ * @brief Solves min ||A*x-b|| with LSMR, using only products by the sparse matrix pointed by in and by its transpose
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests, ||A'*r|| <= tol*||A||*||r|| or (compatible systems)
+ * ||r|| <= tol*||b|| + tol*||A||*||x||
+ *
+ * @return 0 if errors occurred
+ */
+int lsmrSparse(double* x, const elem_t* in, const double* b, const int maxIter, const double tol);
+
+/* Number of columns of the dense matrix processed at a time by multiplySparse_Dense and multiplySparse_DenseT */
+#define DENSE_TILE 64
+
+/**
+ * @brief Multiplies the sparse matrix pointed by in by a dense matrix of k columns and stores the result in the dense matrix pointed by out
+ *
+ * Rows of the result are computed in parallel with OpenMP, each one over tiles of DENSE_TILE columns.
+ *
+ * @param out Pointer to the in->i*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param x Pointer to the in->j*k elements of the dense matrix, by rows
+ * @param k Number of columns of the dense matrix
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_Dense(double* out, const elem_t* in, const double* x, const int k);
+
+/**
+ * @brief Multiplies the transpose of the sparse matrix pointed by in by a dense matrix of k columns and stores the result in the dense matrix pointed by out
+ *
+ * The elements are grouped by column, so the rows of the result are computed in parallel as in multiplySparse_Dense.
+ *
+ * @param out Pointer to the in->j*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param x Pointer to the in->i*k elements of the dense matrix, by rows
+ * @param k Number of columns of the dense matrix
+ *
+ * @return 0 if errors occurred
+ */
+int multiplySparse_DenseT(double* out, const elem_t* in, const double* x, const int k);
+
+/* Nonzeros per row of the sparse sign test matrix of svdSparse */
+#define SKETCH_DENSITY 8
+
+/**
+ * @brief Truncated singular value decomposition A ~ U*S*V' of the sparse matrix pointed by in with the randomized
+ * range finder: the range of A is sampled with a sparse sign sketch of k+oversample columns, refined with
+ * power iterations, and the small projected matrix is decomposed with one-sided Jacobi
+ *
+ * The n x l transpose of the projected matrix is first factorized with Gram-Schmidt, so the Jacobi sweeps only run
+ * on its l x l triangular factor, where l = k+oversample. The products by A and A' are parallel with OpenMP.
+ *
+ * @param u Pointer to the in->i*k elements of the left singular vectors, by rows
+ * @param s Pointer to the k singular values, in decreasing order
+ * @param v Pointer to the in->j*k elements of the right singular vectors, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param k Number of singular triplets
+ * @param oversample Number of additional random vectors (usually 5-10)
+ * @param power Number of power iterations (usually 1-3)
+ * @param seed Seed of the random generator
+ *
+ * @return 0 if errors occurred
+ */
+int svdSparse(double* u, double* s, double* v, const elem_t* in, const int k, const int oversample, const int power, const unsigned long seed);
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the product S*A, where S is a random sparse sign matrix with
+ * density nonzeros (+-1/sqrt(density)) per column (a CountSketch with density 1) that is generated by hashing and never stored
+ *
+ * The nonzeros of S are grouped by row and each row of S*A accumulates its rows of A (in parallel with OpenMP).
+ *
+ * @param out Pointer to the first element of the result sparse matrix (rows x in->j), out->value must contain the number of elements allocated
+ * @param in Pointer to the first element of the sparse matrix to sketch
+ * @param rows Number of rows of the sketch
+ * @param density Number of nonzeros of each column of S (at most rows)
+ * @param seed Seed of the sketch, the same seed gives the same S
+ *
+ * @return 0 if errors occurred
+ */
+int sketchSparse(elem_t* out, const elem_t* in, const int rows, const int density, const unsigned long seed);
+
+/**
+ * @brief Stores in the vector pointed by out the product S*v with the same S of sketchSparse (rows in parallel
+ * with OpenMP)
+ *
+ * @param out Pointer to an array of rows elements where the result is stored
+ * @param v Pointer to an array of m elements
+ * @param m Number of elements of v
+ * @param rows Number of rows of the sketch
+ * @param density Number of nonzeros of each column of S (at most rows)
+ * @param seed Seed of the sketch
+ *
+ * @return 0 if errors occurred
+ */
+int sketchSparse_Vector(double* out, const double* v, const int m, const int rows, const int density, const unsigned long seed);
+
+/**
+ * @brief Approximately solves min ||A*x-b|| with sketch and solve: min ||S*A*x-S*b|| is solved with qrSparse
+ *
+ * The solution isn't the one of the full problem, its residual is only within a factor (1+eps) of the optimal one,
+ * with eps decreasing as the sketch grows. lsqrSketchSparse uses the same sketch to solve the full problem.
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param rows Number of rows of the sketch (at least in->j, usually a few times more)
+ * @param density Number of nonzeros of each column of S
+ * @param seed Seed of the sketch
+ *
+ * @return 0 if errors occurred
+ */
+int lsqSketchSparse(double* x, const elem_t* in, const double* b, const int rows, const int density, const unsigned long seed);
+
+/**
+ * @brief Solves min ||A*x-b|| with sketch and precondition: R of the QR factorization of S*A (qrSparse) is the right
+ * preconditioner of LSQR, A*R^-1 is well conditioned so few iterations reach the solution of the full problem
+ *
+ * @param x Pointer to an array of in->j elements where the solution is stored
+ * @param in Pointer to the first element of the sparse matrix
+ * @param b Pointer to an array of in->i elements
+ * @param rows Number of rows of the sketch (at least in->j, usually a few times more)
+ * @param density Number of nonzeros of each column of S
+ * @param seed Seed of the sketch
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance of the stopping tests of lsqrSparse (on the preconditioned problem)
+ *
+ * @return 0 if errors occurred (also if S*A is rank deficient)
+ */
+int lsqrSketchSparse(double* x, const elem_t* in, const double* b, const int rows, const int density, const unsigned long seed, const int maxIter, const double tol);
+
+/* Aggregates maintained by an append-only matrix */
+#define STREAM_COLSUM 1
+#define STREAM_SKETCH 2
+
+/* Append-only sparse matrix stored as segments of rows, with the aggregates registered at initialization */
+struct stream {
+	int m; //number of rows appended so far
+	int n; //number of columns
+	int nsegments; //number of segments
+	elem_t** segments; //sparse matrixes of the segments (row indexes relative to the segment)
+	int* first; //first row of each segment
+	int aggregates; //STREAM_COLSUM and/or STREAM_SKETCH
+	double* colsum; //sums of the columns (n elements)
+	int sketchRows; //number of rows of the sketch
+	unsigned long seed; //seed of the sketch
+	double* sketch; //CountSketch S*A (sketchRows*n elements by rows), A'*A ~ (S*A)'*(S*A)
+};
+
+typedef struct stream stream_t;
+
+/**
+ * @brief Initializes an empty append-only matrix of n columns
+ *
+ * @param stream Pointer to the matrix to initialize, to release with streamFreeSparse
+ * @param n Number of columns
+ * @param aggregates Aggregates to maintain (STREAM_COLSUM, STREAM_SKETCH or both)
+ * @param sketchRows Number of rows of the sketch (used with STREAM_SKETCH)
+ * @param seed Seed of the sketch
+ *
+ * @return 0 if errors occurred
+ */
+int streamInitSparse(stream_t* stream, const int n, const int aggregates, const int sketchRows, const unsigned long seed);
+
+/**
+ * @brief Appends a segment of rows to the matrix, updating the aggregates with the new rows only, and optionally
+ * multiplies the new rows by a vector
+ *
+ * @param y Pointer to an array of rows->i elements where the product of the new rows by x is stored (can be NULL)
+ * @param stream Pointer to the matrix
+ * @param rows Pointer to the first element of the sparse matrix of the new rows (copied)
+ * @param x Pointer to an array of stream->n elements (can be NULL)
+ *
+ * @return 0 if errors occurred (also if an element is outside rows->i x stream->n, the matrix is then unchanged)
+ */
+int streamAppendSparse(double* y, stream_t* stream, const elem_t* rows, const double* x);
+
+/**
+ * @brief Multiplies the whole matrix by a vector
+ *
+ * @param y Pointer to an array of stream->m elements where the result is stored
+ * @param stream Pointer to the matrix
+ * @param x Pointer to an array of stream->n elements
+ *
+ * @return 0 if errors occurred
+ */
+int streamMultiplySparse(double* y, const stream_t* stream, const double* x);
+
+/**
+ * @brief Releases the memory of the matrix
+ *
+ * @param stream Pointer to the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int streamFreeSparse(stream_t* stream);
+
+/* Operations memoized by a result cache */
+#define CACHE_MULTIPLY 1
+#define CACHE_TRANSPOSE 2
+
+/* Result stored in a result cache */
+struct cacheentry {
+	int op; //CACHE_MULTIPLY or CACHE_TRANSPOSE
+	uint64_t key1; //content hash of the first operand
+	uint64_t key2; //content hash of the second operand (0 if unused)
+	elem_t* operand1; //canonical copy of the first operand, compared on a hit
+	elem_t* operand2; //canonical copy of the second operand (NULL if unused)
+	elem_t* result; //copy of the result
+	size_t bytes; //memory of the result and of the operands
+	unsigned long used; //time of the last use, for LRU eviction
+};
+
+/* Result cache of sparse operations keyed on the content of the operands, so a changed operand never hits a stale result */
+struct cache {
+	size_t budget; //maximum memory of the stored results and operands
+	size_t bytes; //memory of the stored results and operands
+	int nentries; //number of stored results
+	struct cacheentry* entries; //stored results
+	unsigned long clock; //counter of the uses
+	long hits; //number of results found in the cache
+	long misses; //number of results computed
+};
+
+typedef struct cache cache_t;
+
+/**
+ * @brief Initializes an empty result cache
+ *
+ * @param cache Pointer to the cache to initialize, to release with cacheFreeSparse
+ * @param budget Maximum memory (in bytes) of the stored results and their operands, least recently used results are evicted beyond it
+ *
+ * @return 0 if errors occurred
+ */
+int cacheInitSparse(cache_t* cache, const size_t budget);
+
+/**
+ * @brief Multiplies two sparse matrixes as multiplySparse_ESC does, reusing the result stored in the cache
+ * if the same operands were already multiplied
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param cache Pointer to the cache
+ * @param in1 Pointer to the first element of the first sparse matrix to multiply
+ * @param in2 Pointer to the first element of the second sparse matrix to multiply
+ *
+ * @return 0 if errors occurred
+ */
+int cacheMultiplySparse(elem_t* out, cache_t* cache, const elem_t* in1, const elem_t* in2);
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the transpose of the sparse matrix pointed by in, sorted,
+ * reusing the result stored in the cache if the same matrix was already transposed
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param cache Pointer to the cache
+ * @param in Pointer to the first element of the sparse matrix to transpose
+ *
+ * @return 0 if errors occurred
+ */
+int cacheTransposeSparse(elem_t* out, cache_t* cache, const elem_t* in);
+
+/**
+ * @brief Releases the memory of the cache
+ *
+ * @param cache Pointer to the cache
+ *
+ * @return 0 if errors occurred
+ */
+int cacheFreeSparse(cache_t* cache);
+
+/* Number of stripes of elements chained separately by hashSparse */
+#define HASH_STRIPES 64
+
+/**
+ * @brief Computes a hash of the sparse matrix that depends on the position of each value but not on the order in
+ * which the elements are stored: the elements are sorted (duplicates summed, zeros dropped) and chained in that order
+ *
+ * The sort and the chaining of the elements are parallel with OpenMP for large matrixes.
+ *
+ * @param hash Where to store the hash
+ * @param in Pointer to the first element of the sparse matrix
+ *
+ * @return 0 if errors occurred
+ */
+int hashSparse(uint64_t* hash, const elem_t* in);
+
+/**
+ * @brief Checks if two sparse matrixes have the same dimensions and the same elements (in any order), up to a tolerance,
+ * stopping at the first difference
+ *
+ * An element present in only one of the matrixes is compared with 0, and NaN is never equal to anything. Sorted
+ * matrixes are merged in one pass, unsorted ones through sorted copies (sorted in parallel for large matrixes).
+ *
+ * @param equal Where to store 1 if the matrixes are equal, 0 otherwise
+ * @param in1 Pointer to the first element of the first sparse matrix
+ * @param in2 Pointer to the first element of the second sparse matrix
+ * @param tol Largest absolute difference between equal elements
+ *
+ * @return 0 if errors occurred
+ */
+int equalSparse(int* equal, const elem_t* in1, const elem_t* in2, const double tol);
+
+/* Block of rows shared by copy-on-write matrixes, reference counted with atomics inside sparse.c */
+struct sharedblock;
+
+/* Copy-on-write sparse matrix: copies share the blocks of rows, a block is duplicated only when a copy writes it */
+struct shared {
+	int m; //number of rows
+	int n; //number of columns
+	int blockRows; //number of rows of each block
+	int nblocks; //number of blocks
+	struct sharedblock** blocks; //blocks of rows
+};
+
+typedef struct shared shared_t;
+
+/**
+ * @brief Builds a copy-on-write matrix from the sparse matrix pointed by in, split in blocks of rows
+ *
+ * @param out Pointer to the matrix to build, to release with shareFreeSparse
+ * @param in Pointer to the first element of the sparse matrix (copied)
+ * @param blockRows Number of rows of each block
+ *
+ * @return 0 if errors occurred
+ */
+int shareCreateSparse(shared_t* out, const elem_t* in, const int blockRows);
+
+/**
+ * @brief Makes a copy of the copy-on-write matrix sharing all its blocks, in time proportional to the number of blocks
+ *
+ * Copies can be used and released by different threads, but a single copy must not be used by two threads at the same time.
+ *
+ * @param out Pointer to the copy, to release with shareFreeSparse
+ * @param in Pointer to the matrix to copy
+ *
+ * @return 0 if errors occurred
+ */
+int shareCopySparse(shared_t* out, const shared_t* in);
+
+/**
+ * @brief Sets the element (i,j) of the copy-on-write matrix, duplicating first its block of rows if it is shared
+ *
+ * @param matrix Pointer to the matrix
+ * @param i Row of the element
+ * @param j Column of the element
+ * @param value New value of the element
+ *
+ * @return 0 if errors occurred
+ */
+int shareSetSparse(shared_t* matrix, const int i, const int j, const double value);
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the elements of the copy-on-write matrix
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param in Pointer to the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int shareGetSparse(elem_t* out, const shared_t* in);
+
+/**
+ * @brief Releases the copy-on-write matrix, blocks are freed when no other copy uses them
+ *
+ * @param matrix Pointer to the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int shareFreeSparse(shared_t* matrix);
+
+/* Value of an assembly target, its atomic type is private to sparse.c */
+struct atomicvalue;
+
+/* Preallocated sparsity pattern that many threads can add into at the same time without locks */
+struct assembly {
+	int m; //number of rows
+	int n; //number of columns
+	int* ptr; //offsets of the rows into cols and values (m+1 elements)
+	int* cols; //sorted columns of each row
+	struct atomicvalue* values; //values of the elements, atomic inside sparse.c (read them with assemblyGetSparse)
+};
+
+typedef struct assembly assembly_t;
+
+/**
+ * @brief Builds an assembly target with the pattern of the sparse matrix pointed by pattern, with all values 0
+ *
+ * @param out Pointer to the assembly target to build, to release with assemblyFreeSparse
+ * @param pattern Pointer to the first element of the sparse matrix giving the pattern (values are ignored)
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyInitSparse(assembly_t* out, const elem_t* pattern);
+
+/**
+ * @brief Adds value to the element (i,j) of the assembly target, found with a binary search in its row and updated
+ * with an atomic compare and swap, so any number of threads can call it at the same time
+ *
+ * @param assembly Pointer to the assembly target
+ * @param i Row of the element
+ * @param j Column of the element
+ * @param value Value to add
+ *
+ * @return 0 if errors occurred (also if (i,j) isn't in the pattern)
+ */
+int assemblyAddSparse(assembly_t* assembly, const int i, const int j, const double value);
+
+/**
+ * @brief Sets to 0 all the values of the assembly target, keeping the pattern
+ *
+ * @param assembly Pointer to the assembly target
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyResetSparse(assembly_t* assembly);
+
+/**
+ * @brief Stores in the sparse matrix pointed by out the elements of the assembly target, sorted
+ *
+ * @param out Pointer to the first element of the result sparse matrix, out->value must contain the number of elements allocated
+ * @param assembly Pointer to the assembly target
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyGetSparse(elem_t* out, const assembly_t* assembly);
+
+/**
+ * @brief Releases the memory of the assembly target
+ *
+ * @param assembly Pointer to the assembly target
+ *
+ * @return 0 if errors occurred
+ */
+int assemblyFreeSparse(assembly_t* assembly);
+
+/**
+ * @brief Colors mesh elements so that no two elements of the same color share a row (greedy, smallest free color)
+ *
+ * Elements of the same color can then be assembled at the same time with assemblyElementSparse without atomics.
+ *
+ * @param color Pointer to an array of nelem elements where the color of each element is stored
+ * @param ncolors Where to store the number of colors
+ * @param elemPtr Pointer to an array of nelem+1 offsets of the rows of each element into elemRows
+ * @param elemRows Pointer to the rows of each element
+ * @param nelem Number of elements
+ * @param m Number of rows of the matrix
+ *
+ * @return 0 if errors occurred
+ */
+int colorElementsSparse(int* color, int* ncolors, const int* elemPtr, const int* elemRows, const int nelem, const int m);
+
+/**
+ * @brief Adds the dense matrix of a mesh element to the assembly target, at the rows and columns listed in rows
+ *
+ * With atomic 0 the values are updated without atomic read-modify-write, which is safe only if no other thread
+ * is updating the same rows at the same time (e.g. elements of the same color of colorElementsSparse).
+ *
+ * @param assembly Pointer to the assembly target
+ * @param rows Pointer to the nrows rows (and columns) of the element
+ * @param nrows Number of rows of the element
+ * @param values Pointer to the nrows*nrows values of the element matrix, by rows
+ * @param atomic If not 0 each value is added with assemblyAddSparse
+ *
+ * @return 0 if errors occurred (also if an element isn't in the pattern)
+ */
+int assemblyElementSparse(assembly_t* assembly, const int* rows, const int nrows, const double* values, const int atomic);
+
+/* Sparse tensor of any order, stored by coordinates */
+struct tensor {
+	int order; //number of modes
+	int* dims; //size of each mode
+	int nnz; //number of elements
+	int cap; //number of elements allocated
+	int* ind; //coordinates of the elements, order of them for each element
+	double* values; //values of the elements
+};
+
+typedef struct tensor tensor_t;
+
+/* Sparse tensor in compressed sparse fiber format, built by csfSparse */
+struct csf {
+	int order; //number of modes
+	int* dims; //size of each mode
+	int* modes; //mode stored at each level, from the root
+	int* nnodes; //number of nodes of each level (the leaves are the elements)
+	int** ptr; //first child of each node of each level but the last, nnodes[level]+1 offsets
+	int** ind; //coordinate of each node of each level
+	double* values; //values of the leaves
+};
+
+typedef struct csf csf_t;
+
+/**
+ * @brief Initializes an empty sparse tensor
+ *
+ * @param out Pointer to the tensor to initialize, to release with tensorFreeSparse
+ * @param order Number of modes
+ * @param dims Pointer to the size of each mode
+ * @param cap Number of elements to allocate (the tensor grows when needed)
+ *
+ * @return 0 if errors occurred
+ */
+int tensorInitSparse(tensor_t* out, const int order, const int* dims, const int cap);
+
+/**
+ * @brief Appends an element to the sparse tensor, duplicates are summed by csfSparse
+ *
+ * @param tensor Pointer to the tensor
+ * @param index Pointer to the order coordinates of the element
+ * @param value Value of the element
+ *
+ * @return 0 if errors occurred
+ */
+int tensorAppendSparse(tensor_t* tensor, const int* index, const double value);
+
+/**
+ * @brief Releases the memory of the sparse tensor
+ *
+ * @param tensor Pointer to the tensor
+ *
+ * @return 0 if errors occurred
+ */
+int tensorFreeSparse(tensor_t* tensor);
+
+/**
+ * @brief Builds the compressed sparse fiber form of the sparse tensor pointed by in, summing duplicated elements
+ *
+ * @param out Pointer to the tensor to build, to release with csfFreeSparse
+ * @param in Pointer to the sparse tensor
+ * @param modes Pointer to the mode of each level from the root, if NULL modes are sorted by increasing size
+ *
+ * @return 0 if errors occurred
+ */
+int csfSparse(csf_t* out, const tensor_t* in, const int* modes);
+
+/**
+ * @brief Releases the memory of the compressed sparse fiber tensor
+ *
+ * @param tensor Pointer to the tensor
+ *
+ * @return 0 if errors occurred
+ */
+int csfFreeSparse(csf_t* tensor);
+
+/**
+ * @brief Matricized tensor times Khatri-Rao product along a mode: out(i,:) is the sum over the elements with
+ * coordinate i in mode of value times the element-wise product of the rows of the factors of the other modes
+ *
+ * Root fibers are processed in parallel with OpenMP, each thread accumulating in its own copy of the result
+ * (summed at the end) unless mode is the mode of the root.
+ *
+ * @param out Pointer to the dims[mode]*rank result, by rows
+ * @param in Pointer to the compressed sparse fiber tensor
+ * @param factors Pointer to the dims[m]*rank factor of each mode m, by rows (the one of mode isn't used)
+ * @param rank Number of columns of the factors
+ * @param mode Mode of the result
+ *
+ * @return 0 if errors occurred
+ */
+int mttkrpSparse(double* out, const csf_t* in, double* const* factors, const int rank, const int mode);
+
+/**
+ * @brief Tensor times vector along a mode, the result has one mode less (mode is removed, the others keep their order)
+ *
+ * The products of the leaves are computed in parallel with OpenMP over the root fibers, then sorted and summed.
+ *
+ * @param out Pointer to the sparse tensor to build, to release with tensorFreeSparse
+ * @param in Pointer to the compressed sparse fiber tensor, of order at least 2
+ * @param v Pointer to the vector of dims[mode] elements
+ * @param mode Mode to contract
+ *
+ * @return 0 if errors occurred
+ */
+int ttvSparse(tensor_t* out, const csf_t* in, const double* v, const int mode);
+
+/**
+ * @brief Generates a random sparse tensor with uniformly distributed coordinates and values in (0,1]
+ * (duplicated coordinates are possible, csfSparse sums them)
+ *
+ * @param out Pointer to the tensor to build, to release with tensorFreeSparse
+ * @param order Number of modes
+ * @param dims Pointer to the size of each mode
+ * @param nnz Number of elements to generate
+ * @param seed Seed of the random generator
+ *
+ * @return 0 if errors occurred
+ */
+int randomTensorSparse(tensor_t* out, const int order, const int* dims, const int nnz, const unsigned long seed);
+
+/**
+ * @brief CP decomposition of a sparse tensor with alternating least squares: each factor is updated with
+ * mttkrpSparse and a rank*rank dense solve with the Hadamard product of the Gram matrices of the other factors
+ *
+ * Columns of the factors are normalized, their norms are stored in lambda. Iterations stop when the fit changes less than tol.
+ *
+ * @param factors Pointer to the dims[m]*rank factor of each mode m, by rows, initialized randomly
+ * @param lambda Pointer to an array of rank elements where the weights of the components are stored
+ * @param fit Where to store the fit 1-||X-Xhat||/||X|| reached (may be NULL)
+ * @param modeTime Pointer to an array of order elements where the elapsed seconds spent on each mode are stored (may be NULL)
+ * @param in Pointer to the compressed sparse fiber tensor
+ * @param rank Number of components
+ * @param maxIter Maximum number of iterations
+ * @param tol Tolerance on the change of the fit
+ * @param seed Seed of the random initialization
+ *
+ * @return 0 if errors occurred
+ */
+int cpalsSparse(double** factors, double* lambda, double* fit, double* modeTime, const csf_t* in, const int rank, const int maxIter, const double tol, const unsigned long seed);
+
+/* Normalizations of the adjacency matrix applied by gnnMultiplySparse */
+#define GNN_NONE 0 //A
+#define GNN_ROW 1 //D^-1 A, D row sums
+#define GNN_SYM 2 //D^-1/2 A E^-1/2, D row sums and E column sums
+
+/* Number of feature columns processed at a time by gnnMultiplySparse */
+#define GNN_TILE 64
+
+/**
+ * @brief Multiplies the normalized sparse matrix pointed by in by the dense feature matrix h of k columns
+ * (aggregation of a graph neural network layer), the normalization is applied on the fly
+ *
+ * Rows of the result are computed in parallel with OpenMP, each one over tiles of GNN_TILE features: the elements
+ * of the row are read once per tile and the tile of the result row stays in cache.
+ *
+ * @param out Pointer to the in->i*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param h Pointer to the in->j*k elements of the feature matrix, by rows
+ * @param k Number of features
+ * @param norm Normalization: GNN_NONE, GNN_ROW or GNN_SYM
+ *
+ * @return 0 if errors occurred
+ */
+int gnnMultiplySparse(double* out, const elem_t* in, const double* h, const int k, const int norm);
+
+/**
+ * @brief Multiplies the transpose of the normalized sparse matrix pointed by in by the dense gradient g of k columns
+ * (backward pass of gnnMultiplySparse), without building the transpose
+ *
+ * @param out Pointer to the in->j*k elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix
+ * @param g Pointer to the in->i*k elements of the gradient, by rows
+ * @param k Number of features
+ * @param norm Normalization used in the forward pass: GNN_NONE, GNN_ROW or GNN_SYM
+ *
+ * @return 0 if errors occurred
+ */
+int gnnMultiplySparseT(double* out, const elem_t* in, const double* g, const int k, const int norm);
+
+/**
+ * @brief Sparse attention restricted to the pattern of the sparse matrix pointed by in: for each row i the scores
+ * scale*q(i,:).k(j,:) of its elements (SDDMM) go through a softmax over the row and weight the rows v(j,:) (SpMM)
+ *
+ * The three steps are fused one row at a time, rows in parallel with OpenMP, the scores of the row are kept in a
+ * buffer of the thread. Values of the pattern are ignored, rows without elements give zero rows.
+ *
+ * @param out Pointer to the in->i*dv elements of the result matrix, by rows
+ * @param in Pointer to the first element of the sparse matrix giving the pattern
+ * @param q Pointer to the in->i*d elements of the queries, by rows
+ * @param k Pointer to the in->j*d elements of the keys, by rows
+ * @param v Pointer to the in->j*dv elements of the values, by rows
+ * @param d Number of columns of queries and keys
+ * @param dv Number of columns of the values
+ * @param scale Factor of the scores (usually 1/sqrt(d))
+ *
+ * @return 0 if errors occurred
+ */
+int attentionSparse(double* out, const elem_t* in, const double* q, const double* k, const double* v, const int d, const int dv, const double scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file test_accumulate.c
+ * @brief Tests of accumulateMultiplySparse
+ *
+ * gcc -std=c11 -I.. test_accumulate.c ../sparse.c -lm -o test_accumulate && ./test_accumulate
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+//products below INFVALUE are kept before being scaled
+static int testSmallProducts(void) {
+
+	elem_t c[3] = {{2, 2, 1}, {0, 0, 5}};
+	elem_t a[2] = {{2, 2, 1}, {0, 1, 0.01}};
+	elem_t b[2] = {{2, 2, 1}, {1, 0, 0.01}};
+
+	if (!accumulateMultiplySparse(c, 2, a, b, 1000)) {
+		return 0;
+	}
+
+	return c->value == 1 && fabs(c[1].value-5.1) < 1e-12;
+}
+
+//random matrixes against dense products, with new elements appended
+static int testRandom(void) {
+
+	int m = 17;
+	int k = 13;
+	int n = 11;
+	double* a = calloc(m*k, sizeof(double));
+	double* b = calloc(k*n, sizeof(double));
+	double* c = calloc(m*n, sizeof(double));
+	elem_t* sa = malloc((m*k+1)*sizeof(elem_t));
+	elem_t* sb = malloc((k*n+1)*sizeof(elem_t));
+	elem_t* sc = malloc((m*n+1)*sizeof(elem_t));
+
+	srand(3);
+	for (int x = 0; x < m*k; x++) {
+		a[x] = rand()%4 == 0 ? (rand()%100)/1000.0 : 0;
+	}
+	for (int x = 0; x < k*n; x++) {
+		b[x] = rand()%4 == 0 ? (rand()%100)/1000.0 : 0;
+	}
+	for (int x = 0; x < m*n; x++) {
+		c[x] = rand()%6 == 0 ? 1 : 0;
+	}
+	sa->value = m*k;
+	sb->value = k*n;
+	sc->value = m*n;
+	generateSparse(sa, a, m, k);
+	generateSparse(sb, b, k, n);
+	generateSparse(sc, c, m, n);
+
+	int ok = accumulateMultiplySparse(sc, m*n, sa, sb, -2);
+	for (int i = 0; i < m; i++) {
+		for (int l = 0; l < k; l++) {
+			for (int j = 0; j < n; j++) {
+				c[i*n+j] -= 2*a[i*k+l]*b[l*n+j];
+			}
+		}
+	}
+	for (int e = 1; ok && e <= (int) sc->value; e++) {
+		c[sc[e].i*n+sc[e].j] -= sc[e].value;
+	}
+	for (int x = 0; ok && x < m*n; x++) {
+		ok = fabs(c[x]) < 1e-12;
+	}
+
+	free(a);
+	free(b);
+	free(c);
+	free(sa);
+	free(sb);
+	free(sc);
+
+	return ok;
+}
+
+//out isn't modified when new elements don't fit
+static int testNoRoom(void) {
+
+	elem_t c[2] = {{2, 2, 1}, {0, 0, 5}};
+	elem_t a[2] = {{2, 2, 1}, {1, 0, 1}};
+	elem_t b[2] = {{2, 2, 1}, {0, 1, 1}};
+
+	return !accumulateMultiplySparse(c, 1, a, b, 1) && c->value == 1 && c[1].value == 5;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testSmallProducts()) {
+		printf("testSmallProducts failed\n");
+		failed++;
+	}
+	if (!testRandom()) {
+		printf("testRandom failed\n");
+		failed++;
+	}
+	if (!testNoRoom()) {
+		printf("testNoRoom failed\n");
+		failed++;
+	}
+
+	return failed;
+}
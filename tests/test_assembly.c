@@ -0,0 +1,122 @@
+/**
+ * @file test_assembly.c
+ * @brief Tests of the assembly target (assemblyAddSparse, assemblyElementSparse, colorElementsSparse)
+ *
+ * gcc -std=c11 -fopenmp -I.. test_assembly.c ../sparse.c -lm -o test_assembly && ./test_assembly
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Concurrent adds (with OpenMP) into the same elements are all kept, elements outside the pattern are refused
+ */
+static int testConcurrentAdd(void) {
+
+	elem_t pattern[6] = {{4, 4, 5}, {0, 0, 1}, {1, 1, 2}, {2, 2, 3}, {3, 3, 4}, {0, 1, 0}};
+	elem_t out[6];
+	assembly_t assembly;
+	int ok = assemblyInitSparse(&assembly, pattern);
+
+#ifdef _OPENMP
+	#pragma omp parallel for
+#endif
+	for (int it = 0; it < 400000; it++) {
+		assemblyAddSparse(&assembly, it%4, it%4, 1);
+		assemblyAddSparse(&assembly, 0, 1, 0.5);
+	}
+
+	out->value = 5;
+	ok = ok && assemblyGetSparse(out, &assembly) && !assemblyAddSparse(&assembly, 2, 3, 1);
+	for (int k = 0; ok && k < (int) out->value; k++) {
+		ok = out[k+1].value == (out[k+1].i == out[k+1].j ? 100000 : 200000);
+	}
+
+	assemblyFreeSparse(&assembly);
+	return ok;
+}
+
+/**
+ * @brief Colored assembly without atomics gives the same matrix as atomic assembly on a 1D mesh
+ */
+static int testColored(void) {
+
+	int nelem = 50;
+	int m = nelem+1;
+	int* ptr = malloc((nelem+1)*sizeof(int));
+	int* rows = malloc(2*nelem*sizeof(int));
+	int* color = malloc(nelem*sizeof(int));
+	elem_t* pattern = malloc((3*m+1)*sizeof(elem_t));
+	elem_t* out = malloc((3*m+1)*sizeof(elem_t));
+	for (int e = 0; e < nelem; e++) {
+		ptr[e] = 2*e;
+		rows[2*e] = e;
+		rows[2*e+1] = e+1;
+	}
+	ptr[nelem] = 2*nelem;
+	int len = 0;
+	for (int i = 0; i < m; i++) {
+		for (int j = i-1; j <= i+1; j++) {
+			if (j >= 0 && j < m) {
+				len++;
+				pattern[len] = (elem_t) {i, j, 0};
+			}
+		}
+	}
+	pattern->i = m;
+	pattern->j = m;
+	pattern->value = len;
+
+	int ncolors;
+	double ke[4] = {1, -1, -1, 1};
+	assembly_t colored;
+	assembly_t atomic;
+	int ok = colorElementsSparse(color, &ncolors, ptr, rows, nelem, m) && ncolors == 2
+			&& assemblyInitSparse(&colored, pattern) && assemblyInitSparse(&atomic, pattern);
+	for (int c = 0; ok && c < ncolors; c++) {
+		for (int e = 0; e < nelem; e++) {
+			if (color[e] == c) {
+				ok = ok && assemblyElementSparse(&colored, rows+ptr[e], 2, ke, 0);
+			}
+		}
+	}
+	for (int e = 0; ok && e < nelem; e++) {
+		ok = assemblyElementSparse(&atomic, rows+ptr[e], 2, ke, 1);
+	}
+
+	int equal;
+	out->value = 3*m;
+	ok = ok && assemblyGetSparse(out, &colored);
+	elem_t* expected = pattern;
+	for (int k = 0; ok && k < len; k++) {
+		int i = expected[k+1].i;
+		int j = expected[k+1].j;
+		expected[k+1].value = (i != j ? -1 : (i == 0 || i == m-1 ? 1 : 2));
+	}
+	ok = ok && equalSparse(&equal, out, expected, 0) && equal;
+	out->value = 3*m;
+	ok = ok && assemblyGetSparse(out, &atomic) && equalSparse(&equal, out, expected, 0) && equal;
+
+	assemblyFreeSparse(&colored);
+	assemblyFreeSparse(&atomic);
+	free(ptr);
+	free(rows);
+	free(color);
+	free(pattern);
+	free(out);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testConcurrentAdd()) {
+		printf("testConcurrentAdd failed\n");
+		failed++;
+	}
+	if (!testColored()) {
+		printf("testColored failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file test_block.c
+ * @brief Tests of blockSetupSparse and blockApplySparse
+ *
+ * gcc -std=c11 -I.. test_block.c ../sparse.c -lm -o test_block && ./test_block
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Nonsymmetric 2D operator on a g*g grid, with zeros on some diagonal elements so that LU has to pivot
+ */
+static elem_t* gridMatrix(const int g) {
+
+	int n = g*g;
+	elem_t* a = malloc((5*n+1)*sizeof(elem_t));
+	int nnz = 0;
+	for (int v = 0; v < n; v++) {
+		a[++nnz] = (elem_t) {v, v, v%7 == 0 ? 0 : 4+v%3};
+		if (v%g > 0) {
+			a[++nnz] = (elem_t) {v, v-1, -1.5};
+		}
+		if (v%g < g-1) {
+			a[++nnz] = (elem_t) {v, v+1, -1};
+		}
+		if (v >= g) {
+			a[++nnz] = (elem_t) {v, v-g, -1};
+		}
+		if (v < n-g) {
+			a[++nnz] = (elem_t) {v, v+g, -0.5};
+		}
+	}
+	a->i = n;
+	a->j = n;
+	a->value = nnz;
+
+	return a;
+}
+
+//a single block is an exact solve, both with the sparse LU (large block) and the dense one (small block)
+static int testExactSolve(void) {
+
+	int ok = 1;
+	int sizes[2] = {30, 12};
+	for (int s = 0; ok && s < 2; s++) {
+		int n = sizes[s]*sizes[s];
+		elem_t* a = gridMatrix(sizes[s]);
+		double* x = malloc(n*sizeof(double));
+		double* y = malloc(n*sizeof(double));
+		double* z = malloc(n*sizeof(double));
+		int start[2] = {0, n};
+		blockprec_t prec;
+
+		for (int v = 0; v < n; v++) {
+			x[v] = sin(v);
+		}
+		ok = blockSetupSparse(&prec, a, start, 1, 0) && (prec.sparse[0] != NULL) == (n > BLOCK_DENSE_MAX)
+				&& blockApplySparse(y, &prec, x) && multiplySparse_Vector(z, a, y);
+		for (int v = 0; ok && v < n; v++) {
+			ok = fabs(z[v]-x[v]) < 1e-10;
+		}
+
+		blockFreeSparse(&prec);
+		free(a);
+		free(x);
+		free(y);
+		free(z);
+	}
+
+	return ok;
+}
+
+//blocks factorized sparse and dense give the solutions of their submatrixes
+static int testSparseDense(void) {
+
+	int g = 20;
+	int n = g*g;
+	elem_t* a = gridMatrix(g);
+	double* x = malloc(n*sizeof(double));
+	double* y = malloc(n*sizeof(double));
+	double* z = calloc(n, sizeof(double));
+	int start[3] = {0, 300, n};
+	blockprec_t prec;
+
+	for (int v = 0; v < n; v++) {
+		x[v] = cos(v);
+	}
+	int ok = blockSetupSparse(&prec, a, start, 2, 1) && blockApplySparse(y, &prec, x);
+	ok = ok && prec.sparse[0] != NULL && prec.sparse[1] == NULL;
+
+	//sum of the solutions of the overlapped blocks, solved apart
+	for (int b = 0; ok && b < 2; b++) {
+		int* rows = prec.rows+prec.ptr[b];
+		int len = prec.ptr[b+1]-prec.ptr[b];
+		int* pos = malloc(n*sizeof(int));
+		elem_t* sub = malloc((a->value+1)*sizeof(elem_t));
+		double* local = malloc(len*sizeof(double));
+		int nnz = 0;
+		for (int v = 0; v < n; v++) {
+			pos[v] = -1;
+		}
+		for (int p = 0; p < len; p++) {
+			pos[rows[p]] = p;
+			local[p] = x[rows[p]];
+		}
+		for (int e = 1; e <= (int) a->value; e++) {
+			if (pos[a[e].i] >= 0 && pos[a[e].j] >= 0) {
+				sub[++nnz] = (elem_t) {pos[a[e].i], pos[a[e].j], a[e].value};
+			}
+		}
+		sub->i = len;
+		sub->j = len;
+		sub->value = nnz;
+
+		//reference: Gaussian elimination with partial pivoting of the block
+		double* dense = calloc((long) len*len, sizeof(double));
+		for (int e = 1; e <= nnz; e++) {
+			dense[(long) sub[e].i*len+sub[e].j] += sub[e].value;
+		}
+		for (int c = 0; c < len; c++) {
+			int p = c;
+			for (int r = c+1; r < len; r++) {
+				if (fabs(dense[(long) r*len+c]) > fabs(dense[(long) p*len+c])) {
+					p = r;
+				}
+			}
+			for (int k = 0; k < len; k++) {
+				double tmp = dense[(long) c*len+k];
+				dense[(long) c*len+k] = dense[(long) p*len+k];
+				dense[(long) p*len+k] = tmp;
+			}
+			double tmp = local[c];
+			local[c] = local[p];
+			local[p] = tmp;
+			for (int r = c+1; r < len; r++) {
+				double f = dense[(long) r*len+c]/dense[(long) c*len+c];
+				for (int k = c; k < len; k++) {
+					dense[(long) r*len+k] -= f*dense[(long) c*len+k];
+				}
+				local[r] -= f*local[c];
+			}
+		}
+		for (int r = len-1; r >= 0; r--) {
+			for (int k = r+1; k < len; k++) {
+				local[r] -= dense[(long) r*len+k]*local[k];
+			}
+			local[r] /= dense[(long) r*len+r];
+		}
+		for (int p = 0; p < len; p++) {
+			z[rows[p]] += local[p];
+		}
+
+		free(pos);
+		free(sub);
+		free(local);
+		free(dense);
+	}
+	for (int v = 0; ok && v < n; v++) {
+		ok = fabs(z[v]-y[v]) < 1e-10;
+	}
+
+	blockFreeSparse(&prec);
+	free(a);
+	free(x);
+	free(y);
+	free(z);
+
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testExactSolve()) {
+		printf("testExactSolve failed\n");
+		failed++;
+	}
+	if (!testSparseDense()) {
+		printf("testSparseDense failed\n");
+		failed++;
+	}
+
+	return failed;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file test_cache.c
+ * @brief Tests of the result cache (cacheMultiplySparse, cacheTransposeSparse), of hashSparse and of equalSparse
+ *
+ * gcc -std=c11 -fopenmp -I.. test_cache.c ../sparse.c -lm -o test_cache && ./test_cache
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Same operands with the elements in another order hit the stored result
+ */
+static int testHit(void) {
+
+	elem_t a[4] = {{2, 2, 3}, {0, 0, 1}, {1, 1, 2}, {0, 1, 4}};
+	elem_t b[4] = {{2, 2, 3}, {0, 1, 4}, {1, 1, 2}, {0, 0, 1}};
+	elem_t out[6];
+
+	cache_t cache;
+	cacheInitSparse(&cache, 1 << 20);
+	out->value = 5;
+	int ok = cacheMultiplySparse(out, &cache, a, a);
+	out->value = 5;
+	ok = ok && cacheMultiplySparse(out, &cache, b, b) && cache.hits == 1 && cache.misses == 1;
+	out->value = 5;
+	ok = ok && cacheTransposeSparse(out, &cache, a);
+	out->value = 5;
+	ok = ok && cacheTransposeSparse(out, &cache, b) && cache.hits == 2 && cache.misses == 2;
+	cacheFreeSparse(&cache);
+
+	return ok;
+}
+
+/**
+ * @brief A stored entry with the hashes of other operands (a collision) isn't returned for them
+ */
+static int testCollision(void) {
+
+	elem_t a[3] = {{2, 2, 2}, {0, 0, 1}, {1, 1, 1}};
+	elem_t c[3] = {{2, 2, 2}, {0, 0, 5}, {1, 1, 7}};
+	elem_t out[4];
+
+	cache_t cache;
+	cacheInitSparse(&cache, 1 << 20);
+	out->value = 3;
+	int ok = cacheMultiplySparse(out, &cache, a, a);
+
+	//the entry of a*a now has the hashes of c*c
+	uint64_t key;
+	ok = ok && hashSparse(&key, c) && cache.nentries == 1;
+	cache.entries[0].key1 = key;
+	cache.entries[0].key2 = key;
+
+	out->value = 3;
+	ok = ok && cacheMultiplySparse(out, &cache, c, c) && cache.hits == 0 && cache.misses == 2;
+	for (int k = 0; ok && k < (int) out->value; k++) {
+		ok = out[k+1].value == (out[k+1].i == 0 ? 25 : 49);
+	}
+	cacheFreeSparse(&cache);
+
+	return ok;
+}
+
+/**
+ * @brief The hash ignores the order of the elements, duplicates and zeros, but not values moved to other positions
+ */
+static int testHash(void) {
+
+	elem_t a[4] = {{3, 3, 3}, {0, 0, 1}, {1, 1, 2}, {2, 2, 3}};
+	elem_t same[6] = {{3, 3, 5}, {2, 2, 3}, {1, 1, 1.5}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0.5}};
+	elem_t moved[4] = {{3, 3, 3}, {0, 0, 2}, {1, 1, 1}, {2, 2, 3}};
+
+	uint64_t ha;
+	uint64_t hs;
+	uint64_t hm;
+	int ok = hashSparse(&ha, a) && hashSparse(&hs, same) && hashSparse(&hm, moved);
+
+	return ok && ha == hs && ha != hm;
+}
+
+/**
+ * @brief NaN is never equal, not even to NaN, sorted and unsorted operands give the same answer
+ */
+static int testEqualNaN(void) {
+
+	elem_t a[3] = {{2, 2, 2}, {0, 0, 1}, {1, 1, 2}};
+	elem_t b[3] = {{2, 2, 2}, {0, 0, NAN}, {1, 1, 2}};
+	elem_t c[3] = {{2, 2, 2}, {1, 1, 2}, {0, 0, NAN}};
+
+	int e1;
+	int e2;
+	int e3;
+	int e4;
+	int ok = equalSparse(&e1, a, b, 1) && equalSparse(&e2, b, a, 1) && equalSparse(&e3, b, b, 1)
+			&& equalSparse(&e4, a, c, 1);
+
+	return ok && !e1 && !e2 && !e3 && !e4;
+}
+
+/**
+ * @brief A matrix large enough to be sorted and hashed in parallel gives the same hash and compares equal in any
+ * order of its elements, and a single changed value changes both
+ */
+static int testLarge(void) {
+
+	srand(13);
+	int nnz = 200000;
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	elem_t* b = malloc((nnz+1)*sizeof(elem_t));
+	for (int e = 0; e < nnz; e++) {
+		a[e+1] = (elem_t) {e/40, (e%40)*997 + rand()%997, rand()%1000 + 1};
+	}
+	a->i = nnz/40;
+	a->j = 40*997;
+	a->value = nnz;
+
+	//b is a shuffled copy of a
+	for (int e = 0; e <= nnz; e++) {
+		b[e] = a[e];
+	}
+	for (int e = nnz-1; e > 0; e--) {
+		int r = rand() % (e+1);
+		elem_t tmp = b[e+1];
+		b[e+1] = b[r+1];
+		b[r+1] = tmp;
+	}
+
+	uint64_t ha;
+	uint64_t hb;
+	int equal;
+	int ok = hashSparse(&ha, a) && hashSparse(&hb, b) && ha == hb && equalSparse(&equal, a, b, 0) && equal;
+
+	//sorting b gives back a
+	ok = ok && sortSparse(b);
+	for (int e = 1; ok && e <= nnz; e++) {
+		ok = b[e].i == a[e].i && b[e].j == a[e].j && b[e].value == a[e].value;
+	}
+
+	b[nnz/2].value += 1;
+	ok = ok && hashSparse(&hb, b) && ha != hb && equalSparse(&equal, a, b, 0.5) && !equal;
+
+	free(a);
+	free(b);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testHit()) {
+		printf("testHit failed\n");
+		failed++;
+	}
+	if (!testCollision()) {
+		printf("testCollision failed\n");
+		failed++;
+	}
+	if (!testHash()) {
+		printf("testHash failed\n");
+		failed++;
+	}
+	if (!testEqualNaN()) {
+		printf("testEqualNaN failed\n");
+		failed++;
+	}
+	if (!testLarge()) {
+		printf("testLarge failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file test_esc.c
+ * @brief Tests of multiplySparse_ESC and sortSparse
+ *
+ * gcc -std=c11 -I.. test_esc.c ../sparse.c -lm -o test_esc && ./test_esc
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Random m x n matrix with nnz elements of integer values in [1,5] (duplicates are possible)
+ */
+static elem_t* randomMatrix(const int m, const int n, const int nnz) {
+
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	for (int e = 0; e < nnz; e++) {
+		a[e+1] = (elem_t) {rand()%m, rand()%n, rand()%5 + 1};
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+	return a;
+}
+
+/**
+ * @brief Checks that the elements are sorted by row and column without duplicates
+ */
+static int isSorted(const elem_t* a) {
+
+	for (int k = 1; k < (int) a->value; k++) {
+		if (a[k].i > a[k+1].i || (a[k].i == a[k+1].i && a[k].j >= a[k+1].j)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief ESC gives the product of multiplySparse, sorted, over several batches and with a row bigger than a batch
+ * followed by short rows
+ */
+static int testProduct(void) {
+
+	srand(3);
+	int m = 400;
+	int n = 300;
+	elem_t* a = randomMatrix(m, n, 3000);
+	elem_t* b = randomMatrix(n, n, 3000);
+
+	//row 7 of a is dense, so it has about 3000 partial products
+	for (int j = 0; j < n; j++) {
+		a[j+1] = (elem_t) {7, j, 1};
+	}
+	long size = (long) m*n;
+	elem_t* expected = malloc((size+1)*sizeof(elem_t));
+	elem_t* out = malloc((size+1)*sizeof(elem_t));
+
+	int equal;
+	expected->value = size;
+	out->value = size;
+	int ok = multiplySparse(expected, a, b) && multiplySparse_ESC(out, a, b);
+
+	//multiplySparse doesn't set the dimensions
+	expected->i = m;
+	expected->j = n;
+	ok = ok && isSorted(out) && equalSparse(&equal, out, expected, 0) && equal;
+
+	//row 1 of c is dense and d has 40 elements per row, so row 1 has about 12000 partial products, more than a batch
+	elem_t* c = randomMatrix(m, n, 3000);
+	for (int j = 0; j < n; j++) {
+		c[j+1] = (elem_t) {1, j, 1};
+	}
+	elem_t* d = randomMatrix(n, 60, 40*n);
+	expected->value = size;
+	out->value = size;
+	ok = ok && multiplySparse(expected, c, d) && multiplySparse_ESC(out, c, d);
+	expected->i = m;
+	expected->j = 60;
+	ok = ok && isSorted(out) && equalSparse(&equal, out, expected, 0) && equal;
+
+	//too small output
+	out->value = expected->value - 1;
+	ok = ok && !multiplySparse_ESC(out, c, d);
+
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	free(expected);
+	free(out);
+	return ok;
+}
+
+/**
+ * @brief A product exactly zero is dropped, a product below INFVALUE is kept
+ */
+static int testSmallProduct(void) {
+
+	elem_t a[4] = {{1, 2, 3}, {0, 0, 1}, {0, 1, 1}, {0, 0, 0.0001}};
+	elem_t b[4] = {{2, 2, 3}, {0, 0, 1}, {1, 0, -1}, {1, 1, 0.01}};
+	elem_t out[5] = {{0, 0, 4}};
+
+	return multiplySparse_ESC(out, a, b) && out->value == 2 && out[1].j == 0 && fabs(out[1].value-0.0001) < 1e-15
+			&& out[2].j == 1 && fabs(out[2].value-0.01) < 1e-15;
+}
+
+/**
+ * @brief sortSparse orders by row and column, also with keys wider than 32 bits
+ */
+static int testSort(void) {
+
+	srand(6);
+	elem_t* a = randomMatrix(100000, 100000, 5000);
+	elem_t* copy = malloc(5001*sizeof(elem_t));
+	for (int k = 0; k <= 5000; k++) {
+		copy[k] = a[k];
+	}
+
+	int equal;
+	int ok = sortSparse(a) && equalSparse(&equal, a, copy, 0) && equal;
+	for (int k = 1; ok && k < (int) a->value; k++) {
+		ok = a[k].i < a[k+1].i || (a[k].i == a[k+1].i && a[k].j <= a[k+1].j);
+	}
+
+	free(a);
+	free(copy);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testProduct()) {
+		printf("testProduct failed\n");
+		failed++;
+	}
+	if (!testSmallProduct()) {
+		printf("testSmallProduct failed\n");
+		failed++;
+	}
+	if (!testSort()) {
+		printf("testSort failed\n");
+		failed++;
+	}
+	return failed;
+}
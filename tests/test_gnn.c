@@ -0,0 +1,188 @@
+/**
+ * @file test_gnn.c
+ * @brief Tests of the graph neural network kernels (gnnMultiplySparse, gnnMultiplySparseT, attentionSparse)
+ *
+ * gcc -std=c11 -fopenmp -I.. test_gnn.c ../sparse.c -lm -o test_gnn && ./test_gnn
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Random m x n matrix with about nnz elements of values in (0,1]
+ */
+static elem_t* randomMatrix(const int m, const int n, const int nnz) {
+
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	for (int e = 0; e < nnz; e++) {
+		a[e+1] = (elem_t) {rand()%m, rand()%n, (rand()%100 + 1)/100.0};
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+	return a;
+}
+
+/**
+ * @brief Forward and backward products with every normalization, with more features than a tile, match the dense
+ * products with the normalized matrix
+ */
+static int testProduct(void) {
+
+	srand(5);
+	int m = 70;
+	int n = 50;
+	int k = GNN_TILE+13;
+	elem_t* a = randomMatrix(m, n, 400);
+	double* h = malloc((long) n*k*sizeof(double));
+	double* g = malloc((long) m*k*sizeof(double));
+	double* out = malloc((long) m*k*sizeof(double));
+	double* expected = malloc((long) m*k*sizeof(double));
+	double rowsum[70];
+	double colsum[50];
+	for (int p = 0; p < n*k; p++) {
+		h[p] = rand()%9 - 4;
+	}
+	for (int p = 0; p < m*k; p++) {
+		g[p] = rand()%9 - 4;
+	}
+	for (int i = 0; i < m; i++) {
+		rowsum[i] = 0;
+	}
+	for (int j = 0; j < n; j++) {
+		colsum[j] = 0;
+	}
+	for (int e = 0; e < (int) a->value; e++) {
+		rowsum[a[e+1].i] += a[e+1].value;
+		colsum[a[e+1].j] += a[e+1].value;
+	}
+
+	int ok = 1;
+	int norms[3] = {GNN_NONE, GNN_ROW, GNN_SYM};
+	for (int t = 0; ok && t < 3; t++) {
+		for (int transposed = 0; ok && transposed < 2; transposed++) {
+			int rows = transposed ? n : m;
+			for (int p = 0; p < rows*k; p++) {
+				expected[p] = 0;
+			}
+			for (int e = 0; e < (int) a->value; e++) {
+				elem_t curr = a[e+1];
+				double scale = curr.value;
+				if (norms[t] == GNN_ROW) {
+					scale /= rowsum[curr.i];
+				} else if (norms[t] == GNN_SYM) {
+					scale /= sqrt(rowsum[curr.i]*colsum[curr.j]);
+				}
+				int r = transposed ? curr.j : curr.i;
+				const double* src = transposed ? g+(long) curr.i*k : h+(long) curr.j*k;
+				for (int c = 0; c < k; c++) {
+					expected[(long) r*k+c] += scale*src[c];
+				}
+			}
+			ok = transposed ? gnnMultiplySparseT(out, a, g, k, norms[t]) : gnnMultiplySparse(out, a, h, k, norms[t]);
+			for (int p = 0; ok && p < rows*k; p++) {
+				ok = fabs(out[p]-expected[p]) <= 1e-12*(1 + fabs(expected[p]));
+			}
+		}
+	}
+
+	free(a);
+	free(h);
+	free(g);
+	free(out);
+	free(expected);
+	return ok;
+}
+
+/**
+ * @brief A matrix without rows is a valid input
+ */
+static int testEmpty(void) {
+
+	elem_t a[1] = {{0, 3, 0}};
+	double h[6] = {1, 2, 3, 4, 5, 6};
+	double out[6] = {1, 1, 1, 1, 1, 1};
+
+	return gnnMultiplySparse(out, a, h, 2, GNN_SYM) && gnnMultiplySparseT(out, a, h, 2, GNN_ROW) && out[0] == 0 && out[5] == 0;
+}
+
+/**
+ * @brief Sparse attention matches the softmax of the scores of each row computed separately, rows without elements
+ * give zero rows
+ */
+static int testAttention(void) {
+
+	srand(8);
+	int m = 300;
+	int n = 40;
+	int d = 8;
+	int dv = 5;
+	elem_t* a = randomMatrix(m, n, 1500);
+	for (int e = 0; e < (int) a->value; e++) {
+		if (a[e+1].i%7 == 0) {
+			a[e+1].i++;
+		}
+	}
+	double* q = malloc((long) m*d*sizeof(double));
+	double* k = malloc((long) n*d*sizeof(double));
+	double* v = malloc((long) n*dv*sizeof(double));
+	double* out = malloc((long) m*dv*sizeof(double));
+	for (int p = 0; p < m*d; p++) {
+		q[p] = (rand()%21 - 10)/10.0;
+	}
+	for (int p = 0; p < n*d; p++) {
+		k[p] = (rand()%21 - 10)/10.0;
+	}
+	for (int p = 0; p < n*dv; p++) {
+		v[p] = rand()%9 - 4;
+	}
+
+	int ok = attentionSparse(out, a, q, k, v, d, dv, 1/sqrt(d));
+	for (int r = 0; ok && r < m; r++) {
+		double expected[5] = {0, 0, 0, 0, 0};
+		double sum = 0;
+		for (int e = 0; e < (int) a->value; e++) {
+			if (a[e+1].i != r) {
+				continue;
+			}
+			double dot = 0;
+			for (int c = 0; c < d; c++) {
+				dot += q[r*d+c]*k[a[e+1].j*d+c];
+			}
+			double weight = exp(dot/sqrt(d));
+			sum += weight;
+			for (int c = 0; c < dv; c++) {
+				expected[c] += weight*v[a[e+1].j*dv+c];
+			}
+		}
+		for (int c = 0; ok && c < dv; c++) {
+			ok = fabs(out[r*dv+c] - (sum > 0 ? expected[c]/sum : 0)) <= 1e-12;
+		}
+		ok = ok && (r%7 != 0 || sum == 0);
+	}
+
+	free(a);
+	free(q);
+	free(k);
+	free(v);
+	free(out);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testProduct()) {
+		printf("testProduct failed\n");
+		failed++;
+	}
+	if (!testEmpty()) {
+		printf("testEmpty failed\n");
+		failed++;
+	}
+	if (!testAttention()) {
+		printf("testAttention failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file test_lsq.c
+ * @brief Tests of the iterative least squares solvers (lsqrSparse, lsmrSparse)
+ *
+ * gcc -std=c11 -I.. test_lsq.c ../sparse.c -lm -o test_lsq && ./test_lsq
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Random m*n sparse matrix with about a quarter of the elements, plus diag on the diagonal
+ */
+static elem_t* randomMatrix(const int m, const int n, const double diag) {
+
+	elem_t* a = malloc(((long) m*n + 1)*sizeof(elem_t));
+	int nnz = 0;
+	for (int i = 0; i < m; i++) {
+		for (int j = 0; j < n; j++) {
+			double value = (rand()%4 == 0 ? (rand()%100)/10.0 - 5 : 0) + (i == j ? diag : 0);
+			if (value != 0) {
+				nnz++;
+				a[nnz] = (elem_t) {i, j, value};
+			}
+		}
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+	return a;
+}
+
+/**
+ * @brief Both solvers agree with the QR solution of an overdetermined problem
+ */
+static int testOverdetermined(void) {
+
+	srand(4);
+	int m = 80;
+	int n = 30;
+	elem_t* a = randomMatrix(m, n, 0);
+	double b[80];
+	double x[30];
+	double y[30];
+	double z[30];
+	for (int i = 0; i < m; i++) {
+		b[i] = rand()%9 - 4;
+	}
+
+	sparseqr_t qr;
+	int ok = qrSparse(&qr, a) && qrSolveSparse(x, &qr, a, b) && lsqrSparse(y, a, b, 200, 1e-12)
+			&& lsmrSparse(z, a, b, 200, 1e-12);
+	for (int j = 0; ok && j < n; j++) {
+		ok = fabs(x[j]-y[j]) <= 1e-8*(1 + fabs(x[j])) && fabs(x[j]-z[j]) <= 1e-8*(1 + fabs(x[j]));
+	}
+
+	qrFreeSparse(&qr);
+	free(a);
+	return ok;
+}
+
+/**
+ * @brief A compatible square system is solved to the tolerance on ||r||
+ */
+static int testCompatible(void) {
+
+	srand(7);
+	int n = 50;
+	elem_t* a = randomMatrix(n, n, 20);
+	double b[50];
+	double x[50];
+	double r[50];
+	for (int i = 0; i < n; i++) {
+		b[i] = rand()%9 - 4;
+	}
+
+	int ok = 1;
+	for (int solver = 0; ok && solver < 2; solver++) {
+		ok = (solver == 0 ? lsqrSparse(x, a, b, 500, 1e-10) : lsmrSparse(x, a, b, 500, 1e-10));
+		multiplySparse_Vector(r, a, x);
+		double rnorm = 0;
+		double bnorm = 0;
+		for (int i = 0; i < n; i++) {
+			rnorm += (b[i]-r[i])*(b[i]-r[i]);
+			bnorm += b[i]*b[i];
+		}
+		ok = ok && sqrt(rnorm) <= 1e-8*sqrt(bnorm);
+	}
+
+	free(a);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testOverdetermined()) {
+		printf("testOverdetermined failed\n");
+		failed++;
+	}
+	if (!testCompatible()) {
+		printf("testCompatible failed\n");
+		failed++;
+	}
+	return failed;
+}
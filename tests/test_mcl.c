@@ -0,0 +1,144 @@
+/**
+ * @file test_mcl.c
+ * @brief Tests of inflateSparse and mclSparse
+ *
+ * gcc -std=c11 -I.. test_mcl.c ../sparse.c -lm -o test_mcl && ./test_mcl
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+//star with a hub of degree above 1000: all its transition probabilities are below INFVALUE
+static int testHighDegree(void) {
+
+	int leaves = 1500;
+	int m = leaves+1;
+	long size = (long) m*m;
+
+	//column-stochastic transition matrix, with self loops
+	elem_t* in = malloc((3*leaves+2)*sizeof(elem_t));
+	elem_t* out = malloc((size+1)*sizeof(elem_t));
+	double* rowsum = calloc(m, sizeof(double));
+	int* rowlen = calloc(m, sizeof(int));
+	int nnz = 0;
+	in[++nnz] = (elem_t) {0, 0, 1.0/m};
+	for (int l = 1; l <= leaves; l++) {
+		in[++nnz] = (elem_t) {l, 0, 1.0/m};
+		in[++nnz] = (elem_t) {0, l, 0.5};
+		in[++nnz] = (elem_t) {l, l, 0.5};
+	}
+	in->i = m;
+	in->j = m;
+	in->value = nnz;
+	out->value = size;
+
+	//a single expansion with inflation 1 and no pruning is the square of the row-normalized matrix
+	int ok = mclSparse(out, NULL, in, 1, 0, 0, 1, 0);
+	for (int c = 1; ok && c <= (int) out->value; c++) {
+		rowsum[out[c].i] += out[c].value;
+		rowlen[out[c].i]++;
+	}
+
+	//no mass is lost, and every vertex is reached in two steps
+	for (int r = 0; ok && r < m; r++) {
+		ok = fabs(rowsum[r]-1) < 1e-12 && rowlen[r] == m;
+	}
+
+	free(in);
+	free(out);
+	free(rowsum);
+	free(rowlen);
+
+	return ok;
+}
+
+//two cliques joined by an edge are split in two clusters
+static int testClusters(void) {
+
+	int m = 8;
+	double dense[64] = {0};
+	for (int i = 0; i < m; i++) {
+		for (int j = 0; j < m; j++) {
+			dense[i*m+j] = (i < 4) == (j < 4) ? 1 : 0;
+		}
+	}
+	dense[3*m+4] = 1;
+	dense[4*m+3] = 1;
+
+	elem_t* in = malloc((m*m+1)*sizeof(elem_t));
+	elem_t* out = malloc((m*m+1)*sizeof(elem_t));
+	int clusters[8];
+	in->value = m*m;
+	out->value = m*m;
+	generateSparse(in, dense, m, m);
+
+	int ok = mclSparse(out, clusters, in, 2, 0, 1e-6, 100, 1e-9);
+	for (int i = 0; ok && i < m; i++) {
+		ok = (clusters[i] == clusters[0]) == (i < 4);
+	}
+
+	free(in);
+	free(out);
+
+	return ok;
+}
+
+//inflation of unsorted elements: absolute values raised to the power, each row sums to 1, empty rows stay empty
+static int testInflate(void) {
+
+	int m = 2000;
+	int nnz = 3*m;
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	for (int e = 0; e < nnz; e++) {
+		int r = (e*7919)%m;
+		a[e+1] = (elem_t) {r%3 == 0 ? r+1 : r, e%11, (e%2 ? -1 : 1)*(e%5 + 1)};
+	}
+	a->i = m+1;
+	a->j = 11;
+	a->value = nnz;
+
+	double* sum = calloc(m+1, sizeof(double));
+	double* expected = malloc(nnz*sizeof(double));
+	for (int e = 0; e < nnz; e++) {
+		sum[a[e+1].i] += a[e+1].value*a[e+1].value;
+	}
+	for (int e = 0; e < nnz; e++) {
+		expected[e] = a[e+1].value*a[e+1].value/sum[a[e+1].i];
+	}
+
+	int ok = inflateSparse(a, 2);
+	for (int r = 0; r <= m; r++) {
+		sum[r] = 0;
+	}
+	for (int e = 0; ok && e < nnz; e++) {
+		ok = fabs(a[e+1].value-expected[e]) < 1e-15;
+		sum[a[e+1].i] += a[e+1].value;
+	}
+	for (int r = 0; ok && r <= m; r++) {
+		ok = (r%3 == 0 || r == m) ? sum[r] == 0 : fabs(sum[r]-1) < 1e-12;
+	}
+
+	free(a);
+	free(sum);
+	free(expected);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testHighDegree()) {
+		printf("testHighDegree failed\n");
+		failed++;
+	}
+	if (!testClusters()) {
+		printf("testClusters failed\n");
+		failed++;
+	}
+	if (!testInflate()) {
+		printf("testInflate failed\n");
+		failed++;
+	}
+
+	return failed;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file test_prune.c
+ * @brief Tests of pruneSparse and multiplySparse_Prune
+ *
+ * gcc -std=c11 -I.. test_prune.c ../sparse.c -lm -o test_prune && ./test_prune
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+//a product below INFVALUE survives absolute = 0 and is deleted by a larger threshold
+static int testSmallProduct(void) {
+
+	elem_t a[3] = {{2, 2, 2}, {0, 0, 0.01}, {1, 1, 1}};
+	elem_t b[3] = {{2, 2, 2}, {0, 1, 0.02}, {1, 0, 2}};
+	elem_t out[5] = {{0, 0, 4}};
+
+	if (!multiplySparse_Prune(out, a, b, 0, 0, 0)) {
+		return 0;
+	}
+	if (out->value != 2 || out[1].i != 0 || out[1].j != 1 || fabs(out[1].value-0.0002) > 1e-15) {
+		return 0;
+	}
+
+	out->value = 4;
+	if (!multiplySparse_Prune(out, a, b, 0, 0.001, 0)) {
+		return 0;
+	}
+
+	return out->value == 1 && out[1].i == 1 && out[1].j == 0;
+}
+
+//top-k and relative pruning of each row
+static int testTopK(void) {
+
+	elem_t a[4] = {{2, 3, 3}, {0, 0, 1}, {0, 1, 0.5}, {0, 2, 0.0001}};
+	elem_t b[4] = {{3, 3, 3}, {0, 0, 1}, {1, 1, 1}, {2, 2, 1}};
+	elem_t out[4] = {{0, 0, 3}};
+
+	if (!multiplySparse_Prune(out, a, b, 2, 0, 0)) {
+		return 0;
+	}
+	if (out->value != 2 || out[1].j != 0 || out[2].j != 1) {
+		return 0;
+	}
+
+	out->value = 3;
+	if (!multiplySparse_Prune(out, a, b, 0, 0, 0.6)) {
+		return 0;
+	}
+
+	return out->value == 1 && out[1].j == 0;
+}
+
+//pruneSparse keeps small elements when no threshold is set
+static int testPruneSparse(void) {
+
+	elem_t m[4] = {{2, 2, 3}, {1, 1, 0.0005}, {0, 0, 3}, {0, 1, 1}};
+
+	if (!pruneSparse(m, 1, 0, 0)) {
+		return 0;
+	}
+
+	return m->value == 2 && m[1].i == 0 && m[1].j == 0 && m[2].i == 1 && m[2].value == 0.0005;
+}
+
+//the fused product over many batches of rows gives the full product pruned afterwards
+static int testLarge(void) {
+
+	srand(9);
+	int m = 12000;
+	int n = 500;
+	int nnz = 30000;
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	elem_t* b = malloc((nnz+1)*sizeof(elem_t));
+	for (int e = 0; e < nnz; e++) {
+		a[e+1] = (elem_t) {rand()%m, rand()%n, rand()%7 - 3};
+		b[e+1] = (elem_t) {rand()%n, rand()%n, (rand()%100)/10.0};
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+	b->i = n;
+	b->j = n;
+	b->value = nnz;
+
+	long size = 100L*nnz;
+	elem_t* expected = malloc((size+1)*sizeof(elem_t));
+	elem_t* out = malloc((size+1)*sizeof(elem_t));
+	expected->value = size;
+	out->value = size;
+
+	int equal;
+	int ok = multiplySparse_ESC(expected, a, b) && pruneSparse(expected, 4, 0.5, 0.1);
+	ok = ok && multiplySparse_Prune(out, a, b, 4, 0.5, 0.1) && equalSparse(&equal, out, expected, 1e-12) && equal;
+
+	//rows are sorted and at most 4 long
+	for (int p = 1; ok && p < (int) out->value; p++) {
+		ok = out[p].i < out[p+1].i || (out[p].i == out[p+1].i && out[p].j < out[p+1].j);
+	}
+	int len = 0;
+	for (int p = 1; ok && p <= (int) out->value; p++) {
+		len = (p > 1 && out[p].i == out[p-1].i) ? len+1 : 1;
+		ok = len <= 4;
+	}
+
+	free(a);
+	free(b);
+	free(expected);
+	free(out);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testSmallProduct()) {
+		printf("testSmallProduct failed\n");
+		failed++;
+	}
+	if (!testTopK()) {
+		printf("testTopK failed\n");
+		failed++;
+	}
+	if (!testPruneSparse()) {
+		printf("testPruneSparse failed\n");
+		failed++;
+	}
+	if (!testLarge()) {
+		printf("testLarge failed\n");
+		failed++;
+	}
+
+	return failed;
+}
@@ -0,0 +1,221 @@
+/**
+ * @file test_qr.c
+ * @brief Tests of the multifrontal QR factorization (qrSparse, qrSolveSparse)
+ *
+ * gcc -std=c11 -I.. test_qr.c ../sparse.c -lm -o test_qr && ./test_qr
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Random sparse matrix with a nonzero diagonal, some dense rows and an optional empty column
+ */
+static elem_t* randomMatrix(const int m, const int n, const int perRow, const int denseRows, const int emptyCol) {
+
+	elem_t* a = malloc(((long) m*perRow + n + (long) denseRows*n + 1)*sizeof(elem_t));
+	int nnz = 0;
+	for (int i = 0; i < m; i++) {
+		for (int p = 0; p < perRow; p++) {
+			int j = rand()%n;
+			if (j != emptyCol) {
+				nnz++;
+				a[nnz].i = i;
+				a[nnz].j = j;
+				a[nnz].value = (rand()%2 ? -1 : 1)*(0.5 + rand()%5);
+			}
+		}
+	}
+	for (int j = 0; j < n; j++) {
+		if (j != emptyCol) {
+			nnz++;
+			a[nnz].i = j;
+			a[nnz].j = j;
+			a[nnz].value = 4;
+		}
+	}
+	for (int r = 0; r < denseRows; r++) {
+		for (int j = 0; j < n; j++) {
+			if (j != emptyCol) {
+				nnz++;
+				a[nnz].i = m-1-r;
+				a[nnz].j = j;
+				a[nnz].value = 0.1*(1 + rand()%3);
+			}
+		}
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+	return a;
+}
+
+/**
+ * @brief Checks R'*R = P'*A'*A*P entry by entry
+ */
+static int checkFactor(const sparseqr_t* qr, const elem_t* a) {
+
+	int n = a->j;
+	double* ata = calloc((long) n*n, sizeof(double));
+	double* rtr = calloc((long) n*n, sizeof(double));
+	double* dense = calloc((long) a->i*n, sizeof(double));
+	int* position = malloc(n*sizeof(int));
+	for (int c = 0; c < n; c++) {
+		position[qr->perm[c]] = c;
+	}
+	for (int k = 0; k < (int) a->value; k++) {
+		dense[(long) a[k+1].i*n + position[a[k+1].j]] += a[k+1].value;
+	}
+	for (int r = 0; r < a->i; r++) {
+		for (int c1 = 0; c1 < n; c1++) {
+			for (int c2 = 0; dense[(long) r*n+c1] != 0 && c2 < n; c2++) {
+				ata[(long) c1*n+c2] += dense[(long) r*n+c1]*dense[(long) r*n+c2];
+			}
+		}
+	}
+	double scale = 0;
+	for (int k = 0; k < n; k++) {
+		for (int p = 0; p < qr->len[k]; p++) {
+			if (qr->cols[k][p] < k) {
+				free(ata);
+				free(rtr);
+				free(dense);
+				free(position);
+				return 0;
+			}
+			for (int q = 0; q < qr->len[k]; q++) {
+				rtr[(long) qr->cols[k][p]*n + qr->cols[k][q]] += qr->vals[k][p]*qr->vals[k][q];
+			}
+		}
+	}
+	double error = 0;
+	for (long p = 0; p < (long) n*n; p++) {
+		scale = fmax(scale, fabs(ata[p]));
+		error = fmax(error, fabs(ata[p]-rtr[p]));
+	}
+	free(ata);
+	free(rtr);
+	free(dense);
+	free(position);
+	return error <= 1e-12*scale;
+}
+
+/**
+ * @brief R'*R matches A'*A on random matrices, also with dense rows
+ */
+static int testFactor(void) {
+
+	srand(5);
+	int ok = 1;
+	for (int it = 0; ok && it < 20; it++) {
+		int n = 1 + rand()%60;
+		int m = n + rand()%80;
+		elem_t* a = randomMatrix(m, n, 1 + rand()%4, it%3, -1);
+		sparseqr_t qr;
+		ok = qrSparse(&qr, a) && checkFactor(&qr, a);
+		qrFreeSparse(&qr);
+		free(a);
+	}
+	return ok;
+}
+
+/**
+ * @brief Least squares on a g*g grid (differences along the edges and one row per node) satisfies the normal
+ * equations A'*(b-A*x) = 0
+ */
+static int testSolve(void) {
+
+	srand(9);
+	int g = 60;
+	int n = g*g;
+	int m = 2*g*(g-1) + n;
+	elem_t* a = malloc((2L*m + 1)*sizeof(elem_t));
+	int nnz = 0;
+	int row = 0;
+	for (int v = 0; v < n; v++) {
+		int right = (v%g < g-1 ? v+1 : -1);
+		int down = (v+g < n ? v+g : -1);
+		int ends[2] = {right, down};
+		for (int e = 0; e < 2; e++) {
+			if (ends[e] >= 0) {
+				a[nnz+1] = (elem_t) {row, v, 1};
+				a[nnz+2] = (elem_t) {row, ends[e], -1 - 0.1*(rand()%5)};
+				nnz += 2;
+				row++;
+			}
+		}
+		nnz++;
+		a[nnz] = (elem_t) {row, v, 0.5};
+		row++;
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+
+	double* b = malloc(m*sizeof(double));
+	double* x = malloc(n*sizeof(double));
+	double* r = malloc(m*sizeof(double));
+	double* grad = malloc(n*sizeof(double));
+	for (int i = 0; i < m; i++) {
+		b[i] = rand()%7 - 3;
+	}
+
+	sparseqr_t qr;
+	int ok = qrSparse(&qr, a) && qrSolveSparse(x, &qr, a, b);
+	if (ok) {
+		multiplySparse_Vector(r, a, x);
+		double bnorm = 0;
+		for (int i = 0; i < m; i++) {
+			r[i] = b[i] - r[i];
+			bnorm += b[i]*b[i];
+		}
+		multiplySparse_VectorT(grad, a, r);
+		double gnorm = 0;
+		for (int j = 0; j < n; j++) {
+			gnorm += grad[j]*grad[j];
+		}
+		ok = sqrt(gnorm) <= 1e-9*sqrt(bnorm);
+	}
+
+	qrFreeSparse(&qr);
+	free(a);
+	free(b);
+	free(x);
+	free(r);
+	free(grad);
+	return ok;
+}
+
+/**
+ * @brief An empty column makes R singular and the solve fails
+ */
+static int testRankDeficient(void) {
+
+	srand(3);
+	elem_t* a = randomMatrix(30, 10, 2, 0, 4);
+	double b[30] = {1};
+	double x[10];
+	sparseqr_t qr;
+	int ok = qrSparse(&qr, a) && !qrSolveSparse(x, &qr, a, b);
+	qrFreeSparse(&qr);
+	free(a);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testFactor()) {
+		printf("testFactor failed\n");
+		failed++;
+	}
+	if (!testSolve()) {
+		printf("testSolve failed\n");
+		failed++;
+	}
+	if (!testRankDeficient()) {
+		printf("testRankDeficient failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file test_share.c
+ * @brief Tests of the copy-on-write matrix (shareCreateSparse, shareCopySparse, shareSetSparse)
+ *
+ * gcc -std=c11 -I.. test_share.c ../sparse.c -lm -o test_share && ./test_share
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief A copy shares the untouched blocks, a write only changes the copy written
+ */
+static int testCopyOnWrite(void) {
+
+	elem_t a[5] = {{4, 4, 4}, {0, 0, 1}, {1, 1, 2}, {2, 2, 3}, {3, 3, 4}};
+	elem_t out[10];
+	shared_t s1;
+	shared_t s2;
+
+	int ok = shareCreateSparse(&s1, a, 2) && shareCopySparse(&s2, &s1);
+	ok = ok && shareSetSparse(&s2, 3, 0, 9) && shareSetSparse(&s2, 3, 3, 7);
+	ok = ok && s1.blocks[0] == s2.blocks[0] && s1.blocks[1] != s2.blocks[1];
+
+	int equal;
+	out->value = 9;
+	ok = ok && shareGetSparse(out, &s1) && equalSparse(&equal, out, a, 0) && equal;
+	elem_t expected[6] = {{4, 4, 5}, {0, 0, 1}, {1, 1, 2}, {2, 2, 3}, {3, 3, 7}, {3, 0, 9}};
+	out->value = 9;
+	ok = ok && shareGetSparse(out, &s2) && equalSparse(&equal, out, expected, 0) && equal;
+
+	shareFreeSparse(&s1);
+	shareFreeSparse(&s2);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testCopyOnWrite()) {
+		printf("testCopyOnWrite failed\n");
+		failed++;
+	}
+	return failed;
+}
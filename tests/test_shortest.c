@@ -0,0 +1,106 @@
+/**
+ * @file test_shortest.c
+ * @brief Tests of bellmanFordSparse and deltaSteppingSparse
+ *
+ * gcc -std=c11 -fopenmp -I.. test_shortest.c ../sparse.c -lm -o test_shortest && ./test_shortest
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+//delta-stepping agrees with Bellman-Ford for buckets much narrower and much wider than the edges
+static int testDeltas(void) {
+
+	int m = 200;
+	elem_t* in = malloc((3*m+1)*sizeof(elem_t));
+	double* ref = malloc(m*sizeof(double));
+	double* dist = malloc(m*sizeof(double));
+	double deltas[4] = {0.01, 0.7, 5, 1000};
+
+	//a long path with shortcuts of random weight
+	srand(11);
+	int nnz = 0;
+	for (int v = 0; v+1 < m; v++) {
+		in[++nnz] = (elem_t) {v, v+1, 0.5+rand()%10};
+		in[++nnz] = (elem_t) {v, rand()%m, 0.5+rand()%50};
+	}
+	in->i = m;
+	in->j = m;
+	in->value = nnz;
+
+	int ok = bellmanFordSparse(ref, in, 0);
+	for (int d = 0; ok && d < 4; d++) {
+		ok = deltaSteppingSparse(dist, in, 0, deltas[d]);
+		for (int v = 0; ok && v < m; v++) {
+			ok = fabs(dist[v]-ref[v]) < 1e-9;
+		}
+	}
+
+	free(in);
+	free(ref);
+	free(dist);
+
+	return ok;
+}
+
+//too many buckets are rejected instead of allocated
+static int testTooManyBuckets(void) {
+
+	elem_t in[2] = {{2, 2, 1}, {0, 1, 10}};
+	double dist[2];
+
+	return !deltaSteppingSparse(dist, in, 0, 1e-9) && deltaSteppingSparse(dist, in, 0, 1e-3) && dist[1] == 10;
+}
+
+//delta-stepping agrees with Bellman-Ford on a random graph whose buckets hold many vertices, some unreachable
+static int testWideFrontier(void) {
+
+	int m = 3000;
+	int nnz = 8*m;
+	elem_t* in = malloc((nnz+1)*sizeof(elem_t));
+	double* ref = malloc(m*sizeof(double));
+	double* dist = malloc(m*sizeof(double));
+	double deltas[3] = {1, 4, 30};
+
+	//vertices above m-100 have no incoming edges
+	srand(7);
+	for (int e = 0; e < nnz; e++) {
+		in[e+1] = (elem_t) {rand()%m, rand()%(m-100), (rand()%100)/10.0};
+	}
+	in->i = m;
+	in->j = m;
+	in->value = nnz;
+
+	int ok = bellmanFordSparse(ref, in, 0);
+	for (int d = 0; ok && d < 3; d++) {
+		ok = deltaSteppingSparse(dist, in, 0, deltas[d]);
+		for (int v = 0; ok && v < m; v++) {
+			ok = (isinf(ref[v]) ? isinf(dist[v]) : fabs(dist[v]-ref[v]) < 1e-9) && (v < m-100 || isinf(dist[v]));
+		}
+	}
+
+	free(in);
+	free(ref);
+	free(dist);
+
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testDeltas()) {
+		printf("testDeltas failed\n");
+		failed++;
+	}
+	if (!testTooManyBuckets()) {
+		printf("testTooManyBuckets failed\n");
+		failed++;
+	}
+	if (!testWideFrontier()) {
+		printf("testWideFrontier failed\n");
+		failed++;
+	}
+
+	return failed;
+}
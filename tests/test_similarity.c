@@ -0,0 +1,121 @@
+/**
+ * @file test_similarity.c
+ * @brief Tests of similaritySparse
+ *
+ * gcc -std=c11 -I.. test_similarity.c ../sparse.c -lm -o test_similarity && ./test_similarity
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+//a row of explicit zeros has no cosine similarity instead of 0/0
+static int testZeroNorm(void) {
+
+	elem_t in[6] = {{3, 2, 5}, {0, 0, 1}, {0, 1, 1}, {1, 0, 0}, {1, 1, 0}, {2, 0, 2}};
+	elem_t out[7] = {{0, 0, 6}};
+
+	if (!similaritySparse(out, in, SIMILARITY_COSINE, -1, 0)) {
+		return 0;
+	}
+	for (int c = 1; c <= (int) out->value; c++) {
+		if (isnan(out[c].value) || out[c].i == 1 || out[c].j == 1) {
+			return 0;
+		}
+	}
+
+	//only the pair of rows 0 and 2
+	return out->value == 2 && fabs(out[1].value-1/sqrt(2)) < 1e-12;
+}
+
+//all pairs against the dense rows, and top k per row equal to pruning the whole result
+static int testBruteForce(void) {
+
+	srand(12);
+	int m = 300;
+	int n = 40;
+	int nnz = 1500;
+	elem_t* in = malloc((nnz+1)*sizeof(elem_t));
+	double* dense = calloc(m*n, sizeof(double));
+	for (int e = 0; e < nnz; e++) {
+		int i = rand()%m;
+		int j = rand()%n;
+		while (dense[i*n+j] != 0) {
+			j = (j+1)%n;
+		}
+		dense[i*n+j] = (rand()%199 - 99)/10.0 + 0.05;
+		in[e+1] = (elem_t) {i, j, dense[i*n+j]};
+	}
+	in->i = m;
+	in->j = n;
+	in->value = nnz;
+
+	long size = (long) m*m;
+	elem_t* out = malloc((size+1)*sizeof(elem_t));
+	elem_t* top = malloc((size+1)*sizeof(elem_t));
+	int ok = 1;
+	for (int metric = 0; ok && metric < 2; metric++) {
+		double threshold = metric == SIMILARITY_COSINE ? 0.2 : 0.1;
+		out->value = size;
+		ok = similaritySparse(out, in, metric, threshold, 0);
+
+		//every pair above the threshold, in order
+		long count = 0;
+		for (int i = 0; ok && i < m; i++) {
+			for (int r = 0; ok && r < m; r++) {
+				double dot = 0;
+				double ni = 0;
+				double nr = 0;
+				for (int c = 0; c < n; c++) {
+					double a = dense[i*n+c];
+					double b = dense[r*n+c];
+					if (metric == SIMILARITY_COSINE) {
+						dot += a*b;
+						ni += a*a;
+						nr += b*b;
+					} else {
+						dot += (a != 0 && b != 0);
+						ni += (a != 0);
+						nr += (b != 0);
+					}
+				}
+				if (i == r || dot == 0 || ni == 0 || nr == 0) {
+					continue;
+				}
+				double similarity = metric == SIMILARITY_COSINE ? dot/sqrt(ni*nr) : dot/(ni + nr - dot);
+				if (similarity < threshold) {
+					continue;
+				}
+				count++;
+				ok = count <= (long) out->value && out[count].i == i && out[count].j == r
+						&& fabs(out[count].value-similarity) < 1e-12;
+			}
+		}
+		ok = ok && count == (long) out->value;
+
+		int equal;
+		top->value = size;
+		ok = ok && similaritySparse(top, in, metric, threshold, 3) && pruneSparse(out, 3, 0, 0)
+				&& equalSparse(&equal, top, out, 0) && equal;
+	}
+
+	free(in);
+	free(dense);
+	free(out);
+	free(top);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testZeroNorm()) {
+		printf("testZeroNorm failed\n");
+		failed++;
+	}
+	if (!testBruteForce()) {
+		printf("testBruteForce failed\n");
+		failed++;
+	}
+
+	return failed;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file test_sketch.c
+ * @brief Tests of the sparse sign sketch (sketchSparse, sketchSparse_Vector) and the sketched least squares solvers
+ *
+ * gcc -std=c11 -I.. test_sketch.c ../sparse.c -lm -o test_sketch && ./test_sketch
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Every column of S has density distinct rows: sketching the identity gives density elements of magnitude
+ * 1/sqrt(density) per column, also when density is close to rows
+ */
+static int testDistinctRows(void) {
+
+	int m = 500;
+	int rows = 6;
+	int density = 5;
+	elem_t* identity = malloc((m+1)*sizeof(elem_t));
+	elem_t* out = malloc((m*density+1)*sizeof(elem_t));
+	for (int i = 0; i < m; i++) {
+		identity[i+1] = (elem_t) {i, i, 1};
+	}
+	identity->i = m;
+	identity->j = m;
+	identity->value = m;
+	out->value = m*density;
+
+	int ok = sketchSparse(out, identity, rows, density, 42) && (int) out->value == m*density;
+	for (int k = 0; ok && k < (int) out->value; k++) {
+		ok = fabs(fabs(out[k+1].value) - 1/sqrt(density)) < 1e-15;
+	}
+
+	free(identity);
+	free(out);
+	return ok;
+}
+
+/**
+ * @brief sketchSparse_Vector applies the same S as sketchSparse
+ */
+static int testVector(void) {
+
+	srand(2);
+	int m = 300;
+	int rows = 40;
+	elem_t* column = malloc((m+1)*sizeof(elem_t));
+	elem_t* out = malloc((3*m+1)*sizeof(elem_t));
+	double v[300];
+	double sv[40];
+	for (int i = 0; i < m; i++) {
+		v[i] = rand()%11 - 5;
+		column[i+1] = (elem_t) {i, 0, v[i]};
+	}
+	column->i = m;
+	column->j = 1;
+	column->value = m;
+	out->value = 3*m;
+
+	int ok = sketchSparse(out, column, rows, 3, 7) && sketchSparse_Vector(sv, v, m, rows, 3, 7);
+	for (int k = 0; ok && k < (int) out->value; k++) {
+		sv[out[k+1].i] -= out[k+1].value;
+	}
+	for (int r = 0; ok && r < rows; r++) {
+		ok = fabs(sv[r]) < 1e-9;
+	}
+
+	free(column);
+	free(out);
+	return ok;
+}
+
+/**
+ * @brief The sketch preconditioned LSQR reaches the QR solution of the full problem
+ */
+static int testPreconditioned(void) {
+
+	srand(4);
+	int m = 2000;
+	int n = 40;
+	elem_t* a = malloc((4L*m + n + 1)*sizeof(elem_t));
+	int nnz = 0;
+	for (int i = 0; i < m; i++) {
+		for (int p = 0; p < 4; p++) {
+			nnz++;
+			a[nnz] = (elem_t) {i, rand()%n, (rand()%100)/10.0 - 5};
+		}
+	}
+	for (int j = 0; j < n; j++) {
+		nnz++;
+		a[nnz] = (elem_t) {j, j, 1000.0*(j+1)};
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+	double* b = malloc(m*sizeof(double));
+	for (int i = 0; i < m; i++) {
+		b[i] = rand()%9 - 4;
+	}
+	double x[40];
+	double y[40];
+
+	sparseqr_t qr;
+	int ok = qrSparse(&qr, a) && qrSolveSparse(x, &qr, a, b) && lsqrSketchSparse(y, a, b, 4*n, 4, 3, 50, 1e-12);
+	for (int j = 0; ok && j < n; j++) {
+		ok = fabs(x[j]-y[j]) <= 1e-8*(1 + fabs(x[j]));
+	}
+
+	qrFreeSparse(&qr);
+	free(a);
+	free(b);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testDistinctRows()) {
+		printf("testDistinctRows failed\n");
+		failed++;
+	}
+	if (!testVector()) {
+		printf("testVector failed\n");
+		failed++;
+	}
+	if (!testPreconditioned()) {
+		printf("testPreconditioned failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file test_spai.c
+ * @brief Tests of spaiSparse and fsaiSparse, and of the dense LU with pivoting they share with blockSetupSparse
+ *
+ * gcc -std=c11 -fopenmp -I.. test_spai.c ../sparse.c -lm -o test_spai && ./test_spai
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief 5-point Laplacian on a g*g grid with a variable diagonal, symmetric positive definite
+ */
+static elem_t* laplacian(const int g) {
+
+	int n = g*g;
+	elem_t* a = malloc((5*n+1)*sizeof(elem_t));
+	int nnz = 0;
+	for (int v = 0; v < n; v++) {
+		a[++nnz] = (elem_t) {v, v, 4.5+v%5};
+		if (v%g > 0) {
+			a[++nnz] = (elem_t) {v, v-1, -1};
+		}
+		if (v%g < g-1) {
+			a[++nnz] = (elem_t) {v, v+1, -1};
+		}
+		if (v >= g) {
+			a[++nnz] = (elem_t) {v, v-g, -1};
+		}
+		if (v < n-g) {
+			a[++nnz] = (elem_t) {v, v+g, -1};
+		}
+	}
+	a->i = n;
+	a->j = n;
+	a->value = nnz;
+
+	return a;
+}
+
+/**
+ * @brief Frobenius norm of I-M*A, where M is the sparse matrix m, or G'*G if g is not NULL, and A the sparse matrix a
+ */
+static double residual(const elem_t* m, const elem_t* g, const elem_t* a) {
+
+	int n = a->i;
+	double* dense = calloc((long) n*n, sizeof(double));
+	double* prod = calloc((long) n*n, sizeof(double));
+	for (int e = 0; e < (int) a->value; e++) {
+		dense[(long) a[e+1].i*n+a[e+1].j] += a[e+1].value;
+	}
+
+	//each element (i,k) adds its value times row k of the right factor to row i
+	const elem_t* left = (g != NULL ? g : m);
+	for (int e = 0; e < (int) left->value; e++) {
+		for (int c = 0; c < n; c++) {
+			prod[(long) left[e+1].i*n+c] += left[e+1].value*dense[(long) left[e+1].j*n+c];
+		}
+	}
+	if (g != NULL) {
+		for (long p = 0; p < (long) n*n; p++) {
+			dense[p] = 0;
+		}
+		for (int e = 0; e < (int) g->value; e++) {
+			for (int c = 0; c < n; c++) {
+				dense[(long) g[e+1].j*n+c] += g[e+1].value*prod[(long) g[e+1].i*n+c];
+			}
+		}
+		double* swap = dense;
+		dense = prod;
+		prod = swap;
+	}
+
+	double sum = 0;
+	for (int r = 0; r < n; r++) {
+		for (int c = 0; c < n; c++) {
+			double d = (r == c) - prod[(long) r*n+c];
+			sum += d*d;
+		}
+	}
+
+	free(dense);
+	free(prod);
+	return sqrt(sum);
+}
+
+/**
+ * @brief ||I-M*A|| of both methods is below the one of Jacobi and decreases with the level of the pattern
+ */
+static int testResidual(void) {
+
+	int g = 20;
+	int n = g*g;
+	elem_t* a = laplacian(g);
+	elem_t* jacobi = malloc((n+1)*sizeof(elem_t));
+	elem_t* m = malloc((50*n+1)*sizeof(elem_t));
+	for (int v = 0; v < n; v++) {
+		jacobi[v+1] = (elem_t) {v, v, 1/(4.5+v%5)};
+	}
+	jacobi->i = n;
+	jacobi->j = n;
+	jacobi->value = n;
+	double bound = residual(jacobi, NULL, a);
+
+	int ok = 1;
+	for (int method = 0; ok && method < 2; method++) {
+		double last = bound;
+		for (int level = 1; ok && level <= 3; level++) {
+			m->value = 50*n;
+			ok = method == 0 ? spaiSparse(m, a, level, 0) : fsaiSparse(m, a, level, 0);
+			for (int e = 1; ok && e < (int) m->value; e++) {
+				ok = m[e].i < m[e+1].i || (m[e].i == m[e+1].i && m[e].j < m[e+1].j);
+			}
+			double res = residual(method == 0 ? m : NULL, method == 0 ? NULL : m, a);
+			ok = ok && res < last;
+			last = res;
+		}
+	}
+
+	//too small output
+	m->value = n;
+	ok = ok && !spaiSparse(m, a, 1, 0);
+	m->value = n;
+	ok = ok && !fsaiSparse(m, a, 1, 0);
+
+	free(a);
+	free(jacobi);
+	free(m);
+	return ok;
+}
+
+/**
+ * @brief With the whole pattern both methods give the exact inverse, also when the diagonal is much smaller than the
+ * elements next to it so that every other column of the dense LU of FSAI pivots
+ */
+static int testExactInverse(void) {
+
+	//tridiagonal D^(1/2)*C*D^(1/2), with C of diagonal 1 and off diagonal 0.45 and D alternating 0.01 and 100
+	int n = 60;
+	elem_t* a = malloc((3*n+1)*sizeof(elem_t));
+	int nnz = 0;
+	for (int v = 0; v < n; v++) {
+		a[++nnz] = (elem_t) {v, v, v%2 == 0 ? 0.01 : 100};
+		if (v > 0) {
+			a[++nnz] = (elem_t) {v, v-1, 0.45};
+		}
+		if (v < n-1) {
+			a[++nnz] = (elem_t) {v, v+1, 0.45};
+		}
+	}
+	a->i = n;
+	a->j = n;
+	a->value = nnz;
+	elem_t* m = malloc((n*n+1)*sizeof(elem_t));
+
+	m->value = n*n;
+	int ok = spaiSparse(m, a, n, 0) && residual(m, NULL, a) < 1e-8;
+	m->value = n*n;
+	ok = ok && fsaiSparse(m, a, n, 0) && residual(NULL, m, a) < 1e-8;
+
+	free(a);
+	free(m);
+	return ok;
+}
+
+/**
+ * @brief A dense 60x60 block with zeros on the diagonal, which pivots after the first column, is solved exactly
+ */
+static int testPivoting(void) {
+
+	int n = 60;
+	elem_t* a = malloc((n*n+1)*sizeof(elem_t));
+	double x[60];
+	double y[60];
+	double z[60];
+	int nnz = 0;
+	for (int r = 0; r < n; r++) {
+		for (int c = 0; c < n; c++) {
+			if (r != c) {
+				a[++nnz] = (elem_t) {r, c, sin(r*n+c)};
+			}
+		}
+		x[r] = cos(r);
+	}
+	a->i = n;
+	a->j = n;
+	a->value = nnz;
+	int start[2] = {0, n};
+	blockprec_t prec;
+
+	int ok = blockSetupSparse(&prec, a, start, 1, 0) && prec.sparse[0] == NULL && blockApplySparse(y, &prec, x)
+			&& multiplySparse_Vector(z, a, y);
+	for (int r = 0; ok && r < n; r++) {
+		ok = fabs(z[r]-x[r]) < 1e-9;
+	}
+
+	blockFreeSparse(&prec);
+	free(a);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testResidual()) {
+		printf("testResidual failed\n");
+		failed++;
+	}
+	if (!testExactInverse()) {
+		printf("testExactInverse failed\n");
+		failed++;
+	}
+	if (!testPivoting()) {
+		printf("testPivoting failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file test_stream.c
+ * @brief Tests of the append-only matrix (streamInitSparse, streamAppendSparse, streamMultiplySparse, streamFreeSparse)
+ *
+ * gcc -std=c11 -I.. test_stream.c ../sparse.c -lm -o test_stream && ./test_stream
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Segments appended one at a time give the products of the new rows, and the column sums, the sketch, its
+ * approximation of A'*A and the product of the whole matrix equal the ones recomputed on the whole matrix
+ */
+static int testIncremental(void) {
+
+	srand(10);
+	int n = 30;
+	int sketchRows = 12;
+	int counts[5] = {40, 0, 25, 60, 7};
+	elem_t* full = malloc((1000+1)*sizeof(elem_t));
+	double x[30];
+	double y[132];
+	double expected[132];
+	for (int j = 0; j < n; j++) {
+		x[j] = rand()%9 - 4;
+	}
+	full->i = 0;
+	full->j = n;
+	full->value = 0;
+
+	stream_t stream;
+	int ok = streamInitSparse(&stream, n, STREAM_COLSUM | STREAM_SKETCH, sketchRows, 21);
+	for (int s = 0; ok && s < 5; s++) {
+
+		//a segment of counts[s] rows with about 4 elements per row
+		int nnz = 4*counts[s];
+		elem_t* rows = malloc((nnz+1)*sizeof(elem_t));
+		for (int e = 0; e < nnz; e++) {
+			rows[e+1] = (elem_t) {rand()%counts[s], rand()%n, rand()%9 - 4};
+			full[(int) full->value+e+1] = (elem_t) {full->i + rows[e+1].i, rows[e+1].j, rows[e+1].value};
+		}
+		rows->i = counts[s];
+		rows->j = n;
+		rows->value = nnz;
+		full->i += counts[s];
+		full->value += nnz;
+
+		for (int r = 0; r < counts[s]; r++) {
+			expected[r] = 0;
+		}
+		for (int e = 0; e < nnz; e++) {
+			expected[rows[e+1].i] += rows[e+1].value*x[rows[e+1].j];
+		}
+		ok = streamAppendSparse(y, &stream, rows, x) && stream.m == full->i;
+		for (int r = 0; ok && r < counts[s]; r++) {
+			ok = y[r] == expected[r];
+		}
+		free(rows);
+	}
+
+	//column sums
+	double colsum[30];
+	for (int j = 0; j < n; j++) {
+		colsum[j] = 0;
+	}
+	for (int e = 0; e < (int) full->value; e++) {
+		colsum[full[e+1].j] += full[e+1].value;
+	}
+	for (int j = 0; ok && j < n; j++) {
+		ok = stream.colsum[j] == colsum[j];
+	}
+
+	//the sketch is the CountSketch of sketchSparse with density 1, so it also gives the same A'*A
+	elem_t* sketch = malloc((sketchRows*n+1)*sizeof(elem_t));
+	double dense[12*30];
+	sketch->value = sketchRows*n;
+	ok = ok && sketchSparse(sketch, full, sketchRows, 1, 21);
+	for (int p = 0; p < sketchRows*n; p++) {
+		dense[p] = 0;
+	}
+	for (int e = 0; ok && e < (int) sketch->value; e++) {
+		dense[sketch[e+1].i*n+sketch[e+1].j] += sketch[e+1].value;
+	}
+	for (int p = 0; ok && p < sketchRows*n; p++) {
+		ok = fabs(stream.sketch[p]-dense[p]) < 1e-12;
+	}
+	for (int a = 0; ok && a < n; a++) {
+		for (int b = 0; ok && b < n; b++) {
+			double incremental = 0;
+			double recomputed = 0;
+			for (int r = 0; r < sketchRows; r++) {
+				incremental += stream.sketch[r*n+a]*stream.sketch[r*n+b];
+				recomputed += dense[r*n+a]*dense[r*n+b];
+			}
+			ok = fabs(incremental-recomputed) < 1e-9;
+		}
+	}
+
+	//product of the whole matrix
+	for (int r = 0; r < full->i; r++) {
+		expected[r] = 0;
+	}
+	for (int e = 0; e < (int) full->value; e++) {
+		expected[full[e+1].i] += full[e+1].value*x[full[e+1].j];
+	}
+	ok = ok && streamMultiplySparse(y, &stream, x);
+	for (int r = 0; ok && r < full->i; r++) {
+		ok = y[r] == expected[r];
+	}
+
+	ok = streamFreeSparse(&stream) && ok && stream.m == 0 && stream.colsum == NULL && stream.sketch == NULL;
+
+	free(full);
+	free(sketch);
+	return ok;
+}
+
+/**
+ * @brief Segments with an element outside their rows or outside the columns are rejected and leave the matrix unchanged
+ */
+static int testInvalid(void) {
+
+	stream_t stream;
+	elem_t good[3] = {{2, 4, 2}, {0, 1, 1}, {1, 3, 2}};
+	elem_t badColumn[3] = {{2, 4, 2}, {0, 1, 1}, {1, 4, 2}};
+	elem_t badRow[3] = {{2, 4, 2}, {2, 1, 1}, {1, 3, 2}};
+	elem_t negative[3] = {{2, 4, 2}, {0, -1, 1}, {-1, 3, 2}};
+	elem_t wrongWidth[2] = {{1, 5, 1}, {0, 0, 1}};
+
+	int ok = streamInitSparse(&stream, 4, STREAM_COLSUM | STREAM_SKETCH, 3, 5) && streamAppendSparse(NULL, &stream, good, NULL);
+	ok = ok && !streamAppendSparse(NULL, &stream, badColumn, NULL) && !streamAppendSparse(NULL, &stream, badRow, NULL)
+			&& !streamAppendSparse(NULL, &stream, negative, NULL) && !streamAppendSparse(NULL, &stream, wrongWidth, NULL);
+	ok = ok && stream.m == 2 && stream.nsegments == 1 && stream.colsum[0] == 0 && stream.colsum[1] == 1
+			&& stream.colsum[2] == 0 && stream.colsum[3] == 2;
+
+	streamFreeSparse(&stream);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testIncremental()) {
+		printf("testIncremental failed\n");
+		failed++;
+	}
+	if (!testInvalid()) {
+		printf("testInvalid failed\n");
+		failed++;
+	}
+	return failed;
+}
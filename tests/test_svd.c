@@ -0,0 +1,203 @@
+/**
+ * @file test_svd.c
+ * @brief Tests of multiplySparse_Dense, multiplySparse_DenseT and svdSparse
+ *
+ * gcc -std=c11 -fopenmp -I.. test_svd.c ../sparse.c -lm -o test_svd && ./test_svd
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Sparse m x n matrix G1*S*G2 with the given singular values, where G1 and G2 are block diagonal with 2x2
+ * rotations and S has the singular values on a permuted diagonal, so its singular values are known exactly
+ */
+static elem_t* spectrumMatrix(const int m, const int n, const double* sigma) {
+
+	double* dense = calloc((long) m*n, sizeof(double));
+	double* tmp = calloc((long) m*n, sizeof(double));
+
+	//S, row (7*j)%m holds the singular value of column j
+	for (int j = 0; j < n; j++) {
+		tmp[(long) ((7*j)%m)*n+j] = sigma[j];
+	}
+
+	//G1 rotates the pairs of rows, G2 the pairs of columns, by different angles
+	for (int r = 0; r+1 < m; r += 2) {
+		double c = cos(0.3+r);
+		double s = sin(0.3+r);
+		for (int j = 0; j < n; j++) {
+			dense[(long) r*n+j] = c*tmp[(long) r*n+j] - s*tmp[(long) (r+1)*n+j];
+			dense[(long) (r+1)*n+j] = s*tmp[(long) r*n+j] + c*tmp[(long) (r+1)*n+j];
+		}
+	}
+	for (int j = 0; j+1 < n; j += 2) {
+		double c = cos(1.1+j);
+		double s = sin(1.1+j);
+		for (int r = 0; r < m; r++) {
+			double a = dense[(long) r*n+j];
+			double b = dense[(long) r*n+j+1];
+			dense[(long) r*n+j] = c*a - s*b;
+			dense[(long) r*n+j+1] = s*a + c*b;
+		}
+	}
+
+	int nnz = 0;
+	for (long p = 0; p < (long) m*n; p++) {
+		nnz += (dense[p] != 0);
+	}
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	nnz = 0;
+	for (long p = 0; p < (long) m*n; p++) {
+		if (dense[p] != 0) {
+			a[++nnz] = (elem_t) {p/n, p%n, dense[p]};
+		}
+	}
+	a->i = m;
+	a->j = n;
+	a->value = nnz;
+
+	free(dense);
+	free(tmp);
+	return a;
+}
+
+/**
+ * @brief Products by a dense matrix with more columns than a tile match the products element by element
+ */
+static int testDenseProduct(void) {
+
+	srand(2);
+	int m = 120;
+	int n = 90;
+	int k = DENSE_TILE+9;
+	elem_t* a = malloc((700+1)*sizeof(elem_t));
+	for (int e = 0; e < 700; e++) {
+		a[e+1] = (elem_t) {rand()%m, rand()%n, rand()%9 - 4};
+	}
+	a->i = m;
+	a->j = n;
+	a->value = 700;
+	double* x = malloc((long) m*k*sizeof(double));
+	double* out = malloc((long) m*k*sizeof(double));
+	double* expected = malloc((long) m*k*sizeof(double));
+	for (long p = 0; p < (long) m*k; p++) {
+		x[p] = rand()%7 - 3;
+	}
+
+	int ok = 1;
+	for (int transposed = 0; ok && transposed < 2; transposed++) {
+		int rows = transposed ? n : m;
+		for (long p = 0; p < (long) rows*k; p++) {
+			expected[p] = 0;
+		}
+		for (int e = 0; e < 700; e++) {
+			int dst = transposed ? a[e+1].j : a[e+1].i;
+			int src = transposed ? a[e+1].i : a[e+1].j;
+			for (int c = 0; c < k; c++) {
+				expected[(long) dst*k+c] += a[e+1].value*x[(long) src*k+c];
+			}
+		}
+		ok = transposed ? multiplySparse_DenseT(out, a, x, k) : multiplySparse_Dense(out, a, x, k);
+		for (long p = 0; ok && p < (long) rows*k; p++) {
+			ok = out[p] == expected[p];
+		}
+	}
+
+	free(a);
+	free(x);
+	free(out);
+	free(expected);
+	return ok;
+}
+
+/**
+ * @brief The largest singular values of a matrix with a known, fast decaying spectrum are found, with orthonormal
+ * singular vectors satisfying A*v = s*u
+ */
+static int testSpectrum(void) {
+
+	int m = 400;
+	int n = 300;
+	int k = 10;
+	double sigma[300];
+	for (int j = 0; j < n; j++) {
+		sigma[j] = 100*pow(0.7, (j*37)%n);
+	}
+	elem_t* a = spectrumMatrix(m, n, sigma);
+	double* u = malloc((long) m*k*sizeof(double));
+	double* s = malloc(k*sizeof(double));
+	double* v = malloc((long) n*k*sizeof(double));
+	double* av = malloc((long) m*k*sizeof(double));
+
+	int ok = svdSparse(u, s, v, a, k, 10, 2, 7) && multiplySparse_Dense(av, a, v, k);
+	for (int c = 0; ok && c < k; c++) {
+		double expected = 100*pow(0.7, c);
+		ok = fabs(s[c]-expected) <= 1e-8*expected;
+		for (int d = 0; ok && d <= c; d++) {
+			double uu = 0;
+			double vv = 0;
+			for (int r = 0; r < m; r++) {
+				uu += u[(long) r*k+c]*u[(long) r*k+d];
+			}
+			for (int r = 0; r < n; r++) {
+				vv += v[(long) r*k+c]*v[(long) r*k+d];
+			}
+			ok = fabs(uu-(c == d)) < 1e-8 && fabs(vv-(c == d)) < 1e-8;
+		}
+		for (int r = 0; ok && r < m; r++) {
+			ok = fabs(av[(long) r*k+c] - s[c]*u[(long) r*k+c]) < 1e-6;
+		}
+	}
+
+	free(a);
+	free(u);
+	free(s);
+	free(v);
+	free(av);
+	return ok;
+}
+
+/**
+ * @brief A matrix of rank 3 decomposed with more triplets than its rank gives zero for the other singular values
+ */
+static int testRankDeficient(void) {
+
+	int m = 50;
+	int n = 40;
+	int k = 6;
+	double sigma[40];
+	for (int j = 0; j < n; j++) {
+		sigma[j] = j < 3 ? 3-j : 0;
+	}
+	elem_t* a = spectrumMatrix(m, n, sigma);
+	double u[50*6];
+	double s[6];
+	double v[40*6];
+
+	int ok = svdSparse(u, s, v, a, k, 0, 1, 3);
+	for (int c = 0; ok && c < k; c++) {
+		ok = fabs(s[c] - (c < 3 ? 3-c : 0)) < 1e-10;
+	}
+
+	free(a);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testDenseProduct()) {
+		printf("testDenseProduct failed\n");
+		failed++;
+	}
+	if (!testSpectrum()) {
+		printf("testSpectrum failed\n");
+		failed++;
+	}
+	if (!testRankDeficient()) {
+		printf("testRankDeficient failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,204 @@
+/**
+ * @file test_tensor.c
+ * @brief Tests of the sparse tensor kernels (csfSparse, mttkrpSparse, ttvSparse, cpalsSparse)
+ *
+ * gcc -std=c11 -fopenmp -I.. test_tensor.c ../sparse.c -lm -o test_tensor && ./test_tensor
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief MTTKRP along every mode (root or not, so with and without the copies of the threads) matches the sum over
+ * the coordinates of the elements
+ */
+static int testMttkrp(void) {
+
+	int dims[3] = {30, 50, 40};
+	int rank = 4;
+	tensor_t tensor;
+	csf_t csf;
+	int ok = randomTensorSparse(&tensor, 3, dims, 3000, 11) && csfSparse(&csf, &tensor, NULL);
+
+	double* factors[3];
+	for (int m = 0; m < 3; m++) {
+		factors[m] = malloc((long) dims[m]*rank*sizeof(double));
+		for (int k = 0; k < dims[m]*rank; k++) {
+			factors[m][k] = (k%7 - 3)/4.0;
+		}
+	}
+	double* out = malloc(50*rank*sizeof(double));
+	double* expected = malloc(50*rank*sizeof(double));
+
+	for (int mode = 0; ok && mode < 3; mode++) {
+		for (int k = 0; k < dims[mode]*rank; k++) {
+			expected[k] = 0;
+		}
+		for (int e = 0; e < tensor.nnz; e++) {
+			const int* index = tensor.ind+3*e;
+			for (int r = 0; r < rank; r++) {
+				double product = tensor.values[e];
+				for (int m = 0; m < 3; m++) {
+					if (m != mode) {
+						product *= factors[m][index[m]*rank+r];
+					}
+				}
+				expected[index[mode]*rank+r] += product;
+			}
+		}
+		ok = mttkrpSparse(out, &csf, factors, rank, mode);
+		for (int k = 0; ok && k < dims[mode]*rank; k++) {
+			ok = fabs(out[k]-expected[k]) <= 1e-12*(1 + fabs(expected[k]));
+		}
+	}
+
+	for (int m = 0; m < 3; m++) {
+		free(factors[m]);
+	}
+	free(out);
+	free(expected);
+	tensorFreeSparse(&tensor);
+	csfFreeSparse(&csf);
+	return ok;
+}
+
+/**
+ * @brief TTV along every mode of tensors of order 3 and 4 matches the contraction of the elements, each coordinate of
+ * the result appearing once
+ */
+static int testTtv(void) {
+
+	int dims[4] = {12, 9, 15, 7};
+	int ok = 1;
+	for (int order = 3; ok && order <= 4; order++) {
+		tensor_t tensor;
+		csf_t csf;
+		ok = randomTensorSparse(&tensor, order, dims, 2500, order) && csfSparse(&csf, &tensor, NULL);
+
+		for (int mode = 0; ok && mode < order; mode++) {
+			double* v = malloc(dims[mode]*sizeof(double));
+			for (int k = 0; k < dims[mode]; k++) {
+				v[k] = (k%5 - 2)/3.0;
+			}
+
+			//dense contraction, by the coordinates of the remaining modes
+			long size = 1;
+			for (int m = 0; m < order; m++) {
+				size *= (m != mode ? dims[m] : 1);
+			}
+			double* expected = calloc(size, sizeof(double));
+			double* got = calloc(size, sizeof(double));
+			for (int e = 0; e < tensor.nnz; e++) {
+				const int* index = tensor.ind+(long) e*order;
+				long at = 0;
+				for (int m = 0; m < order; m++) {
+					if (m != mode) {
+						at = at*dims[m] + index[m];
+					}
+				}
+				expected[at] += tensor.values[e]*v[index[mode]];
+			}
+
+			tensor_t out;
+			int built = ttvSparse(&out, &csf, v, mode);
+			ok = built && out.order == order-1;
+			for (int e = 0; ok && e < out.nnz; e++) {
+				const int* index = out.ind+(long) e*(order-1);
+				long at = 0;
+				for (int m = 0; m < order; m++) {
+					if (m != mode) {
+						int c = index[m < mode ? m : m-1];
+						ok = ok && c >= 0 && c < dims[m] && out.dims[m < mode ? m : m-1] == dims[m];
+						at = at*dims[m] + c;
+					}
+				}
+				ok = ok && got[at] == 0;
+				got[at] = out.values[e];
+			}
+			for (long k = 0; ok && k < size; k++) {
+				ok = fabs(got[k]-expected[k]) <= 1e-12*(1 + fabs(expected[k]));
+			}
+
+			if (built) {
+				tensorFreeSparse(&out);
+			}
+			free(v);
+			free(expected);
+			free(got);
+		}
+		tensorFreeSparse(&tensor);
+		csfFreeSparse(&csf);
+	}
+	return ok;
+}
+
+/**
+ * @brief CP-ALS of a sparse tensor of exact rank 3 (sum of 3 outer products of factors with zeros) reaches fit 1
+ */
+static int testCpals(void) {
+
+	int dims[3] = {10, 9, 8};
+	int rank = 3;
+	double* exact[3];
+	double* factors[3];
+	for (int m = 0; m < 3; m++) {
+		exact[m] = malloc(dims[m]*rank*sizeof(double));
+		factors[m] = malloc(dims[m]*rank*sizeof(double));
+		for (int i = 0; i < dims[m]; i++) {
+			for (int r = 0; r < rank; r++) {
+				exact[m][i*rank+r] = ((i + (m+2)*r)%4)/3.0;
+			}
+		}
+	}
+
+	tensor_t tensor;
+	csf_t csf;
+	int ok = tensorInitSparse(&tensor, 3, dims, 16);
+	for (int i = 0; ok && i < dims[0]; i++) {
+		for (int j = 0; ok && j < dims[1]; j++) {
+			for (int k = 0; ok && k < dims[2]; k++) {
+				double value = 0;
+				for (int r = 0; r < rank; r++) {
+					value += exact[0][i*rank+r]*exact[1][j*rank+r]*exact[2][k*rank+r];
+				}
+				int index[3] = {i, j, k};
+				ok = value == 0 || tensorAppendSparse(&tensor, index, value);
+			}
+		}
+	}
+	int built = ok && tensor.nnz < dims[0]*dims[1]*dims[2] && csfSparse(&csf, &tensor, NULL);
+
+	double lambda[3];
+	double fit = 0;
+	double modeTime[3];
+	ok = built && cpalsSparse(factors, lambda, &fit, modeTime, &csf, rank, 1000, 1e-12, 5);
+	ok = ok && fit > 1-1e-6 && modeTime[0] >= 0 && modeTime[1] >= 0 && modeTime[2] >= 0;
+
+	for (int m = 0; m < 3; m++) {
+		free(exact[m]);
+		free(factors[m]);
+	}
+	tensorFreeSparse(&tensor);
+	if (built) {
+		csfFreeSparse(&csf);
+	}
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testMttkrp()) {
+		printf("testMttkrp failed\n");
+		failed++;
+	}
+	if (!testTtv()) {
+		printf("testTtv failed\n");
+		failed++;
+	}
+	if (!testCpals()) {
+		printf("testCpals failed\n");
+		failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file test_triangle.c
+ * @brief Tests of triangleSparse and trussSparse
+ *
+ * gcc -std=c11 -fopenmp -I.. test_triangle.c ../sparse.c -lm -o test_triangle && ./test_triangle
+ */
+
+#include "sparse.h"
+#include "math.h"
+
+/**
+ * @brief Random graph of m vertices with nnz edges in a random direction, with duplicates and loops, and its dense
+ * undirected adjacency matrix without loops
+ */
+static elem_t* randomGraph(const int m, const int nnz, char* dense) {
+
+	elem_t* a = malloc((nnz+1)*sizeof(elem_t));
+	for (int p = 0; p < m*m; p++) {
+		dense[p] = 0;
+	}
+	for (int e = 0; e < nnz; e++) {
+		int i = rand()%m;
+		int j = rand()%m;
+		a[e+1] = (elem_t) {i, j, rand()%5 + 1};
+		if (i != j) {
+			dense[i*m+j] = 1;
+			dense[j*m+i] = 1;
+		}
+	}
+	a->i = m;
+	a->j = m;
+	a->value = nnz;
+	return a;
+}
+
+/**
+ * @brief Triangles of the graph and of each vertex match the count over all the triples of vertices
+ */
+static int testTriangles(void) {
+
+	srand(4);
+	int m = 150;
+	char* dense = malloc(m*m);
+	elem_t* a = randomGraph(m, 2000, dense);
+	long perVertex[150];
+	long expected[150];
+	for (int r = 0; r < m; r++) {
+		expected[r] = 0;
+	}
+
+	long total;
+	int ok = triangleSparse(&total, perVertex, a);
+	long count = 0;
+	for (int u = 0; u < m; u++) {
+		for (int v = u+1; v < m; v++) {
+			for (int w = v+1; dense[u*m+v] && w < m; w++) {
+				if (dense[u*m+w] && dense[v*m+w]) {
+					count++;
+					expected[u]++;
+					expected[v]++;
+					expected[w]++;
+				}
+			}
+		}
+	}
+	ok = ok && total == count && count > 0;
+	for (int r = 0; ok && r < m; r++) {
+		ok = perVertex[r] == expected[r];
+	}
+
+	//without the counts per vertex
+	ok = ok && triangleSparse(&total, NULL, a) && total == count;
+
+	free(a);
+	free(dense);
+	return ok;
+}
+
+/**
+ * @brief The truss for several orders matches peeling the dense graph recounting the triangles of every edge
+ */
+static int testTruss(void) {
+
+	srand(9);
+	int m = 80;
+	char* dense = malloc(m*m);
+	int* support = malloc(m*m*sizeof(int));
+	elem_t* a = randomGraph(m, 900, dense);
+	elem_t* out = malloc((2*900+1)*sizeof(elem_t));
+
+	int ok = 1;
+	for (int k = 2; ok && k < 9; k++) {
+		out->value = 2*900;
+		ok = trussSparse(out, a, k);
+
+		//peeling every edge with less than k-2 triangles until none is removed
+		char* alive = malloc(m*m);
+		for (int p = 0; p < m*m; p++) {
+			alive[p] = dense[p];
+		}
+		int removed = 1;
+		while (removed) {
+			removed = 0;
+			for (int u = 0; u < m; u++) {
+				for (int v = 0; v < m; v++) {
+					support[u*m+v] = 0;
+					for (int w = 0; alive[u*m+v] && w < m; w++) {
+						support[u*m+v] += alive[u*m+w] && alive[v*m+w];
+					}
+				}
+			}
+			for (int p = 0; p < m*m; p++) {
+				if (alive[p] && support[p] < k-2) {
+					alive[p] = 0;
+					removed = 1;
+				}
+			}
+		}
+
+		int count = 0;
+		for (int p = 0; p < m*m; p++) {
+			count += alive[p];
+		}
+		ok = ok && (int) out->value == count && out->i == m && out->j == m;
+		for (int e = 0; ok && e < (int) out->value; e++) {
+			int p = out[e+1].i*m + out[e+1].j;
+			ok = alive[p] && out[e+1].value == support[p];
+		}
+		ok = ok && (k < 5 || count < (int) a->value);
+		free(alive);
+	}
+
+	//too small output
+	out->value = 2;
+	ok = ok && !trussSparse(out, a, 2);
+
+	free(a);
+	free(dense);
+	free(support);
+	free(out);
+	return ok;
+}
+
+int main(void) {
+
+	int failed = 0;
+	if (!testTriangles()) {
+		printf("testTriangles failed\n");
+		failed++;
+	}
+	if (!testTruss()) {
+		printf("testTruss failed\n");
+		failed++;
+	}
+	return failed;
+}